@@ -95,23 +95,357 @@ void ScaledDocumentWindow::minimiseButtonPressed() {
 
 
 
+midi_stage_component::midi_stage_component(HostAudioProcessor& processor, int slot_index, std::function<void()> on_change) : processor_(processor),
+                                                                                                                           slot_index_(slot_index),
+                                                                                                                           on_change_(std::move(on_change)) {
+    const auto& settings = processor_.get_slot_midi_settings (slot_index_);
+    channels_ = settings.channels;
+
+    for (auto* label : { &channel_label_, &notes_label_, &transpose_label_, &velocity_label_, &controllers_label_ })
+        addAndMakeVisible (label);
+
+    addAndMakeVisible (channel_selector_);
+    addAndMakeVisible (note_range_);
+    addAndMakeVisible (transpose_);
+    addAndMakeVisible (velocity_curve_);
+    addAndMakeVisible (controllers_);
+
+    channel_selector_.addItem ("All channels", 1);
+
+    for (int channel = 0; channel < 16; ++channel)
+        channel_selector_.addItem ("Channel " + juce::String (channel + 1), channel + 2);
+
+    if (channels_ == 0xffff)
+        channel_selector_.setSelectedId (1, juce::dontSendNotification);
+    else if (juce::isPowerOfTwo (channels_))
+        channel_selector_.setSelectedId (juce::findHighestSetBit (channels_) + 2, juce::dontSendNotification);
+
+    note_range_.setRange (0.0, 127.0, 1.0);
+    note_range_.setMinAndMaxValues (settings.lowest_note, settings.highest_note, juce::dontSendNotification);
+    note_range_.textFromValueFunction = [] (double note) { return juce::MidiMessage::getMidiNoteName (juce::roundToInt (note), true, true, 3); };
+    note_range_.setPopupDisplayEnabled (true, true, nullptr);
+
+    transpose_.setRange (-48.0, 48.0, 1.0);
+    transpose_.setValue (settings.transpose, juce::dontSendNotification);
+
+    velocity_curve_.setRange (-1.0, 1.0, 0.01);
+    velocity_curve_.setValue (settings.velocity_curve, juce::dontSendNotification);
+    velocity_curve_.setDoubleClickReturnValue (true, 0.0); // linear
+
+    controllers_.setText (controllers_to_text_ (settings.controllers), false);
+    controllers_.setTextToShowWhenEmpty ("e.g. 1>11 7>x", juce::Colours::grey);
+
+    channel_selector_.onChange = [this] {
+        if (channel_selector_.getSelectedId() == 1)
+            channels_ = 0xffff;
+        else if (channel_selector_.getSelectedId() > 1)
+            channels_ = (std::uint16_t) (1u << (channel_selector_.getSelectedId() - 2));
+
+        apply_();
+    };
+
+    note_range_.onValueChange = [this] { apply_(); };
+    transpose_.onValueChange = [this] { apply_(); };
+    velocity_curve_.onValueChange = [this] { apply_(); };
+    controllers_.onReturnKey = [this] { apply_(); };
+    controllers_.onFocusLost = [this] { apply_(); };
+}
+
+void midi_stage_component::resized() {
+    auto bounds = getLocalBounds().reduced (margin / 2);
+
+    const auto row = [&bounds] (juce::Label& label, juce::Component& control) {
+        auto line = bounds.removeFromTop (30).reduced (0, 2);
+        label.setBounds (line.removeFromLeft (80));
+        control.setBounds (line);
+    };
+
+    row (channel_label_, channel_selector_);
+    row (notes_label_, note_range_);
+    row (transpose_label_, transpose_);
+    row (velocity_label_, velocity_curve_);
+    row (controllers_label_, controllers_);
+}
+
+void midi_stage_component::apply_() {
+    midi_stage::settings settings;
+
+    settings.channels = channels_;
+    settings.lowest_note = juce::roundToInt (note_range_.getMinValue());
+    settings.highest_note = juce::roundToInt (note_range_.getMaxValue());
+    settings.transpose = juce::roundToInt (transpose_.getValue());
+    settings.velocity_curve = (float) velocity_curve_.getValue();
+
+    if (! text_to_controllers_ (controllers_.getText(), settings.controllers)) {
+        settings.controllers = processor_.get_slot_midi_settings (slot_index_).controllers; // typo or half finished, keep what we had
+        controllers_.setText (controllers_to_text_ (settings.controllers), false);
+    }
+
+    processor_.set_slot_midi_settings (slot_index_, settings);
+    juce::NullCheckedInvocation::invoke (on_change_);
+}
+
+juce::String midi_stage_component::controllers_to_text_(const std::array<std::int8_t, 128>& controllers) {
+    juce::StringArray pairs;
+
+    for (int controller = 0; controller < (int) controllers.size(); ++controller) {
+        const int target = controllers[(std::size_t) controller];
+
+        if (target != controller)
+            pairs.add (juce::String (controller) + ">" + (target < 0 ? juce::String ("x") : juce::String (target)));
+    }
+
+    return pairs.joinIntoString (" ");
+}
+
+bool midi_stage_component::text_to_controllers_(const juce::String& text, std::array<std::int8_t, 128>& controllers) {
+    controllers = midi_stage::settings::make_identity_controllers();
+
+    for (const auto& pair : juce::StringArray::fromTokens (text, " ,;", "")) {
+        if (pair.isEmpty())
+            continue;
+
+        const auto from = pair.upToFirstOccurrenceOf (">", false, false).trim();
+        const auto to = pair.fromFirstOccurrenceOf (">", false, false).trim();
+
+        if (! pair.contains (">") || ! from.containsOnly ("0123456789") || from.isEmpty() || ! juce::isPositiveAndBelow (from.getIntValue(), 128))
+            return false;
+
+        if (to.equalsIgnoreCase ("x"))
+            controllers[(std::size_t) from.getIntValue()] = -1;
+        else if (to.isNotEmpty() && to.containsOnly ("0123456789") && juce::isPositiveAndBelow (to.getIntValue(), 128))
+            controllers[(std::size_t) from.getIntValue()] = (std::int8_t) to.getIntValue();
+        else
+            return false;
+    }
+
+    return true;
+}
+
+stats_component::stats_component(HostAudioProcessor& processor) : processor_(processor) {
+    addAndMakeVisible (text_);
+    addAndMakeVisible (pin_button_);
+    addAndMakeVisible (sleep_button_);
+    addAndMakeVisible (reset_button_);
+    addAndMakeVisible (export_button_);
+
+    text_.setJustificationType (juce::Justification::topLeft);
+    text_.setFont (juce::Font (juce::Font::getDefaultMonospacedFontName(), 13.f, juce::Font::plain));
+
+    pin_button_.onClick = [this] {
+        if (auto* inner = processor_.get_inner (HostAudioProcessor::selected_slot))
+            processor_.set_plugin_pinned (inner->getPluginDescription(), pin_button_.getToggleState());
+    };
+
+    sleep_button_.onClick = [this] { processor_.set_sleep_when_silent (sleep_button_.getToggleState()); };
+
+    reset_button_.onClick = [this] {
+        processor_.reset_stats();
+        timerCallback();
+    };
+
+    export_button_.onClick = [this] {
+        chooser_ = std::make_unique<juce::FileChooser> ("Export the slots' stats", juce::File::getSpecialLocation (juce::File::userDocumentsDirectory).getChildFile ("stats.csv"), "*.csv;*.json");
+
+        chooser_->launchAsync (juce::FileBrowserComponent::saveMode | juce::FileBrowserComponent::canSelectFiles | juce::FileBrowserComponent::warnAboutOverwriting, [this] (const juce::FileChooser& chooser) {
+            const auto file = chooser.getResult();
+
+            if (file != juce::File())
+                file.replaceWithText (processor_.export_stats (file.hasFileExtension ("json") ? HostAudioProcessor::stats_format::json : HostAudioProcessor::stats_format::csv));
+        });
+    };
+
+    timerCallback();
+    startTimerHz (4);
+}
+
+void stats_component::resized() {
+    auto bounds = getLocalBounds().reduced (margin / 2);
+    auto buttons = bounds.removeFromBottom (30).reduced (0, 2);
+    sleep_button_.setBounds (bounds.removeFromBottom (30).reduced (2));
+    pin_button_.setBounds (bounds.removeFromBottom (30).reduced (2));
+
+    reset_button_.setBounds (buttons.removeFromLeft (buttons.getWidth() / 2).reduced (2, 0));
+    export_button_.setBounds (buttons.reduced (2, 0));
+    text_.setBounds (bounds);
+}
+
+void stats_component::timerCallback() {
+    const auto stats = processor_.get_slot_stats (HostAudioProcessor::selected_slot);
+
+    const auto line = [] (const juce::String& name, const juce::String& value) { return name.paddedRight (' ', 14) + value + "\n"; };
+    const auto us = [] (double value) { return juce::String (value, 1) + " us"; };
+    const auto percent = [] (double value) { return juce::String (value * 100.0, 1) + " %"; };
+    const auto megabytes = [] (std::size_t bytes) { return juce::String ((juce::int64) (bytes >> 20)) + " MB"; };
+
+    const auto pool = processor_.get_warm_pool_stats();
+
+    juce::String sandbox_status = "-";
+
+    if (processor_.is_slot_sandboxed (HostAudioProcessor::selected_slot) && processor_.get_inner (HostAudioProcessor::selected_slot) != nullptr) {
+        const auto sandbox = processor_.get_sandbox_cost();
+
+        if (sandbox.running)
+            sandbox_status = juce::String (sandbox.late_blocks) + " late, " + juce::String (sandbox.restarts) + " restarts";
+        else
+            sandbox_status = sandbox.error.isNotEmpty() ? sandbox.error : juce::String ("not running");
+    }
+
+    text_.setText ("Slot " + juce::String (processor_.get_selected_slot() + 1) + "\n"
+                   + line ("blocks", juce::String ((juce::int64) stats.blocks))
+                   + line ("p50 / p90", us (stats.get_percentile_us (0.5)) + " / " + us (stats.get_percentile_us (0.9)))
+                   + line ("p99 / p99.9", us (stats.get_percentile_us (0.99)) + " / " + us (stats.get_percentile_us (0.999)))
+                   + line ("mean / worst", us (stats.mean_us) + " / " + us (stats.worst_us))
+                   + line ("budget", percent (stats.mean_budget) + " mean, " + percent (stats.worst_budget) + " worst")
+                   + line ("overruns", juce::String ((juce::int64) stats.overruns))
+                   + line ("swaps", juce::String ((juce::int64) stats.swaps))
+                   + line ("slept", juce::String ((juce::int64) stats.slept_blocks) + " blocks, ~" + juce::String (stats.saved_us / 1000.0, 1) + " ms saved")
+                   + line ("sandbox", sandbox_status)
+                   + "\nWarm pool\n"
+                   + line ("plugins", juce::String ((juce::int64) pool.entries) + ", " + megabytes (pool.bytes) + " of " + megabytes (pool.budget_bytes))
+                   + line ("hits / misses", juce::String ((juce::int64) pool.hits) + " / " + juce::String ((juce::int64) pool.misses) + ", " + juce::String ((juce::int64) pool.evictions) + " evicted"),
+                   juce::dontSendNotification);
+
+    auto* inner = processor_.get_inner (HostAudioProcessor::selected_slot);
+    pin_button_.setEnabled (inner != nullptr);
+    pin_button_.setToggleState (inner != nullptr && processor_.is_plugin_pinned (inner->getPluginDescription()), juce::dontSendNotification);
+    sleep_button_.setToggleState (processor_.is_sleep_when_silent(), juce::dontSendNotification);
+}
+
+slot_bar_component::slot_bar_component(HostAudioProcessor& processor) : processor_(processor) {
+    slot_label_.setJustificationType (juce::Justification::centredRight);
+
+    addAndMakeVisible (slot_label_);
+    addAndMakeVisible (slot_selector_);
+    addAndMakeVisible (branch_selector_);
+    addAndMakeVisible (bypass_button_);
+    addAndMakeVisible (sandbox_button_);
+    addAndMakeVisible (oversampling_selector_);
+    addAndMakeVisible (sub_block_selector_);
+    addAndMakeVisible (midi_button_);
+    addAndMakeVisible (stats_button_);
+
+    for(int branch = 0; branch < HostAudioProcessor::maximum_number_of_branches; ++branch) {
+        branch_selector_.addItem ("Branch " + juce::String (branch + 1), branch + 1);
+    }
+
+    for(const int factor : HostAudioProcessor::oversampling_factors) {
+        oversampling_selector_.addItem (factor == 1 ? juce::String ("No OS") : juce::String (factor) + "x OS", factor);
+    }
+
+    for(const int block_size : HostAudioProcessor::sub_block_sizes) {
+        sub_block_selector_.addItem (block_size == 0 ? juce::String ("Host blocks") : juce::String (block_size) + " blocks", block_size + 1); // ids can't be 0
+    }
+
+    branch_selector_.onChange = [this] {
+        if (branch_selector_.getSelectedItemIndex() >= 0)
+            processor_.set_slot_branch (HostAudioProcessor::selected_slot, branch_selector_.getSelectedItemIndex());
+    };
+
+    slot_selector_.onChange = [this] {
+        if (slot_selector_.getSelectedItemIndex() >= 0)
+            processor_.set_selected_slot (slot_selector_.getSelectedItemIndex()); // this ends up calling refresh() through pluginChanged
+    };
+
+    bypass_button_.onClick = [this] { processor_.set_slot_bypassed (HostAudioProcessor::selected_slot, bypass_button_.getToggleState()); };
+    sandbox_button_.onClick = [this] { processor_.set_slot_sandboxed (HostAudioProcessor::selected_slot, sandbox_button_.getToggleState()); };
+
+    oversampling_selector_.onChange = [this] {
+        if (oversampling_selector_.getSelectedId() != 0)
+            processor_.set_slot_oversampling (HostAudioProcessor::selected_slot, oversampling_selector_.getSelectedId());
+    };
+
+    sub_block_selector_.onChange = [this] {
+        if (sub_block_selector_.getSelectedId() != 0)
+            processor_.set_slot_sub_block_size (HostAudioProcessor::selected_slot, sub_block_selector_.getSelectedId() - 1);
+    };
+
+    midi_button_.onClick = [this] {
+        // the call out box can outlive us, so it only gets a SafePointer
+        auto content = std::make_unique<midi_stage_component> (processor_, processor_.get_selected_slot(), [safe_this = juce::Component::SafePointer<slot_bar_component> (this)] {
+            if (safe_this != nullptr)
+                safe_this->refresh(); // the button shows whether the stage does anything
+        });
+
+        content->setSize (midi_stage_component::width, midi_stage_component::height);
+        juce::CallOutBox::launchAsynchronously (std::move (content), midi_button_.getScreenBounds(), nullptr);
+    };
+
+    stats_button_.onClick = [this] {
+        auto content = std::make_unique<stats_component> (processor_);
+        content->setSize (stats_component::width, stats_component::height);
+        juce::CallOutBox::launchAsynchronously (std::move (content), stats_button_.getScreenBounds(), nullptr);
+    };
+
+    refresh();
+}
+
+void slot_bar_component::refresh() {
+    slot_selector_.clear (juce::dontSendNotification);
+
+    for (int slot_i = 0; slot_i < HostAudioProcessor::maximum_number_of_slots; ++slot_i) {
+        auto* inner = processor_.get_inner (slot_i);
+        slot_selector_.addItem (juce::String (slot_i + 1) + ": " + (inner != nullptr ? inner->getName() : juce::String ("(empty)")), slot_i + 1); // ComboBox item ids can't be 0
+    }
+
+    slot_selector_.setSelectedItemIndex (processor_.get_selected_slot(), juce::dontSendNotification);
+    branch_selector_.setSelectedItemIndex (processor_.get_slot_branch (HostAudioProcessor::selected_slot), juce::dontSendNotification);
+    bypass_button_.setToggleState (processor_.is_slot_bypassed (processor_.get_selected_slot()), juce::dontSendNotification);
+    sandbox_button_.setToggleState (processor_.is_slot_sandboxed (processor_.get_selected_slot()), juce::dontSendNotification);
+    oversampling_selector_.setSelectedId (processor_.get_slot_oversampling (HostAudioProcessor::selected_slot), juce::dontSendNotification);
+    sub_block_selector_.setSelectedId (processor_.get_slot_sub_block_size (HostAudioProcessor::selected_slot) + 1, juce::dontSendNotification);
+    midi_button_.setToggleState (! processor_.get_slot_midi_settings (HostAudioProcessor::selected_slot).is_identity(), juce::dontSendNotification);
+}
+
+void slot_bar_component::resized() {
+    auto bounds = getLocalBounds().reduced (margin / 2);
+
+    // which slot on top, how it runs below. Everything in one row didn't fit the 500 pixel default anymore
+    auto options = bounds.removeFromBottom (bounds.getHeight() / 2);
+
+    slot_label_.setBounds (bounds.removeFromLeft (40));
+    bypass_button_.setBounds (bounds.removeFromRight (80));
+    bounds.removeFromRight (margin);
+    branch_selector_.setBounds (bounds.removeFromRight (100));
+    bounds.removeFromRight (margin);
+    slot_selector_.setBounds (bounds);
+
+    options.removeFromLeft (40);
+    midi_button_.setBounds (options.removeFromLeft (60));
+    options.removeFromLeft (margin);
+    stats_button_.setBounds (options.removeFromLeft (60));
+    sandbox_button_.setBounds (options.removeFromRight (90));
+    options.removeFromRight (margin);
+    oversampling_selector_.setBounds (options.removeFromRight (80));
+    options.removeFromRight (margin);
+    sub_block_selector_.setBounds (options.removeFromRight (100));
+}
+
+
+
 HostAudioProcessorEditor::HostAudioProcessorEditor(HostAudioProcessor& owner)   : AudioProcessorEditor (owner),
                                                                                       hostProcessor (owner),
-                                                                                      loader (owner.pluginFormatManager,
-                                                                                              owner.pluginList,
+                                                                                      slot_bar_ (owner),
+                                                                                      loader (owner.get_format_manager(),
+                                                                                              owner.get_plugin_list(),
+                                                                                              owner.get_number_of_scan_threads(),
                                                                                               [&owner] (const juce::PluginDescription& pd,
                                                                                                         EditorStyle editorStyle)
                                                                                               {
                                                                                                   owner.setNewPlugin (pd, editorStyle);
                                                                                               }),
-                                                                                      scopedCallback (owner.pluginChanged, [this] { pluginChanged(); })
+                                                                                      scopedCallback (owner.pluginChanged, [this] { pluginChanged(); }),
+                                                                                      scoped_load_started_callback_ (owner.pluginLoadStarted, [this] { startTimerHz (30); timerCallback(); })
 {
     //set_handler();
 
-    setSize (500, 500);
+    setSize (500, 500 + slot_bar_component::height);
     setResizable (false, false);
     addAndMakeVisible (closeButton);
     addAndMakeVisible (loader);
+    addAndMakeVisible (slot_bar_);
+    addChildComponent (load_progress_bar_);
+    addChildComponent (cancel_load_button_);
 
 
     //hostProcessor.pluginChanged();
@@ -119,6 +453,10 @@ HostAudioProcessorEditor::HostAudioProcessorEditor(HostAudioProcessor& owner)
     create_inner_plugin_editor_();
 
     closeButton.onClick = [this] { clearPlugin(); };
+    cancel_load_button_.onClick = [this] { hostProcessor.cancel_plugin_load(); timerCallback(); };
+
+    if (hostProcessor.is_loading_plugin()) // the editor might have been opened while a load was already in progress
+        startTimerHz (30);
 
 }
 
@@ -127,8 +465,36 @@ void HostAudioProcessorEditor::paint (juce::Graphics& g) {
 }
 
 void HostAudioProcessorEditor::resized() {
-    closeButton.setBounds (getLocalBounds().withSizeKeepingCentre (200, buttonHeight));
-    loader.setBounds (getLocalBounds());
+    auto bounds = getLocalBounds();
+    slot_bar_.setBounds (bounds.removeFromTop (slot_bar_component::height));
+
+    closeButton.setBounds (bounds.withSizeKeepingCentre (200, buttonHeight));
+    loader.setBounds (bounds);
+
+    auto progress_area = bounds.removeFromTop (buttonHeight + 2 * margin).reduced (margin);
+    cancel_load_button_.setBounds (progress_area.removeFromRight (80));
+    progress_area.removeFromRight (margin);
+    load_progress_bar_.setBounds (progress_area);
+}
+
+void HostAudioProcessorEditor::timerCallback() {
+    const bool loading = hostProcessor.is_loading_plugin();
+
+    load_progress_ = loading ? (double) hostProcessor.get_plugin_load_progress() : 0.0;
+    load_progress_bar_.setTextToDisplay (hostProcessor.get_plugin_load_stage());
+
+    if (load_progress_bar_.isVisible() != loading) {
+        load_progress_bar_.setVisible (loading);
+        cancel_load_button_.setVisible (loading);
+
+        if (loading) {
+            load_progress_bar_.toFront (false);
+            cancel_load_button_.toFront (false);
+        }
+    }
+
+    if (! loading)
+        stopTimer();
 }
 
 void HostAudioProcessorEditor::childBoundsChanged (Component* child) {
@@ -138,7 +504,7 @@ void HostAudioProcessorEditor::childBoundsChanged (Component* child) {
     const auto size = inner_plugin_editor_component_or_top_level_window_ != nullptr ? inner_plugin_editor_component_or_top_level_window_->getLocalBounds()
                                         : juce::Rectangle<int>();
     
-    setSize (size.getWidth(), size.getHeight());
+    setSize (size.getWidth(), size.getHeight() + slot_bar_component::height); // the slot bar always stays on top of the inner editor
 }
 
 void HostAudioProcessorEditor::setScaleFactor (float scale) {
@@ -158,8 +524,11 @@ void HostAudioProcessorEditor::setScaleFactor (float scale) {
 void HostAudioProcessorEditor::pluginChanged() {
 
    // this->currentEditorComponent = nullptr;
-   hostProcessor.swap_read_write();
+   slot_bar_.refresh();
    create_inner_plugin_editor_();
+
+   if (hostProcessor.is_loading_plugin()) // a different slot might have been selected
+       startTimerHz (30);
 }
 
 void HostAudioProcessorEditor::clearPlugin() {
@@ -170,12 +539,12 @@ void HostAudioProcessorEditor::clearPlugin() {
 
 void HostAudioProcessorEditor::create_inner_plugin_editor_() {
     //loader.setVisible (true);
-    closeButton.setVisible(hostProcessor.processor_read_inner() != nullptr);
+    closeButton.setVisible(hostProcessor.get_inner() != nullptr);
 
-    if (hostProcessor.processor_read_inner() != nullptr) // I think part of the reason why this check is necessary because when we call createInnerEditor() on the next line,
-                                                         // we'll be dereferencing one of the elements of inner_ping_pong
-                                                         // it's basically a null check (I think) --original-picture        // just in case you aren't super familiar with unique_ptr,
-    {                                                                                                                       // the lambda is the deleter --original-picture
+    if (hostProcessor.get_inner() != nullptr) // I think part of the reason why this check is necessary because when we call createInnerEditor() on the next line,
+                                              // we'll be dereferencing the inner plugin
+                                              // it's basically a null check (I think) --original-picture        // just in case you aren't super familiar with unique_ptr,
+    {                                                                                                            // the lambda is the deleter --original-picture
         auto editorComponent = std::make_unique<PluginEditorComponent> (hostProcessor.createInnerEditor(), [this]
                                                                         {
                                                                             [[maybe_unused]] const auto posted = juce::MessageManager::callAsync ([this] { clearPlugin(); });
@@ -192,7 +561,8 @@ void HostAudioProcessorEditor::create_inner_plugin_editor_() {
             case EditorStyle::thisWindow:
             {
                 addAndMakeVisible (editorComponent.get());
-                setSize (editorComponent->getWidth(), editorComponent->getHeight());
+                editorComponent->setTopLeftPosition (0, slot_bar_component::height);
+                setSize (editorComponent->getWidth(), editorComponent->getHeight() + slot_bar_component::height);
                 inner_plugin_editor_component_or_top_level_window_ = std::move (editorComponent);
                 break;
             }
@@ -202,7 +572,7 @@ void HostAudioProcessorEditor::create_inner_plugin_editor_() {
                 const auto bg = getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId).darker();
                 auto window = std::make_unique<ScaledDocumentWindow> (bg, currentScaleFactor, *this);
                 window->setUsingNativeTitleBar(true);
-                window->setName(hostProcessor.processor_read_inner()->getName());
+                window->setName(hostProcessor.get_inner()->getName());
                 window->setTitleBarButtonsRequired(juce::DocumentWindow::minimiseButton|juce::DocumentWindow::closeButton, false);
                 window->setContentOwned (editorComponent.release(), true);
                 window->centreAroundComponent (this, window->getWidth(), window->getHeight());
@@ -226,10 +596,10 @@ void HostAudioProcessorEditor::create_inner_plugin_editor_() {
     else
     {
         inner_plugin_editor_component_or_top_level_window_ = nullptr;
-        setSize (500, 500);
+        setSize (500, 500 + slot_bar_component::height);
     }
 }
 
 HostAudioProcessorEditor::~HostAudioProcessorEditor() {
-
+    stopTimer();
 }
@@ -15,11 +15,16 @@ public:
     template <typename Callback>
     PluginLoaderComponent (juce::AudioPluginFormatManager& manager,
                            juce::KnownPluginList& list,
+                           int number_of_scan_threads,
                            Callback&& callback)
             : pluginListComponent (manager, list, {}, {})
     {
         pluginListComponent.getTableListBox().setMultipleSelectionEnabled (false);
 
+        if(number_of_scan_threads > 0) {
+            pluginListComponent.setNumberOfThreadsForScanning (number_of_scan_threads); // every binary gets scanned in its own child process, so this is safe
+        }
+
         addAndMakeVisible (pluginListComponent);
         addAndMakeVisible (buttons);
 
@@ -99,7 +104,90 @@ private:
 };
 
 //==============================================================================
-class HostAudioProcessorEditor final : public juce::AudioProcessorEditor
+// the midi_stage settings of one slot. The slot bar's MIDI button opens it in a CallOutBox, every change goes straight to the processor
+class midi_stage_component final : public juce::Component
+{
+public:
+    midi_stage_component (HostAudioProcessor& processor, int slot_index, std::function<void()> on_change);
+
+    void resized() override;
+
+    static constexpr auto width = 360, height = 5 * 30 + margin;
+
+private:
+    void apply_();
+
+    /// "1>11 7>x" means CC 1 goes to CC 11 and CC 7 gets dropped. Everything that isn't mentioned stays where it is
+    static juce::String controllers_to_text_ (const std::array<std::int8_t, 128>& controllers);
+    static bool text_to_controllers_ (const juce::String& text, std::array<std::int8_t, 128>& controllers);
+
+    HostAudioProcessor& processor_;
+    int slot_index_;
+    std::function<void()> on_change_;
+    std::uint16_t channels_; // what the channel selector doesn't show, if the state has a mask that isn't all or one channel
+
+    juce::Label channel_label_ { "", "Channel" }, notes_label_ { "", "Notes" }, transpose_label_ { "", "Transpose" }, velocity_label_ { "", "Velocity" }, controllers_label_ { "", "CC map" };
+    juce::ComboBox channel_selector_;
+    juce::Slider note_range_ { juce::Slider::TwoValueHorizontal, juce::Slider::NoTextBox };
+    juce::Slider transpose_ { juce::Slider::LinearHorizontal, juce::Slider::TextBoxRight };
+    juce::Slider velocity_curve_ { juce::Slider::LinearHorizontal, juce::Slider::TextBoxRight };
+    juce::TextEditor controllers_;
+};
+
+//==============================================================================
+// what the selected slot costs the audio thread (see process_stats), and how the warm pool is doing, refreshed a few times a second. Lives in a CallOutBox like midi_stage_component
+class stats_component final : public juce::Component,
+                              private juce::Timer
+{
+public:
+    explicit stats_component (HostAudioProcessor& processor);
+
+    void resized() override;
+
+    static constexpr auto width = 300, height = 14 * 20 + 3 * 30 + margin;
+
+private:
+    void timerCallback() override;
+
+    HostAudioProcessor& processor_;
+
+    juce::Label text_;
+    juce::ToggleButton pin_button_ { "Keep this plugin warm" }; // pins the selected slot's plugin in the warm pool (see instance_pool)
+    juce::ToggleButton sleep_button_ { "Sleep when silent (every slot)" }; // see HostAudioProcessor::set_sleep_when_silent
+    juce::TextButton reset_button_ { "Reset" };
+    juce::TextButton export_button_ { "Export..." }; // every slot, as CSV or JSON depending on the file name
+    std::unique_ptr<juce::FileChooser> chooser_;
+};
+
+//==============================================================================
+// picks which slot of the chain the rest of the editor is looking at, and lets you bypass it
+class slot_bar_component final : public juce::Component
+{
+public:
+    explicit slot_bar_component (HostAudioProcessor& processor);
+
+    /// re-reads the slot names/bypass state from the processor
+    void refresh();
+    void resized() override;
+
+    static constexpr auto height = 60; // two rows
+
+private:
+    HostAudioProcessor& processor_;
+    juce::Label slot_label_ { "", "Slot" };
+    juce::ComboBox slot_selector_;
+    juce::ComboBox branch_selector_; // which parallel branch the selected slot runs in
+    juce::ToggleButton bypass_button_ { "Bypass" };
+    juce::ToggleButton sandbox_button_ { "Sandbox" }; // run the selected slot's plugin in its own process
+    juce::ComboBox sub_block_selector_;               // the fixed block size the selected slot's plugin gets called with, if any (the item id is the size + 1)
+    juce::ComboBox oversampling_selector_;            // runs the selected slot at 1x, 2x, 4x or 8x (the item id is the factor)
+    juce::TextButton stats_button_ { "Stats" };       // opens a stats_component
+    juce::TextButton midi_button_ { "MIDI" };          // opens a midi_stage_component for the selected slot. Lit up when the slot's midi_stage does something
+};
+
+//==============================================================================
+class HostAudioProcessorEditor final : public juce::AudioProcessorEditor,
+                                       private juce::Timer // polls the progress of background plugin loads
 {
 public:
     explicit HostAudioProcessorEditor (HostAudioProcessor& owner);
@@ -113,11 +201,13 @@ public:
 
 private:
     void create_inner_plugin_editor_();
+    void timerCallback() override;
     ~HostAudioProcessorEditor() override;
 
     static constexpr auto buttonHeight = 30;
 
     HostAudioProcessor& hostProcessor;
+    slot_bar_component slot_bar_;
     PluginLoaderComponent loader;
     std::unique_ptr<Component> inner_plugin_editor_component_or_top_level_window_; // because the inner plugin's editor can run either as a child component of the host plugin's editor
                                                                                    // OR as its own top level window, what this member variable contains depends on how the user loaded the plugin
@@ -134,7 +224,13 @@ private:
     juce::ScopedValueSetter<std::function<void()>> scopedCallback; // a ScopedValueSetter is used here in order to automatically
     juce::TextButton closeButton { "Close Plugin" };               // reset the processor's pluginChanged callback to null if the editor gets destroyed
     float currentScaleFactor = 1.0f;                               // the processor then uses juce::NullCheckedInvocation::invoke()
-};                                                                 // in order to avoid calling HostAudioProcessorEditor::pluginChanged() with a dangling this pointer --original-picture
+                                                                   // in order to avoid calling HostAudioProcessorEditor::pluginChanged() with a dangling this pointer --original-picture
+
+    juce::ScopedValueSetter<std::function<void()>> scoped_load_started_callback_; // same deal as scopedCallback, but for pluginLoadStarted
+    double load_progress_ = 0.0;                                                  // ProgressBar wants a double& that it polls itself
+    juce::ProgressBar load_progress_bar_ { load_progress_ };
+    juce::TextButton cancel_load_button_ { "Cancel" };
+};
 
 //==============================================================================
 class ScaledDocumentWindow final : public juce::DocumentWindow
@@ -1,37 +1,76 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "out_of_process_scanner.h"
 
 
+namespace {
+    juce::AudioProcessor::BusesProperties make_buses_properties() {
+        auto buses = juce::AudioProcessor::BusesProperties().withInput  ("Input",     juce::AudioChannelSet::stereo(), true)
+                                                            .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
+                                                            .withOutput ("Output",    juce::AudioChannelSet::stereo(), true);
+
+        for(int aux_i = 1; aux_i <= HostAudioProcessor::maximum_number_of_aux_outputs; ++aux_i) {
+            buses.addBus (false, "Aux " + juce::String (aux_i), juce::AudioChannelSet::stereo(), false);
+        }
+
+        return buses;
+    }
+
+    int count_channels (const juce::Array<juce::AudioChannelSet>& buses) {
+        int number_of_channels = 0;
+
+        for(const auto& bus : buses) {
+            number_of_channels += bus.size();
+        }
+
+        return number_of_channels;
+    }
+}
+
 HostAudioProcessor::HostAudioProcessor()
-        : AudioProcessor (BusesProperties().withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-                                           .withOutput ("Output", juce::AudioChannelSet::stereo(), true))
+        : AudioProcessor (make_buses_properties()) // more than the demo's one stereo input and one stereo output, see make_buses_properties
 {
-    appProperties.setStorageParameters ([&]
-                                        {
-                                            juce::PropertiesFile::Options opt;
-                                            opt.applicationName = getName();
-                                            opt.commonToAllUsers = false;
-                                            opt.doNotSave = false;
-                                            opt.filenameSuffix = ".props";
-                                            opt.ignoreCaseOfKeyNames = false;
-                                            opt.storageFormat = juce::PropertiesFile::StorageFormat::storeAsXML;
-                                            opt.osxLibrarySubFolder = "Application Support";
-                                            return opt;
-                                        }());
-
-    pluginFormatManager.addDefaultFormats();
-
-    if (auto savedPluginList = appProperties.getUserSettings()->getXmlValue ("pluginList"))
-        pluginList.recreateFromXml (*savedPluginList);
-
-    juce::MessageManagerLock lock;
-    pluginList.addChangeListener (this);
-
-    // TODO: reserve
-    for(unsigned i = 0; i < maximum_number_of_parameters_; ++i) {
-        parameters_.emplace_back(new forwarding_parameter_ptr(i));
+    // the formats, the settings and the plugin list live in the plugin_registry, which every wrapper in the process shares, rather than being set up here by each one
+
+    for(std::size_t slot_i = 0; slot_i < slots_.size(); ++slot_i) {
+        slots_[slot_i] = std::make_unique<inner_plugin_slot>(reclaimer_, slot_i * inner_plugin_slot::pins_per_slot);
+
+        // an instance that was retired while the wrapper was active hasn't been released, so it's still prepared for whatever the wrapper was prepared for
+        slots_[slot_i]->set_recycler([this] (std::unique_ptr<juce::AudioPluginInstance> instance, channel_adapter adapter) {
+            pool_.recycle (std::move (instance), std::move (adapter), active);
+        });
+    }
+
+    pool_.set_budget_bytes ((std::size_t) default_warm_pool_budget_mb_ << 20);
+
+    for(std::size_t slot_i = 0; slot_i < slots_.size(); ++slot_i) {
+        slot_parameter_listeners_[slot_i] = std::make_unique<slot_parameter_listener>(forwarding_table_, *slots_[slot_i]);
+    }
+
+    oversampling_.fill (1);
+
+    parameters_.reserve(maximum_number_of_parameters_);
+    for(std::size_t i = 0; i < maximum_number_of_parameters_; ++i) {
+        parameters_.emplace_back(new forwarding_parameter_ptr(forwarding_table_, i));
         addParameter(parameters_[i]);
     }
+
+    startTimer(timer_interval_ms_); // drains parameter changes while the host isn't calling processBlock, and collects retired inner plugins
+}
+
+HostAudioProcessor::~HostAudioProcessor() {
+    loader_.cancel_all();
+    stopTimer();
+
+    for(auto& listener : slot_parameter_listeners_) {
+        if(listener->listening_to != nullptr) {
+            listener->listening_to->removeListener(listener.get()); // the inner plugins outlive the listeners, so they must stop calling them
+        }
+    }
+
+    // the host isn't allowed to call processBlock while (or after) destroying us
+    reclaimer_.set_reader_active(false);
+    reclaimer_.collect_all();
 }
 
 bool HostAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const  {
@@ -41,21 +80,71 @@ bool HostAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) con
     if (! mainInput.isDisabled() && mainInput != mainOutput)
     return false;
     
-    if (mainOutput.size() > 2)
+    // not capped at stereo. Any layout is fine, the inner plugins get whatever's closest to it that they support (see channel_adapter)
+    if (mainOutput.isDisabled())
     return false;
-    
-    return true;
+
+    // the sidechain and the aux outputs are mono or stereo, or off
+    const auto is_aux_supported = [] (const juce::AudioChannelSet& set) {
+        return set.isDisabled() || set == juce::AudioChannelSet::mono() || set == juce::AudioChannelSet::stereo();
+    };
+
+    for(int bus_i = 1; bus_i < layouts.inputBuses.size(); ++bus_i) {
+        if(! is_aux_supported (layouts.inputBuses[bus_i])) {
+            return false;
+        }
+    }
+
+    for(int bus_i = 1; bus_i < layouts.outputBuses.size(); ++bus_i) {
+        if(! is_aux_supported (layouts.outputBuses[bus_i])) {
+            return false;
+        }
+    }
+
+    return count_channels (layouts.inputBuses) <= maximum_number_of_channels && count_channels (layouts.outputBuses) <= maximum_number_of_channels;
 }
 
 void HostAudioProcessor::prepareToPlay (double sr, int bs) {
     const juce::ScopedLock sl (innerMutex);
 
     active = true;
+    prepared_block_size_ = bs;
+
+    // every slot allocates its crossfade scratch here so that processBlock never has to
+    const int number_of_channels = juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+    const auto layout = getBusesLayout();
+
+    for(auto& slot : slots_) {
+        slot->prepare (sr, bs, layout, isUsingDoublePrecision());
+    }
 
-    if (editor_write_inner() != nullptr) { // TODO: do I need to do processor_read_inner() here too? Also shouldn't I be setting the bus layout too?
-        editor_write_inner()->setRateAndBufferSizeDetails (sr, bs);
-        editor_write_inner()->prepareToPlay (sr, bs);
+    // the sidechain comes in right after the main input. Anything we output on those channels would overwrite it, so then it needs a copy
+    main_input_channels_ = layout.getMainInputChannels();
+    sidechain_channels_ = getTotalNumInputChannels() - main_input_channels_;
+    output_channels_ = getTotalNumOutputChannels();
+
+    const bool copy_sidechain = sidechain_channels_ > 0 && main_input_channels_ < output_channels_;
+    sidechain_audio_       .setSize (copy_sidechain && ! isUsingDoublePrecision() ? sidechain_channels_ : 0, copy_sidechain && ! isUsingDoublePrecision() ? bs : 0);
+    sidechain_audio_double_.setSize (copy_sidechain && isUsingDoublePrecision() ? sidechain_channels_ : 0,   copy_sidechain && isUsingDoublePrecision() ? bs : 0);
+
+    // same for the parallel branches. Only the precision we're actually going to get gets memory
+    for(std::size_t branch_i = 0; branch_i < (std::size_t) maximum_number_of_branches; ++branch_i) {
+        branch_audio_[branch_i]       .setSize (isUsingDoublePrecision() ? 0 : number_of_channels, isUsingDoublePrecision() ? 0 : bs);
+        branch_audio_double_[branch_i].setSize (isUsingDoublePrecision() ? number_of_channels : 0, isUsingDoublePrecision() ? bs : 0);
+        branch_midi_[branch_i].ensureSize (branch_midi_bytes_);
     }
+
+    chunk_midi_.ensureSize (branch_midi_bytes_);
+    chunk_midi_out_.ensureSize (branch_midi_bytes_);
+
+    crossfade_stats_.reset();
+    graph_stats_.reset();
+
+    reclaimer_.set_reader_active(true);
+
+    update_latency_();
+    rebuild_output_delay_(); // after update_latency_, so the line starts out at the right delay
+    update_branch_delays_(true); // same
 }
 
 void HostAudioProcessor::releaseResources() {
@@ -63,18 +152,20 @@ void HostAudioProcessor::releaseResources() {
 
     active = false;
 
-    if (editor_write_inner() != nullptr)
-        editor_write_inner()->releaseResources();
+    reclaimer_.set_reader_active(false); // processBlock can't be running now, so anything that's been retired can go
+    reclaimer_.collect();
 
-    if (processor_read_inner() != nullptr)
-        processor_read_inner()->releaseResources();
+    for(auto& slot : slots_) {
+        slot->release();
+    }
 }
 
 void HostAudioProcessor::reset() {
     const juce::ScopedLock sl (innerMutex);
 
-    if (processor_read_inner())
-        processor_read_inner()->reset();
+    for(auto& slot : slots_) {
+        slot->reset();
+    }
 }
 
 // In this example, we don't actually pass any audio through the inner processor.
@@ -82,199 +173,1295 @@ void HostAudioProcessor::reset() {
 // plugin instance was never modified (deleted, replaced etc.) during a call to processBlock.
 void HostAudioProcessor::processBlock (juce::AudioBuffer<float>& audio_buffer, juce::MidiBuffer& midi_buffer) {
     jassert (! isUsingDoublePrecision());
+    process_block_ (audio_buffer, midi_buffer);
+}
+
+// both precisions go through the same graph. In double precision every slot hands the buffer on as it is to plugins that support double,
+// and converts for the ones that don't, see inner_plugin_slot::process
+void HostAudioProcessor::processBlock (juce::AudioBuffer<double>& audio_buffer, juce::MidiBuffer& midi_buffer) {
+    jassert (isUsingDoublePrecision());
+    process_block_ (audio_buffer, midi_buffer);
+}
+
+template<typename sample_t>
+void HostAudioProcessor::process_block_ (juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer) {
+    const auto start_ticks = juce::Time::getHighResolutionTicks();
+
+    reclaimer_.reader_begin_block(); // has to happen before any slot loads its published instance, see epoch_reclaimer.h
+
+    const int crossfade_length = juce::roundToInt (swap_crossfade_ms_.load (std::memory_order_relaxed) * 0.001 * getSampleRate());
+    const int number_of_samples = audio_buffer.getNumSamples();
+
+    // the slots read the sidechain straight from the host's buffer, unless we output on its channels too (see prepareToPlay)
+    auto& sidechain_audio = [this] () -> auto& {
+        if constexpr (std::is_same_v<sample_t, float>) return sidechain_audio_;
+        else                                           return sidechain_audio_double_;
+    }();
+
+    const bool copy_sidechain = sidechain_audio.getNumChannels() > 0;
+    const bool sidechain_fits = main_input_channels_ + sidechain_channels_ <= audio_buffer.getNumChannels()
+                             && (! copy_sidechain || number_of_samples <= sidechain_audio.getNumSamples());
+    const int sidechain_channels = sidechain_fits ? sidechain_channels_ : 0;
+
+    for(int channel = 0; copy_sidechain && channel < sidechain_channels; ++channel) {
+        sidechain_audio.copyFrom (channel, 0, audio_buffer, main_input_channels_ + channel, 0, number_of_samples);
+    }
+
+    juce::AudioBuffer<sample_t> sidechain (copy_sidechain ? sidechain_audio.getArrayOfWritePointers() : audio_buffer.getArrayOfWritePointers() + (sidechain_channels > 0 ? main_input_channels_ : 0),
+                                           sidechain_channels, number_of_samples); // no allocation, see maximum_number_of_channels
+
+    // every output channel that doesn't carry the main input (the aux outputs, and the main ones if there's no main input) starts out silent,
+    // so the ones no plugin writes to don't echo the sidechain
+    for(int channel = main_input_channels_; channel < juce::jmin (output_channels_, audio_buffer.getNumChannels()); ++channel) {
+        audio_buffer.clear (channel, 0, number_of_samples);
+    }
+
+    // a serial chain works in place on the host's buffers, so there are no copies between slots
+    // only parallel branches (other than the first) get a copy of the input
+    const bool overlapping = process_graph_ (audio_buffer, midi_buffer, sidechain, crossfade_length);
 
-    plugin_already_changed_in_this_process_block_call = false;
+    // pads the chain's latency up to the constant one. Only the audio, the inner plugins' midi output isn't delay compensated either
+    if(auto* delay = published_output_delay_.load()) {
+        auto& line = [delay] () -> auto& {
+            if constexpr (std::is_same_v<sample_t, float>) return delay->line;
+            else                                           return delay->line_double;
+        }();
 
-    bool current_inner_index = processor_read_ping_pong_index_;
+        line.set_delay (compensation_delay_.load (std::memory_order_relaxed)); // crossfades to the new delay if a slot's latency changed
+        line.process (audio_buffer);
+    }
+
+    drain_parameter_changes_(); // whatever the inner plugins changed during this block reaches the host in one go, once per parameter
+
+    crossfade_stats_.record (overlapping, juce::Time::getHighResolutionTicks() - start_ticks);
+}
+
+void HostAudioProcessor::build_routing_() noexcept {
+    auto& routing = routing_;
+
+    routing.number_of_slots.fill (0);
+    routing.number_of_active_branches = 0;
+
+    for(int slot_i = 0; slot_i < maximum_number_of_slots; ++slot_i) {
+        const int branch = juce::jlimit (0, maximum_number_of_branches - 1, slots_[(std::size_t) slot_i]->get_branch());
+        routing.slots[(std::size_t) branch][(std::size_t) routing.number_of_slots[(std::size_t) branch]++] = slot_i;
+    }
 
-    auto& inner = inner_ping_pong[current_inner_index];
-    if(inner) {
-        inner->processBlock(audio_buffer, midi_buffer);
+    for(int branch = 0; branch < maximum_number_of_branches; ++branch) {
+        const auto& branch_slots = routing.slots[(std::size_t) branch];
+        const int number_of_slots = routing.number_of_slots[(std::size_t) branch];
+
+        const bool active = std::any_of (branch_slots.begin(), branch_slots.begin() + number_of_slots,
+                                         [this] (int slot_i) { return slots_[(std::size_t) slot_i]->has_work(); });
+
+        if(active) {
+            routing.overlapping[(std::size_t) branch] = false;
+            routing.active_branches[(std::size_t) routing.number_of_active_branches++] = branch;
+        }
+        else {
+            // an empty (or completely bypassed) branch is muted rather than passing the dry signal, otherwise clearing a parallel slot would double the dry signal
+            for(int slot_k = 0; slot_k < number_of_slots; ++slot_k) {
+                slots_[(std::size_t) branch_slots[(std::size_t) slot_k]]->skip();
+            }
+        }
     }
 }
 
-void HostAudioProcessor::processBlock (juce::AudioBuffer<double>& audio_buffer, juce::MidiBuffer& midi_buffer) {
-    jassert (! isUsingDoublePrecision());
+template<typename sample_t>
+struct HostAudioProcessor::graph_block {
+    HostAudioProcessor& processor;
+    juce::AudioBuffer<sample_t>& host_audio;
+    juce::MidiBuffer& host_midi;
+    juce::AudioBuffer<sample_t>& sidechain;                            // shared by every branch, the plugins only read it
+    std::array<juce::AudioBuffer<sample_t>, maximum_number_of_branches>& branch_audio;
+    int number_of_channels, number_of_samples, crossfade_length;
+    branch_delays* delays;                                             // null if no branch needs delaying
+    std::array<juce::int64, maximum_number_of_branches> ticks {};      // indexed like routing_.active_branches
+};
+
+template<typename sample_t>
+void HostAudioProcessor::process_branch_(void* context, int active_branch_index) noexcept {
+    auto& block = *static_cast<graph_block<sample_t>*> (context);
+    auto& processor = block.processor;
+    auto& routing = processor.routing_;
+
+    const auto start_ticks = juce::Time::getHighResolutionTicks();
+    const int branch = routing.active_branches[(std::size_t) active_branch_index];
+
+    juce::AudioBuffer<sample_t> branch_view (block.branch_audio[(std::size_t) branch].getArrayOfWritePointers(), block.number_of_channels, block.number_of_samples); // no allocation, see inner_plugin_slot::process
+
+    const bool on_host_buffer = active_branch_index == 0;
+    auto& audio_buffer = on_host_buffer ? block.host_audio : branch_view;
+    auto& midi_buffer  = on_host_buffer ? block.host_midi  : processor.branch_midi_[(std::size_t) branch];
+
+    bool overlapping = false;
+
+    for(int slot_k = 0; slot_k < routing.number_of_slots[(std::size_t) branch]; ++slot_k) {
+        auto& slot = *processor.slots_[(std::size_t) routing.slots[(std::size_t) branch][(std::size_t) slot_k]];
+        overlapping |= slot.process (audio_buffer, midi_buffer, block.sidechain, block.crossfade_length);
+    }
 
-    bool current_inner_index = processor_read_ping_pong_index_;
+    // lines the branch up with the slowest one, on whichever thread ran it, so the summing that follows doesn't comb filter
+    if(block.delays != nullptr) {
+        auto& line = [&] () -> auto& {
+            if constexpr (std::is_same_v<sample_t, float>) return block.delays->lines[(std::size_t) branch];
+            else                                           return block.delays->lines_double[(std::size_t) branch];
+        }();
 
-    auto& inner = inner_ping_pong[current_inner_index];
-    if(inner) {
-        inner->processBlock(audio_buffer, midi_buffer);
+        line.set_delay (processor.branch_delay_samples_[(std::size_t) branch].load (std::memory_order_relaxed)); // crossfades if a slot's latency changed
+        line.process (audio_buffer);
     }
+
+    routing.overlapping[(std::size_t) branch] = overlapping;
+    block.ticks[(std::size_t) active_branch_index] = juce::Time::getHighResolutionTicks() - start_ticks;
 }
 
-void HostAudioProcessor::getStateInformation (juce::MemoryBlock& destData) {
-    suspendProcessing(true);
+template<typename sample_t>
+bool HostAudioProcessor::process_graph_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain, int crossfade_length) {
+    build_routing_();
+
+    const int number_of_active_branches = routing_.number_of_active_branches;
+
+    if(number_of_active_branches == 0) {
+        return false; // nothing loaded, the host's buffer passes straight through
+    }
+
+    const auto& scratch = [this] () -> auto& {
+        if constexpr (std::is_same_v<sample_t, float>) return branch_audio_[0];
+        else                                           return branch_audio_double_[0];
+    }();
+
+    // every branch's scratch is the same size, see prepareToPlay. 0 if it doesn't have enough channels for this buffer
+    const int chunk_size = audio_buffer.getNumChannels() <= scratch.getNumChannels() ? scratch.getNumSamples() : 0;
+
+    if(number_of_active_branches == 1 || audio_buffer.getNumSamples() <= chunk_size) {
+        return process_branches_ (audio_buffer, midi_buffer, sidechain, crossfade_length, number_of_active_branches);
+    }
+
+    // the host gave us a bigger buffer than it promised in prepareToPlay. Growing the scratch would allocate, so the branches get summed a chunk at a time instead
+    if(chunk_size > 0) {
+        return process_in_chunks_ (audio_buffer, midi_buffer, sidechain, crossfade_length, chunk_size);
+    }
+
+    // there's no scratch for this layout at all (prepareToPlay hasn't been called for it). Only the first branch runs, the others are muted like an empty branch
+    for(int active_branch_i = 1; active_branch_i < number_of_active_branches; ++active_branch_i) {
+        const auto branch = (std::size_t) routing_.active_branches[(std::size_t) active_branch_i];
+
+        for(int slot_k = 0; slot_k < routing_.number_of_slots[branch]; ++slot_k) {
+            slots_[(std::size_t) routing_.slots[branch][(std::size_t) slot_k]]->skip();
+        }
+    }
 
-    const juce::ScopedLock sl (innerMutex); // FIXME there's a data race here because this usually gets called from the message thread, but I'm accessing processor_read_inner(), which belongs to the audio thread
-                                            // --original-picture
-    juce::XmlElement xml ("state");
+    return process_branches_ (audio_buffer, midi_buffer, sidechain, crossfade_length, 1);
+}
+
+template<typename sample_t>
+bool HostAudioProcessor::process_branches_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain,
+                                           int crossfade_length, int number_of_branches) {
+    auto& branch_audio = [this] () -> auto& {
+        if constexpr (std::is_same_v<sample_t, float>) return branch_audio_;
+        else                                           return branch_audio_double_;
+    }();
 
-    if(processor_read_inner() != nullptr) {
-        xml.setAttribute (editorStyleTag, (int) editorStyle);
-        xml.addChildElement (processor_read_inner()->getPluginDescription().createXml().release());
-        xml.addChildElement (
-            [this] {
-                juce::MemoryBlock innerState;
-                processor_read_inner()->getStateInformation (innerState); // TODO: could just temporarily swap them so that i can work on processor_read_inner()
-                                                                  // aaaggh but no that wouldn't work because processBlock could still be working on it   --original-picture
-                auto stateNode = std::make_unique<juce::XmlElement> (innerStateTag);
-                stateNode->addTextElement (innerState.toBase64Encoding());
-                return stateNode.release();
-            }());
+    graph_block<sample_t> block { *this, audio_buffer, midi_buffer, sidechain, branch_audio,
+                                  audio_buffer.getNumChannels(), audio_buffer.getNumSamples(), crossfade_length, published_branch_delays_.load() };
+
+    if(number_of_branches == 1) {
+        process_branch_<sample_t> (&block, 0);
+        graph_stats_.record_branch (routing_.active_branches[0], block.ticks[0]);
     }
+    else {
+        // every branch but the first gets a copy of the input. This has to happen before the first branch starts changing the host's buffer in place
+        for(int active_branch_i = 1; active_branch_i < number_of_branches; ++active_branch_i) {
+            const auto branch = (std::size_t) routing_.active_branches[(std::size_t) active_branch_i];
+
+            for(int channel = 0; channel < block.number_of_channels; ++channel) {
+                branch_audio[branch].copyFrom (channel, 0, audio_buffer, channel, 0, block.number_of_samples);
+            }
+
+            branch_midi_[branch].clear();
+            branch_midi_[branch].addEvents (midi_buffer, 0, block.number_of_samples, 0);
+        }
+
+        const auto start_ticks = juce::Time::getHighResolutionTicks();
+        auto* workers = workers_.load(std::memory_order_acquire);
 
-    const auto text = xml.toString();
-    destData.replaceAll (text.toRawUTF8(), text.getNumBytesAsUTF8());
+        if(workers == nullptr || ! workers->try_run (number_of_branches, &process_branch_<sample_t>, &block)) {
+            // the pool hasn't been started yet, or another wrapper's audio thread has it. Either way our thread runs the branches itself, the sum below is the same
+            for(int active_branch_i = 0; active_branch_i < number_of_branches; ++active_branch_i) {
+                process_branch_<sample_t> (&block, active_branch_i);
+            }
+        }
+
+        const auto parallel_ticks = juce::Time::getHighResolutionTicks() - start_ticks;
+
+        // sum everything into the first branch's output, which is already sitting in the host's buffer
+        // the midi the branches produce gets merged too (MidiBuffer::clear keeps its storage, so this doesn't allocate as long as the host's buffer has room)
+        juce::int64 branch_ticks = 0;
 
-    suspendProcessing(false);
+        for(int active_branch_i = 0; active_branch_i < number_of_branches; ++active_branch_i) {
+            const auto branch = (std::size_t) routing_.active_branches[(std::size_t) active_branch_i];
+
+            if(active_branch_i > 0) {
+                for(int channel = 0; channel < block.number_of_channels; ++channel) {
+                    audio_buffer.addFrom (channel, 0, branch_audio[branch], channel, 0, block.number_of_samples);
+                }
+
+                midi_buffer.addEvents (branch_midi_[branch], 0, block.number_of_samples, 0);
+            }
+
+            graph_stats_.record_branch ((int) branch, block.ticks[(std::size_t) active_branch_i]);
+            branch_ticks += block.ticks[(std::size_t) active_branch_i];
+        }
+
+        graph_stats_.record_parallel_block (parallel_ticks, branch_ticks);
+    }
+
+    return std::any_of (routing_.active_branches.begin(), routing_.active_branches.begin() + number_of_branches,
+                        [this] (int branch) { return routing_.overlapping[(std::size_t) branch]; });
+}
+
+template<typename sample_t>
+bool HostAudioProcessor::process_in_chunks_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain,
+                                            int crossfade_length, int chunk_size) {
+    const int number_of_samples = audio_buffer.getNumSamples();
+
+    // views into the host's buffers, so the chunks don't copy (or allocate) anything. The channel counts are limited by isBusesLayoutSupported
+    std::array<sample_t*, maximum_number_of_channels> audio_channels {}, sidechain_channels {};
+    jassert (audio_buffer.getNumChannels() <= maximum_number_of_channels && sidechain.getNumChannels() <= maximum_number_of_channels);
+
+    chunk_midi_out_.clear();
+
+    bool overlapping = false;
+
+    for(int start = 0; start < number_of_samples; start += chunk_size) {
+        const int length = juce::jmin (chunk_size, number_of_samples - start);
+
+        for(int channel = 0; channel < audio_buffer.getNumChannels(); ++channel) {
+            audio_channels[(std::size_t) channel] = audio_buffer.getArrayOfWritePointers()[channel] + start;
+        }
+
+        for(int channel = 0; channel < sidechain.getNumChannels(); ++channel) {
+            sidechain_channels[(std::size_t) channel] = sidechain.getArrayOfWritePointers()[channel] + start;
+        }
+
+        juce::AudioBuffer<sample_t> audio_chunk (audio_channels.data(), audio_buffer.getNumChannels(), length);
+        juce::AudioBuffer<sample_t> sidechain_chunk (sidechain_channels.data(), sidechain.getNumChannels(), length);
+
+        // the chunk's midi, moved to start at 0, and whatever the branches make of it, moved back
+        chunk_midi_.clear();
+        chunk_midi_.addEvents (midi_buffer, start, length, -start);
+
+        overlapping |= process_branches_ (audio_chunk, chunk_midi_, sidechain_chunk, crossfade_length, routing_.number_of_active_branches);
+
+        chunk_midi_out_.addEvents (chunk_midi_, 0, length, start);
+    }
+
+    midi_buffer.clear();
+    midi_buffer.addEvents (chunk_midi_out_, 0, number_of_samples, 0);
+
+    return overlapping;
+}
+
+void HostAudioProcessor::set_swap_crossfade_ms(float milliseconds) {
+    swap_crossfade_ms_ = juce::jlimit(0.f, maximum_swap_crossfade_ms_, milliseconds);
+}
+
+float HostAudioProcessor::get_swap_crossfade_ms() const {
+    return swap_crossfade_ms_;
+}
+
+void HostAudioProcessor::set_constant_latency_ms(float milliseconds) {
+    const juce::ScopedLock sl (innerMutex);
+
+    milliseconds = juce::jlimit(0.f, maximum_constant_latency_ms_, milliseconds);
+
+    if(milliseconds == constant_latency_ms_.load()) {
+        return;
+    }
+
+    constant_latency_ms_ = milliseconds;
+
+    update_latency_();
+
+    if(active) {
+        rebuild_output_delay_();
+    }
+}
+
+float HostAudioProcessor::get_constant_latency_ms() const {
+    return constant_latency_ms_;
+}
+
+void HostAudioProcessor::set_sleep_when_silent(bool should_sleep) {
+    sleep_when_silent_ = should_sleep;
+    apply_silence_threshold_();
+}
+
+bool HostAudioProcessor::is_sleep_when_silent() const {
+    return sleep_when_silent_;
+}
+
+void HostAudioProcessor::set_silence_threshold_db(float decibels) {
+    silence_threshold_db_ = juce::jlimit(minimum_silence_threshold_db_, maximum_silence_threshold_db_, decibels);
+    apply_silence_threshold_();
+}
+
+float HostAudioProcessor::get_silence_threshold_db() const {
+    return silence_threshold_db_;
+}
+
+void HostAudioProcessor::apply_silence_threshold_() {
+    const float threshold = sleep_when_silent_ ? juce::Decibels::decibelsToGain(silence_threshold_db_) : 0.f;
+
+    for(auto& slot : slots_) {
+        slot->set_silence_threshold(threshold);
+    }
+}
+
+int HostAudioProcessor::get_constant_latency_samples_() const noexcept {
+    return (int) std::ceil(constant_latency_ms_.load(std::memory_order_relaxed) * 0.001 * getSampleRate());
+}
+
+void HostAudioProcessor::rebuild_output_delay_() {
+    const int maximum_delay = get_constant_latency_samples_();
+    const int number_of_channels = juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+    std::unique_ptr<output_delay> incoming;
+
+    if(maximum_delay > 0 && prepared_block_size_ > 0) {
+        incoming = std::make_unique<output_delay>();
+
+        auto prepare = [&] (auto& line) {
+            line.prepare(maximum_delay, prepared_block_size_, number_of_channels);
+            line.set_delay(compensation_delay_.load());
+            line.reset(); // so the first block doesn't crossfade in from no delay at all
+        };
+
+        if(isUsingDoublePrecision()) prepare(incoming->line_double);
+        else                         prepare(incoming->line);
+    }
+
+    auto retired = std::move(output_delay_);
+    output_delay_ = std::move(incoming);
+
+    published_output_delay_.store(output_delay_.get()); // seq_cst, same as inner_plugin_slot::publish
+
+    reclaimer_.retire(std::move(retired));
+}
+
+void HostAudioProcessor::update_branch_delays_(bool rebuild) {
+    bool fits = true;
+    bool needed = false;
+
+    for(std::size_t branch_i = 0; branch_i < (std::size_t) maximum_number_of_branches; ++branch_i) {
+        const int delay = branch_delay_samples_[branch_i].load();
+        int room = 0;
+
+        if(branch_delays_ != nullptr) {
+            room = isUsingDoublePrecision() ? branch_delays_->lines_double[branch_i].get_maximum_delay() : branch_delays_->lines[branch_i].get_maximum_delay();
+        }
+
+        fits = fits && delay <= room;
+        needed = needed || delay > 0;
+    }
+
+    // a branch that needs less delay than before just turns its line down on the audio thread. Nothing to build unless one needs more
+    if(fits && ! rebuild) {
+        return;
+    }
+
+    const int number_of_channels = juce::jmax (getTotalNumInputChannels(), getTotalNumOutputChannels());
+
+    std::unique_ptr<branch_delays> incoming;
+
+    if(needed && prepared_block_size_ > 0) {
+        incoming = std::make_unique<branch_delays>();
+
+        for(std::size_t branch_i = 0; branch_i < (std::size_t) maximum_number_of_branches; ++branch_i) {
+            const int delay = branch_delay_samples_[branch_i].load();
+
+            auto prepare = [&] (auto& line) {
+                line.prepare(delay, prepared_block_size_, number_of_channels); // 0 leaves the branch as it is
+                line.set_delay(delay);
+                line.reset(); // so the first block doesn't crossfade in from no delay at all
+            };
+
+            if(isUsingDoublePrecision()) prepare(incoming->lines_double[branch_i]);
+            else                         prepare(incoming->lines[branch_i]);
+        }
+    }
+
+    auto retired = std::move(branch_delays_);
+    branch_delays_ = std::move(incoming);
+
+    published_branch_delays_.store(branch_delays_.get()); // seq_cst, same as inner_plugin_slot::publish
+
+    reclaimer_.retire(std::move(retired));
+}
+
+HostAudioProcessor::swap_crossfade_cost HostAudioProcessor::get_swap_crossfade_cost() const {
+    return crossfade_stats_.get();
+}
+
+void HostAudioProcessor::crossfade_stats::reset() noexcept {
+    normal_blocks = 0;
+    normal_ticks = 0;
+    overlap_blocks = 0;
+    overlap_ticks = 0;
+}
+
+void HostAudioProcessor::crossfade_stats::record(bool overlapping, juce::int64 ticks) noexcept {
+    // only the audio thread writes these, so plain load + store is enough
+    auto& blocks = overlapping ? overlap_blocks : normal_blocks;
+    auto& total  = overlapping ? overlap_ticks  : normal_ticks;
+
+    blocks.store(blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total .store(total .load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+}
+
+HostAudioProcessor::swap_crossfade_cost HostAudioProcessor::crossfade_stats::get() const noexcept {
+    swap_crossfade_cost cost;
+
+    cost.normal_blocks  = normal_blocks.load(std::memory_order_relaxed);
+    cost.overlap_blocks = overlap_blocks.load(std::memory_order_relaxed);
+
+    if(cost.normal_blocks > 0) {
+        cost.average_normal_block_seconds = juce::Time::highResolutionTicksToSeconds(normal_ticks.load(std::memory_order_relaxed)) / (double) cost.normal_blocks;
+    }
+
+    if(cost.overlap_blocks > 0) {
+        cost.average_overlap_block_seconds = juce::Time::highResolutionTicksToSeconds(overlap_ticks.load(std::memory_order_relaxed)) / (double) cost.overlap_blocks;
+    }
+
+    return cost;
+}
+
+void HostAudioProcessor::graph_stats::reset() noexcept {
+    for(auto& b : branches) {
+        b.blocks = 0;
+        b.ticks = 0;
+        b.peak_ticks = 0;
+    }
+
+    parallel_blocks = 0;
+    parallel_ticks = 0;
+    parallel_branch_ticks = 0;
+}
+
+void HostAudioProcessor::graph_stats::record_branch(int branch, juce::int64 ticks) noexcept {
+    // only ever called from the audio thread (after the workers are done), so plain load + store is enough
+    auto& b = branches[(std::size_t) branch];
+
+    b.blocks.store(b.blocks.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    b.ticks .store(b.ticks .load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+
+    if(ticks > b.peak_ticks.load(std::memory_order_relaxed)) {
+        b.peak_ticks.store(ticks, std::memory_order_relaxed);
+    }
+}
+
+void HostAudioProcessor::graph_stats::record_parallel_block(juce::int64 ticks, juce::int64 branch_ticks) noexcept {
+    parallel_blocks      .store(parallel_blocks      .load(std::memory_order_relaxed) + 1,            std::memory_order_relaxed);
+    parallel_ticks       .store(parallel_ticks       .load(std::memory_order_relaxed) + ticks,        std::memory_order_relaxed);
+    parallel_branch_ticks.store(parallel_branch_ticks.load(std::memory_order_relaxed) + branch_ticks, std::memory_order_relaxed);
+}
+
+HostAudioProcessor::graph_cost HostAudioProcessor::get_graph_cost() const {
+    graph_cost cost;
+
+    for(int slot_i = 0; slot_i < maximum_number_of_slots; ++slot_i) {
+        if(isPluginLoaded(slot_i)) {
+            ++cost.branches[(std::size_t) get_slot_branch(slot_i)].number_of_slots;
+        }
+    }
+
+    for(std::size_t branch_i = 0; branch_i < cost.branches.size(); ++branch_i) {
+        const auto& stats = graph_stats_.branches[branch_i];
+        auto& branch = cost.branches[branch_i];
+
+        branch.blocks = stats.blocks.load(std::memory_order_relaxed);
+        branch.peak_seconds = juce::Time::highResolutionTicksToSeconds(stats.peak_ticks.load(std::memory_order_relaxed));
+
+        if(branch.blocks > 0) {
+            branch.average_seconds = juce::Time::highResolutionTicksToSeconds(stats.ticks.load(std::memory_order_relaxed)) / (double) branch.blocks;
+        }
+    }
+
+    cost.number_of_workers = workers_.load() != nullptr ? workers_.load()->get_number_of_workers() : 0;
+    cost.parallel_blocks = graph_stats_.parallel_blocks.load(std::memory_order_relaxed);
+
+    if(cost.parallel_blocks > 0) {
+        cost.average_parallel_seconds   = juce::Time::highResolutionTicksToSeconds(graph_stats_.parallel_ticks.load(std::memory_order_relaxed)) / (double) cost.parallel_blocks;
+        cost.average_branch_seconds_sum = juce::Time::highResolutionTicksToSeconds(graph_stats_.parallel_branch_ticks.load(std::memory_order_relaxed)) / (double) cost.parallel_blocks;
+    }
+
+    return cost;
+}
+
+void HostAudioProcessor::getStateInformation (juce::MemoryBlock& destData) {
+    // no suspendProcessing(true/false) around this. It takes the callback lock (so it waits for processBlock to finish)
+    // and then makes the wrapper output silence until the save is done, so every autosave would be a dropout
+    // processBlock can keep running on the inner plugins while they're asked for their state, which is exactly what every host does to a plugin when it saves,
+    // so the inner plugins already have to handle that. All that matters here is that none of the instances go away while they're being used,
+    // and innerMutex makes sure of that, because every publish happens with it held. The audio thread never touches innerMutex
+    const juce::ScopedLock sl (innerMutex);
+
+    // binary chunks rather than xml with every inner state base64 encoded into it, see state_chunks.h
+    state_chunks::writer writer (destData);
+
+    writer.begin_chunk (wrapperChunk);
+    writer.write_float (get_swap_crossfade_ms());
+    writer.write_int (selected_slot_);
+    writer.write_int (get_warm_pool_budget_mb());
+    writer.write_string (pinned_plugins_); // not pool_.get_pinned(), see update_pinned_plugins_
+    writer.write_float (get_constant_latency_ms());
+    writer.write_bool (is_sleep_when_silent());
+    writer.write_float (get_silence_threshold_db());
+    writer.end_chunk();
+
+    juce::MemoryBlock innerState; // reused, so saving several slots doesn't reallocate for every one of them
+
+    for(int slot_i = 0; slot_i < maximum_number_of_slots; ++slot_i) {
+        auto* inner = slots_[(std::size_t) slot_i]->get_instance();
+
+        if(inner == nullptr) {
+            continue;
+        }
+
+        innerState.reset();
+        inner->getStateInformation (innerState);
+
+        const auto description = inner->getPluginDescription().createXml()->toString (juce::XmlElement::TextFormat().singleLine().withoutHeader());
+
+        writer.reserve (innerState.getSize() + (std::size_t) description.getNumBytesAsUTF8() + 64);
+
+        writer.begin_chunk (slotChunk);
+        writer.write_int (slot_i);
+        writer.write_int ((int) editor_styles_[(std::size_t) slot_i]);
+        writer.write_bool (is_slot_bypassed (slot_i));
+        writer.write_int (get_slot_branch (slot_i));
+        writer.write_string (description);
+        writer.write_bytes (innerState.getData(), innerState.getSize());
+        writer.write_bool (is_slot_sandboxed (slot_i)); // after the state, so states from before sandboxing just read this as false
+        writer.write_int (get_slot_oversampling (slot_i));
+        writer.write_int (get_slot_sub_block_size (slot_i));
+
+        const auto& midi = get_slot_midi_settings (slot_i);
+        writer.write_int (midi.channels);
+        writer.write_int (midi.lowest_note);
+        writer.write_int (midi.highest_note);
+        writer.write_int (midi.transpose);
+        writer.write_float (midi.velocity_curve);
+        writer.write_bytes (midi.controllers.data(), midi.controllers.size());
+        writer.end_chunk();
+    }
 }
 
 void HostAudioProcessor::setStateInformation (const void* data, int sizeInBytes) {
     const juce::ScopedLock sl (innerMutex);
 
-    auto xml = juce::XmlDocument::parse (juce::String (juce::CharPointer_UTF8 (static_cast<const char*> (data)), (size_t) sizeInBytes));
+    std::array<bool, maximum_number_of_slots> restored {};
+
+    if(state_chunks::is_binary (data, (std::size_t) sizeInBytes)) {
+        restore_binary_state_ (data, (std::size_t) sizeInBytes, restored);
+    }
+    else {
+        restore_xml_state_ (data, (std::size_t) sizeInBytes, restored);
+    }
+
+    for(int slot_i = 0; slot_i < maximum_number_of_slots; ++slot_i) {
+        if(! restored[(std::size_t) slot_i]) {
+            set_slot_branch (slot_i, 0);
+            set_slot_midi_settings (slot_i, {});
+
+            if(isPluginLoaded (slot_i)) {
+                clearPlugin (slot_i);
+            }
+        }
+    }
+}
+
+void HostAudioProcessor::restore_binary_state_ (const void* data, std::size_t size, std::array<bool, maximum_number_of_slots>& restored) {
+    state_chunks::reader reader (data, size);
+
+    while(reader.next_chunk()) {
+        if(reader.chunk_is (wrapperChunk)) {
+            set_swap_crossfade_ms (reader.read_float (get_swap_crossfade_ms()));
+            set_selected_slot (reader.read_int (selected_slot_));
+            set_warm_pool_budget_mb (reader.read_int (get_warm_pool_budget_mb()));
+
+            const auto pinned = juce::StringArray::fromLines (reader.read_string());
+
+            for(const auto& plugin_id : std::set<juce::String> (pool_.get_pinned())) {
+                pool_.set_pinned (plugin_id, pinned.contains (plugin_id));
+            }
+
+            for(const auto& plugin_id : pinned) {
+                if(plugin_id.isNotEmpty()) {
+                    pool_.set_pinned (plugin_id, true);
+                }
+            }
+
+            update_pinned_plugins_();
+
+            set_constant_latency_ms (reader.read_float (get_constant_latency_ms()));
+            set_sleep_when_silent (reader.read_bool (is_sleep_when_silent()));
+            set_silence_threshold_db (reader.read_float (get_silence_threshold_db()));
+        }
+        else if(reader.chunk_is (slotChunk)) {
+            const int slot_i = reader.read_int (-1);
+            const auto where = (EditorStyle) reader.read_int (0);
+            const bool bypassed = reader.read_bool (false);
+            const int branch = reader.read_int (0);
+            const auto description = juce::parseXML (reader.read_string());
+
+            const void* state = nullptr;
+            std::size_t state_size = 0;
+
+            if(description == nullptr || ! reader.read_bytes (state, state_size) || ! juce::isPositiveAndBelow (slot_i, maximum_number_of_slots)) {
+                continue;
+            }
+
+            juce::PluginDescription pd;
+
+            if(! pd.loadFromXml (*description)) {
+                continue;
+            }
+
+            const bool sandboxed = reader.read_bool (false);
+            const int oversampling = reader.read_int (1);
+            const int sub_block_size = reader.read_int (0);
+
+            midi_stage::settings midi;
+            midi.channels = (std::uint16_t) reader.read_int (midi.channels);
+            midi.lowest_note = juce::jlimit (0, 127, reader.read_int (midi.lowest_note));
+            midi.highest_note = juce::jlimit (0, 127, reader.read_int (midi.highest_note));
+            midi.transpose = juce::jlimit (-127, 127, reader.read_int (midi.transpose));
+            midi.velocity_curve = juce::jlimit (-1.f, 1.f, reader.read_float (midi.velocity_curve));
+
+            const void* controllers = nullptr;
+            std::size_t controllers_size = 0;
+
+            if(reader.read_bytes (controllers, controllers_size) && controllers_size == midi.controllers.size()) {
+                std::memcpy (midi.controllers.data(), controllers, controllers_size);
+
+                for(auto& controller : midi.controllers) {
+                    controller = juce::jlimit<std::int8_t> (-1, 127, controller);
+                }
+            }
+
+            restored[(std::size_t) slot_i] = true;
+            set_slot_midi_settings (slot_i, midi);
+            restore_slot_ (slot_i, pd, where, bypassed, branch, sandboxed, oversampling, sub_block_size, juce::MemoryBlock (state, state_size)); // the only copy of the inner state. The loader needs its own, because it runs after this returns
+        }
+    }
+}
+
+void HostAudioProcessor::restore_xml_state_ (const void* data, std::size_t size, std::array<bool, maximum_number_of_slots>& restored) {
+    auto xml = juce::XmlDocument::parse (juce::String (juce::CharPointer_UTF8 (static_cast<const char*> (data)), size));
+
+    if(xml == nullptr) {
+        return;
+    }
+
+    set_swap_crossfade_ms ((float) xml->getDoubleAttribute (swapCrossfadeTag, get_swap_crossfade_ms()));
+
+    const auto restore_slot = [this, &restored] (const juce::XmlElement& node, int slot_i) {
+        auto* pluginNode = node.getChildByName ("PLUGIN");
+
+        if(pluginNode == nullptr || ! juce::isPositiveAndBelow (slot_i, maximum_number_of_slots)) {
+            return;
+        }
+
+        restored[(std::size_t) slot_i] = true;
 
-    if(auto* pluginNode = xml->getChildByName ("PLUGIN")) {
         juce::PluginDescription pd;
         pd.loadFromXml (*pluginNode);
 
         juce::MemoryBlock innerState;
-        innerState.fromBase64Encoding (xml->getChildElementAllSubText (innerStateTag, {}));
+        innerState.fromBase64Encoding (node.getChildElementAllSubText (innerStateTag, {}));
+
+        restore_slot_ (slot_i,
+                       pd,
+                       (EditorStyle) node.getIntAttribute (editorStyleTag, 0),
+                       node.getBoolAttribute (bypassedTag, false),
+                       node.getIntAttribute (branchTag, 0),
+                       false,
+                       1,
+                       0,
+                       std::move (innerState));
+    };
+
+    restore_slot (*xml, 0); // states saved before there was more than one slot just have the plugin at the top level
 
-        setNewPlugin (pd,
-                      (EditorStyle) xml->getIntAttribute (editorStyleTag, 0),
-                      innerState);
+    for(auto* slot_node : xml->getChildWithTagNameIterator (slotTag)) {
+        restore_slot (*slot_node, slot_node->getIntAttribute (slotIndexTag, -1));
     }
+
+    set_selected_slot (xml->getIntAttribute (selectedSlotTag, selected_slot_));
 }
 
-void HostAudioProcessor::setNewPlugin(const juce::PluginDescription& pd, EditorStyle where, const juce::MemoryBlock& mb) {
-    if(plugin_already_changed_in_this_process_block_call) {
-        return;
+void HostAudioProcessor::restore_slot_ (int slot_index, const juce::PluginDescription& pd, EditorStyle where, bool bypassed, int branch, bool sandboxed, int oversampling, int sub_block_size, juce::MemoryBlock state) {
+    set_slot_bypassed (slot_index, bypassed);
+    set_slot_branch (slot_index, branch);
+    sandboxed_[(std::size_t) slot_index] = sandboxed; // not set_slot_sandboxed, that would reload whatever is in the slot right now
+    oversampling_[(std::size_t) slot_index] = std::find (oversampling_factors.begin(), oversampling_factors.end(), oversampling) != oversampling_factors.end() ? oversampling : 1;
+    sub_block_sizes_[(std::size_t) slot_index] = std::find (sub_block_sizes.begin(), sub_block_sizes.end(), sub_block_size) != sub_block_sizes.end() ? sub_block_size : 0;
+
+    // the plugin might have been moved (or reinstalled somewhere else) since the state was saved. If it's gone from where the state says it is,
+    // but the index knows the same plugin somewhere else, load that one. Only that one entry gets decoded
+    for(auto* format : get_format_manager().getFormats()) {
+        if(format->getName() == pd.pluginFormatName && ! format->doesPluginStillExist (pd)) {
+            if(auto moved = registry_->get_index().find (pd.pluginFormatName, pd.uniqueId)) {
+                setNewPlugin (*moved, where, std::move (state), slot_index);
+                return;
+            }
+        }
     }
 
-    plugin_already_changed_in_this_process_block_call = true;
+    setNewPlugin (pd, where, std::move (state), slot_index);
+}
 
+void HostAudioProcessor::setNewPlugin(const juce::PluginDescription& pd, EditorStyle where, juce::MemoryBlock mb, int slot_index) {
     const juce::ScopedLock sl (innerMutex);
 
-    const auto callback = [this, where, mb] (std::unique_ptr<juce::AudioPluginInstance> instance, const juce::String& error)
+    const int slot_i = resolve_slot_(slot_index);
+    jassert (juce::isPositiveAndBelow (slot_i, maximum_number_of_slots));
+
+    // In a 'real' plugin, we'd also need to set the bus configuration of the inner plugin.
+    // One possibility would be to match the bus configuration of the wrapper plugin, but
+    // the inner plugin isn't guaranteed to support the same layout. Alternatively, we
+    // could try to apply a reasonably similar layout, and maintain a mapping between the
+    // inner/outer channel layouts.
+    //
+    // In any case, it is essential that the inner plugin is told about the bus
+    // configuration that will be used. The AudioBuffer passed to the inner plugin must also
+    // exactly match this layout.
+
+    /// ^
+    /// I did what the juce people described here
+    /// --original-picture
+
+    // the loader applies the layout (and restores the state and calls prepareToPlay) on its own thread, so none of that blocks the message thread
+    // the "reasonably similar layout and a mapping" part is channel_adapter, so plugins that don't support the wrapper's layout load anyway
+
+    inner_plugin_loader::request request;
+    request.description = pd;
+    request.state = std::move(mb);
+    request.layout = getBusesLayout();
+    request.sample_rate = getSampleRate();
+    request.block_size = getBlockSize();
+    request.prepare = active; // active is true between prepareToPlay and releaseResources. If we aren't active, prepareToPlay will prepare the instance later
+    request.double_precision = isUsingDoublePrecision();
+    request.sandboxed = sandboxed_[(std::size_t) slot_i];
+    request.oversampling_factor = oversampling_[(std::size_t) slot_i];
+    request.sub_block_size = sub_block_sizes_[(std::size_t) slot_i];
+    const bool poolable = pool_.might_keep (request.description.createIdentifierString());
+    request.hash_state = poolable;
+
+    // if the pool still has this plugin loaded the same way and in the same state, switching to it is just the publish in finish_load_
+    const auto state_hash = poolable ? inner_plugin_loader::hash_state (request.state) : 0;
+
+    if(poolable) {
+        if(auto pooled = pool_.take (request, state_hash)) {
+            loader_.cancel (slot_i); // whatever the slot was loading before this is superseded, same as with a load
+            finish_load_ (slot_i, where, std::move (*pooled));
+            return;
+        }
+    }
+
+    instance_pool::origin origin { pd.createIdentifierString(), state_hash, 0, request.sandboxed, 0 };
+
+    loader_.load(slot_i, std::move(request), [this, where, slot_i, origin] (inner_plugin_loader::result&& loaded) mutable
     {
-        if (error.isNotEmpty())
+        if (loaded.error.isNotEmpty())
         {
             auto options = juce::MessageBoxOptions::makeOptionsOk (juce::MessageBoxIconType::WarningIcon,
-                                                             "Plugin Load Failed",
-                                                             error);
+                                                                   "Plugin Load Failed",
+                                                                   loaded.error);
             messageBox = juce::AlertWindow::showScopedAsync (options, nullptr);
             return;
         }
 
-        editor_write_inner() = std::move (instance);
-        editorStyle = where;
+        origin.loaded_state = loaded.state_hash;
+        origin.footprint_bytes = loaded.footprint_bytes;
+        pool_.track (*loaded.instance, std::move (origin));
 
-        if (editor_write_inner() != nullptr && ! mb.isEmpty())
-            editor_write_inner()->setStateInformation (mb.getData(), (int) mb.getSize());
+        finish_load_ (slot_i, where, std::move (loaded));
+    });
 
-        // In a 'real' plugin, we'd also need to set the bus configuration of the inner plugin.
-        // One possibility would be to match the bus configuration of the wrapper plugin, but
-        // the inner plugin isn't guaranteed to support the same layout. Alternatively, we
-        // could try to apply a reasonably similar layout, and maintain a mapping between the
-        // inner/outer channel layouts.
-        //
-        // In any case, it is essential that the inner plugin is told about the bus
-        // configuration that will be used. The AudioBuffer passed to the inner plugin must also
-        // exactly match this layout.
+    juce::NullCheckedInvocation::invoke (pluginLoadStarted);
+}
 
-        /// ^
-        /// I did what the juce people described here
-        /// --original-picture
+void HostAudioProcessor::finish_load_(int slot_index, EditorStyle where, inner_plugin_loader::result&& loaded) {
+    const juce::ScopedLock callback_sl (innerMutex);
 
+    auto& instance = loaded.instance;
+    editor_styles_[(std::size_t) slot_index] = where;
 
-        if(active) { // I don't understand what active does --original-picture
-            if(!editor_write_inner()->checkBusesLayoutSupported(getBusesLayout())) {
-                // this is called from the gui thread so it's okay --original-picture
-                juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
-                                                       "Error!",
-                                                       "the plugin you're trying to load doesn't support the bus layout of the host plugin!",
-                                                       "okay ;_;");
+    // prepareToPlay/releaseResources might have been called while the loader was busy (or while the instance sat in the pool)
+    // if that happened, the instance gets (re)prepared here, which is the slow path, but it's rare
+    if(active && (! loaded.prepared || loaded.sample_rate != getSampleRate() || loaded.block_size != getBlockSize() || loaded.double_precision != isUsingDoublePrecision())) {
+        inner_plugin_slot::prepare_instance (*instance, getSampleRate(), getBlockSize(), isUsingDoublePrecision(), loaded.adapter);
+    }
 
-                editor_write_inner().reset();
-            }
-            else {
-                jassert(editor_write_inner()->setBusesLayout(getBusesLayout()));
-                editor_write_inner()->setRateAndBufferSizeDetails (getSampleRate(), getBlockSize());
-                editor_write_inner()->prepareToPlay (getSampleRate(), getBlockSize());
+    publish_inner_(slot_index, std::move(instance), std::move(loaded.adapter)); // the only thing the swap costs the message thread is this pointer publish (and the parameter rewiring below)
 
-                for(unsigned outer_parameter_i = 0; outer_parameter_i < maximum_number_of_parameters_; ++outer_parameter_i) {
-                    parameters_[outer_parameter_i]->set_forwarded_parameter(nullptr);
-                }
+    const unsigned chain_parameter_count = rebind_parameters_();
 
-                unsigned inner_plugin_parameter_count = editor_write_inner()->getParameters().size(),
-                         number_of_parameters;
+    if(chain_parameter_count > maximum_number_of_parameters_) {
+        juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
+                                               "Warning!",
+                                               "The plugins you've loaded have more parameters than the hardcoded maximum of the host plugin (" + juce::String(chain_parameter_count) + " vs " + juce::String(maximum_number_of_parameters_) + ")! The plugins can still be used, but the last " + juce::String(chain_parameter_count - maximum_number_of_parameters_) + " will be inaccessible from your DAW!",
+                                               "okay ;_;");
+    }
 
-                if(editor_write_inner()->getParameters().size() > maximum_number_of_parameters_) {
-                    number_of_parameters = maximum_number_of_parameters_;
-                    juce::AlertWindow::showMessageBoxAsync(juce::MessageBoxIconType::WarningIcon,
-                                                           "Warning!",
-                                                           "The plugin you're trying to load has more parameters than the hardcoded maximum of the host plugin (" + juce::String(inner_plugin_parameter_count) + " vs " + juce::String(maximum_number_of_parameters_) + ")! The plugin can still be used, but the last " + juce::String(inner_plugin_parameter_count - maximum_number_of_parameters_) + " will be inaccessible from your DAW!",
-                                                           "okay ;_;");
-                }
-                else {
-                    number_of_parameters = inner_plugin_parameter_count;
-                }
+    updateHostDisplay();
 
-                for(unsigned inner_parameter_i = 0; inner_parameter_i < number_of_parameters; ++inner_parameter_i) {
-                    parameters_[inner_parameter_i]->set_forwarded_parameter(editor_write_inner()->getParameters()[inner_parameter_i]);
-                }
+    juce::NullCheckedInvocation::invoke (pluginChanged);
 
-                updateHostDisplay();
+    // juce::NullCheckedInvocation::invoke (pluginChanged); // this line is how it is in the original HostPluginDemo.h --original-picture
+}
 
-                juce::NullCheckedInvocation::invoke (pluginChanged); // I moved this up here and I can't remember why lol
-            }                                                        // I've tested both versions and they seem to do the same thing --original-picture
-        }
+bool HostAudioProcessor::is_loading_plugin(int slot_index) const {
+    return loader_.is_loading(resolve_slot_(slot_index));
+}
 
-        // juce::NullCheckedInvocation::invoke (pluginChanged); // this line is how it is in the original HostPluginDemo.h --original-picture
-    };
+float HostAudioProcessor::get_plugin_load_progress(int slot_index) const {
+    return loader_.get_progress(resolve_slot_(slot_index));
+}
 
-    pluginFormatManager.createPluginInstanceAsync (pd, getSampleRate(), getBlockSize(), callback);
+juce::String HostAudioProcessor::get_plugin_load_stage(int slot_index) const {
+    return loader_.get_stage_description(resolve_slot_(slot_index));
 }
 
-void HostAudioProcessor::clearPlugin() {
+void HostAudioProcessor::cancel_plugin_load(int slot_index) {
+    loader_.cancel(resolve_slot_(slot_index));
+}
+
+void HostAudioProcessor::clearPlugin(int slot_index) {
     const juce::ScopedLock sl (innerMutex);
 
-    for(unsigned outer_parameter_i = 0; outer_parameter_i < maximum_number_of_parameters_; ++outer_parameter_i) {
-        parameters_[outer_parameter_i]->set_forwarded_parameter(nullptr);
-    }
+    publish_inner_(resolve_slot_(slot_index), nullptr);
+
+    rebind_parameters_();
     updateHostDisplay();
 
-    editor_write_inner() = nullptr; // TODO: shouldn't this be processor_read_inner?
     juce::NullCheckedInvocation::invoke (pluginChanged);
 }
 
-bool HostAudioProcessor::isPluginLoaded() const {
+bool HostAudioProcessor::isPluginLoaded(int slot_index) const {
     const juce::ScopedLock sl (innerMutex);
-    return processor_read_inner() != nullptr;
+    return get_inner(slot_index) != nullptr;
+}
+
+std::unique_ptr<juce::AudioProcessorEditor> HostAudioProcessor::createInnerEditor(int slot_index) const {
+    const juce::ScopedLock sl (innerMutex);
+
+    auto* inner = get_inner(slot_index);
+    return rawToUniquePtr (inner->hasEditor() ? inner->createEditorIfNeeded() : nullptr);
+}
+
+EditorStyle HostAudioProcessor::getEditorStyle(int slot_index) const noexcept {
+    return editor_styles_[(std::size_t) resolve_slot_(slot_index)];
+}
+
+juce::AudioPluginInstance* HostAudioProcessor::get_inner(int slot_index) const noexcept {
+    return slots_[(std::size_t) resolve_slot_(slot_index)]->get_instance();
+}
+
+void HostAudioProcessor::set_slot_bypassed(int slot_index, bool should_be_bypassed) {
+    slots_[(std::size_t) resolve_slot_(slot_index)]->set_bypassed(should_be_bypassed);
+    update_latency_(); // a bypassed slot doesn't delay anything
+}
+
+bool HostAudioProcessor::is_slot_bypassed(int slot_index) const {
+    return slots_[(std::size_t) resolve_slot_(slot_index)]->is_bypassed();
+}
+
+void HostAudioProcessor::set_slot_sandboxed(int slot_index, bool should_be_sandboxed) {
+    const juce::ScopedLock sl (innerMutex);
+
+    const int slot_i = resolve_slot_(slot_index);
+
+    if(sandboxed_[(std::size_t) slot_i] == should_be_sandboxed) {
+        return;
+    }
+
+    sandboxed_[(std::size_t) slot_i] = should_be_sandboxed;
+
+    // move whatever is loaded into (or out of) the sandbox. The old instance keeps running until the new one is published
+    if(auto* inner = get_inner(slot_i)) {
+        juce::MemoryBlock state;
+        inner->getStateInformation (state);
+
+        setNewPlugin (inner->getPluginDescription(), editor_styles_[(std::size_t) slot_i], std::move (state), slot_i);
+    }
+}
+
+bool HostAudioProcessor::is_slot_sandboxed(int slot_index) const {
+    return sandboxed_[(std::size_t) resolve_slot_(slot_index)];
+}
+
+sandboxed_plugin_instance::cost HostAudioProcessor::get_sandbox_cost(int slot_index) const {
+    if(auto* sandboxed = dynamic_cast<sandboxed_plugin_instance*> (get_inner(slot_index))) {
+        return sandboxed->get_cost();
+    }
+
+    return {};
+}
+
+void HostAudioProcessor::set_slot_oversampling(int slot_index, int factor) {
+    const juce::ScopedLock sl (innerMutex);
+
+    const int slot_i = resolve_slot_(slot_index);
+
+    jassert (std::find (oversampling_factors.begin(), oversampling_factors.end(), factor) != oversampling_factors.end());
+
+    if(oversampling_[(std::size_t) slot_i] == factor) {
+        return;
+    }
+
+    oversampling_[(std::size_t) slot_i] = factor;
+
+    // the plugin has to be prepared at the new rate, which can't happen while it's processing, so it gets reloaded like set_slot_sandboxed does
+    if(auto* inner = get_inner(slot_i)) {
+        juce::MemoryBlock state;
+        inner->getStateInformation (state);
+
+        setNewPlugin (inner->getPluginDescription(), editor_styles_[(std::size_t) slot_i], std::move (state), slot_i);
+    }
+}
+
+int HostAudioProcessor::get_slot_oversampling(int slot_index) const {
+    return oversampling_[(std::size_t) resolve_slot_(slot_index)];
+}
+
+void HostAudioProcessor::set_slot_sub_block_size(int slot_index, int block_size) {
+    const juce::ScopedLock sl (innerMutex);
+
+    const int slot_i = resolve_slot_(slot_index);
+
+    jassert (std::find (sub_block_sizes.begin(), sub_block_sizes.end(), block_size) != sub_block_sizes.end());
+
+    if(sub_block_sizes_[(std::size_t) slot_i] == block_size) {
+        return;
+    }
+
+    sub_block_sizes_[(std::size_t) slot_i] = block_size;
+
+    // the plugin gets prepared with the sub-block size, so same as set_slot_oversampling
+    if(auto* inner = get_inner(slot_i)) {
+        juce::MemoryBlock state;
+        inner->getStateInformation (state);
+
+        setNewPlugin (inner->getPluginDescription(), editor_styles_[(std::size_t) slot_i], std::move (state), slot_i);
+    }
+}
+
+int HostAudioProcessor::get_slot_sub_block_size(int slot_index) const {
+    return sub_block_sizes_[(std::size_t) resolve_slot_(slot_index)];
+}
+
+void HostAudioProcessor::set_slot_midi_settings(int slot_index, const midi_stage::settings& settings) {
+    slots_[(std::size_t) resolve_slot_(slot_index)]->set_midi_settings(settings);
+}
+
+const midi_stage::settings& HostAudioProcessor::get_slot_midi_settings(int slot_index) const {
+    return slots_[(std::size_t) resolve_slot_(slot_index)]->get_midi_settings();
+}
+
+process_stats::snapshot HostAudioProcessor::get_slot_stats(int slot_index) const {
+    return slots_[(std::size_t) resolve_slot_(slot_index)]->get_stats().get_snapshot();
+}
+
+void HostAudioProcessor::reset_stats() {
+    for(auto& slot : slots_) {
+        slot->get_stats().reset();
+    }
+}
+
+juce::String HostAudioProcessor::export_stats(stats_format format) const {
+    const auto get_plugin_name = [this] (int slot_i) {
+        auto* inner = get_inner(slot_i);
+        return inner != nullptr ? inner->getName() : juce::String();
+    };
+
+    if(format == stats_format::json) {
+        juce::Array<juce::var> slots;
+
+        for(int slot_i = 0; slot_i < maximum_number_of_slots; ++slot_i) {
+            auto* slot = new juce::DynamicObject();
+            slot->setProperty ("slot", slot_i + 1);
+            slot->setProperty ("plugin", get_plugin_name (slot_i));
+            slot->setProperty ("branch", get_slot_branch (slot_i) + 1);
+            slot->setProperty ("bypassed", is_slot_bypassed (slot_i));
+            slot->setProperty ("stats", get_slot_stats (slot_i).to_var());
+            slots.add (juce::var (slot));
+        }
+
+        auto* root = new juce::DynamicObject();
+        root->setProperty ("sample_rate", getSampleRate());
+        root->setProperty ("block_size", getBlockSize());
+        root->setProperty ("slots", slots);
+
+        return juce::JSON::toString (juce::var (root));
+    }
+
+    juce::String csv = "slot,plugin,branch,bypassed,blocks,overruns,swaps,mean_us,p50_us,p90_us,p99_us,p999_us,worst_us,mean_budget,worst_budget,slept_blocks,saved_us\n";
+
+    for(int slot_i = 0; slot_i < maximum_number_of_slots; ++slot_i) {
+        const auto stats = get_slot_stats (slot_i);
+
+        juce::StringArray row;
+        row.add (juce::String (slot_i + 1));
+        row.add (get_plugin_name (slot_i).replace ("\"", "\"\"").quoted()); // csv escapes quotes by doubling them
+        row.add (juce::String (get_slot_branch (slot_i) + 1));
+        row.add (is_slot_bypassed (slot_i) ? "1" : "0");
+        row.add (juce::String ((juce::int64) stats.blocks));
+        row.add (juce::String ((juce::int64) stats.overruns));
+        row.add (juce::String ((juce::int64) stats.swaps));
+
+        for(const double value : { stats.mean_us, stats.get_percentile_us (0.5), stats.get_percentile_us (0.9), stats.get_percentile_us (0.99),
+                                   stats.get_percentile_us (0.999), stats.worst_us, stats.mean_budget, stats.worst_budget }) {
+            row.add (juce::String (value, 3));
+        }
+
+        row.add (juce::String ((juce::int64) stats.slept_blocks));
+        row.add (juce::String (stats.saved_us, 3));
+
+        csv << row.joinIntoString (",") << "\n";
+    }
+
+    return csv;
+}
+
+void HostAudioProcessor::set_slot_branch(int slot_index, int branch) {
+    branch = juce::jlimit(0, maximum_number_of_branches - 1, branch);
+    slots_[(std::size_t) resolve_slot_(slot_index)]->set_branch(branch);
+
+    // a second branch is the first time we can use more than the host's audio thread. The pool is shared with every other wrapper, see plugin_registry::get_workers
+    if(branch > 0 && workers_.load() == nullptr) {
+        workers_ = &registry_->get_workers(maximum_number_of_branches - 1); // the audio thread runs a branch itself
+    }
+
+    update_latency_();
+}
+
+int HostAudioProcessor::get_slot_branch(int slot_index) const {
+    return slots_[(std::size_t) resolve_slot_(slot_index)]->get_branch();
+}
+
+void HostAudioProcessor::set_warm_pool_budget_mb(int megabytes) {
+    warm_pool_budget_mb_ = juce::jmax (0, megabytes);
+    pool_.set_budget_bytes ((std::size_t) warm_pool_budget_mb_.load() << 20);
+}
+
+int HostAudioProcessor::get_warm_pool_budget_mb() const {
+    return warm_pool_budget_mb_;
+}
+
+void HostAudioProcessor::set_plugin_pinned(const juce::PluginDescription& pd, bool should_be_pinned) {
+    pool_.set_pinned (pd.createIdentifierString(), should_be_pinned);
+    update_pinned_plugins_();
 }
 
-std::unique_ptr<juce::AudioProcessorEditor> HostAudioProcessor::createInnerEditor() const {
+void HostAudioProcessor::update_pinned_plugins_() {
+    juce::StringArray pinned;
+
+    for(const auto& plugin_id : pool_.get_pinned()) {
+        pinned.add (plugin_id);
+    }
+
+    const auto joined = pinned.joinIntoString ("\n");
+
     const juce::ScopedLock sl (innerMutex);
-    return rawToUniquePtr (processor_read_inner()->hasEditor() ? processor_read_inner()->createEditorIfNeeded() : nullptr);
+    pinned_plugins_ = joined;
+}
+
+bool HostAudioProcessor::is_plugin_pinned(const juce::PluginDescription& pd) const {
+    return pool_.is_pinned (pd.createIdentifierString());
+}
+
+instance_pool::stats HostAudioProcessor::get_warm_pool_stats() const {
+    return pool_.get_stats();
 }
 
-void HostAudioProcessor::changeListenerCallback (juce::ChangeBroadcaster* source) {
-    if(source != &pluginList) {
+void HostAudioProcessor::set_selected_slot(int slot_index) {
+    slot_index = juce::jlimit(0, maximum_number_of_slots - 1, slot_index);
+
+    if(slot_index != selected_slot_) {
+        selected_slot_ = slot_index;
+        juce::NullCheckedInvocation::invoke (pluginChanged); // the editor shows whatever is in the selected slot
+    }
+}
+
+juce::KnownPluginList& HostAudioProcessor::get_plugin_list() {
+    return registry_->get_index().get_list();
+}
+
+int HostAudioProcessor::get_number_of_scan_threads() const {
+    return out_of_process_scanner::find_scanner_executable().existsAsFile() ? juce::SystemStats::getNumCpus() : 0;
+}
+
+void HostAudioProcessor::publish_inner_(int slot_index, std::unique_ptr<juce::AudioPluginInstance> instance, channel_adapter adapter) {
+    slots_[(std::size_t) slot_index]->publish(std::move(instance), std::move(adapter));
+    update_latency_();
+
+    // no collect right here, because the old instance's editor might still be open. It gets replaced when pluginChanged is invoked,
+    // which always happens after this, so by the time the timer fires it's safe to destroy the old instance
+}
+
+void HostAudioProcessor::update_latency_() {
+    // the faster branches get delayed to line up with the slowest one (see update_branch_delays_), so that's the latency the host gets told about. Same for the tail
+    std::array<int, maximum_number_of_branches> branch_latency {};
+    std::array<double, maximum_number_of_branches> branch_tail {};
+
+    for(auto& slot : slots_) {
+        slot->refresh_latency_and_tail(); // the slots remember both, so the audio thread never has to ask the plugins
+
+        const auto branch = (std::size_t) juce::jlimit (0, maximum_number_of_branches - 1, slot->get_branch());
+        branch_latency[branch] += slot->get_latency_samples();
+        branch_tail[branch] += slot->get_tail_seconds(); // an infinite tail stays infinite
+    }
+
+    const int chain_latency = *std::max_element (branch_latency.begin(), branch_latency.end());
+
+    for(std::size_t branch_i = 0; branch_i < branch_latency.size(); ++branch_i) {
+        branch_delay_samples_[branch_i].store (chain_latency - branch_latency[branch_i], std::memory_order_relaxed);
+    }
+
+    if(prepared_block_size_ > 0) {
+        update_branch_delays_(false);
+    }
+    const int constant_latency = get_constant_latency_samples_();
+
+    // the audio thread only ever reads these two atomics, it never asks a plugin for anything
+    compensation_delay_.store (juce::jmax (0, constant_latency - chain_latency), std::memory_order_relaxed);
+    setLatencySamples (juce::jmax (chain_latency, constant_latency)); // only tells the host if it actually changed
+
+    const double tail = *std::max_element (branch_tail.begin(), branch_tail.end());
+
+    if(tail != tail_seconds_.load (std::memory_order_relaxed)) {
+        tail_seconds_.store (tail, std::memory_order_relaxed);
+        updateHostDisplay (ChangeDetails().withLatencyChanged (true)); // there's no flag for the tail, this is the one that makes hosts ask for it again
+    }
+}
+
+unsigned HostAudioProcessor::rebind_parameters_() {
+    // the slots' parameters are laid out back to back in chain order. Changing one slot only shifts the slots after it,
+    // and the table skips every entry that already points at the right parameter
+    std::size_t first_parameter = 0;
+
+    for(std::size_t slot_i = 0; slot_i < slots_.size(); ++slot_i) {
+        auto* inner = slots_[slot_i]->get_instance();
+        auto& listener = *slot_parameter_listeners_[slot_i];
+
+        if(listener.listening_to != inner) {
+            if(listener.listening_to != nullptr) {
+                listener.listening_to->removeListener(&listener); // the old instance has only been retired, it's still alive at this point
+            }
+
+            if(inner != nullptr) {
+                inner->addListener(&listener);
+            }
+
+            listener.listening_to = inner;
+        }
+
+        if(inner == nullptr) {
+            listener.first_parameter = -1;
+            continue;
+        }
+
+        const auto& inner_parameters = inner->getParameters();
+
+        listener.first_parameter = first_parameter < maximum_number_of_parameters_ ? (int) first_parameter : -1;
+        forwarding_table_.bind(first_parameter, inner_parameters);
+
+        first_parameter += (std::size_t) inner_parameters.size();
+    }
+
+    forwarding_table_.unbind_from(first_parameter);
+
+    return (unsigned) first_parameter;
+}
+
+void HostAudioProcessor::slot_parameter_listener::audioProcessorChanged(juce::AudioProcessor*, const ChangeDetails& details) {
+    slot.wake(); // e.g. a new program, which might make the plugin sound different
+    if(details.parameterInfoChanged) {
+        parameter_info_changed = true; // capturing the metadata calls into the plugin a lot, so it doesn't happen on whatever thread this is
+    }
+
+    if(details.latencyChanged) {
+        latency_changed = true; // setLatencySamples has to happen on the message thread anyway
+    }
+}
+
+void HostAudioProcessor::slot_parameter_listener::audioProcessorParameterChanged(juce::AudioProcessor*, int parameter_index, float value) {
+    slot.wake(); // someone is turning knobs on the plugin's editor, so they probably want to hear it
+    const int first = first_parameter.load(std::memory_order_relaxed);
+
+    if(first >= 0) {
+        table.inner_parameter_changed((std::size_t) (first + parameter_index), value); // ignores anything past the end of the table
+    }
+}
+
+void HostAudioProcessor::timerCallback() {
+    if(reclaimer_.pending() > 0) {
+        reclaimer_.collect();
+    }
+
+    refresh_parameter_metadata_();
+    refresh_latency_();
+    drain_parameter_changes_();
+}
+
+void HostAudioProcessor::refresh_latency_() {
+    bool changed = false;
+
+    for(auto& listener : slot_parameter_listeners_) {
+        changed |= listener->latency_changed.exchange(false);
+    }
+
+    if(changed) {
+        update_latency_(); // asks every slot again, which also picks up a tail that changed along with the latency
+    }
+}
+
+void HostAudioProcessor::refresh_parameter_metadata_() {
+    std::array<bool, maximum_number_of_slots> changed {};
+    bool anything_changed = false;
+
+    for(std::size_t slot_i = 0; slot_i < slots_.size(); ++slot_i) {
+        changed[slot_i] = slot_parameter_listeners_[slot_i]->parameter_info_changed.exchange(false);
+        anything_changed |= changed[slot_i];
+    }
+
+    if(! anything_changed) {
         return;
     }
 
-    if (auto savedPluginList = pluginList.createXml()) {
-        appProperties.getUserSettings()->setValue ("pluginList", savedPluginList.get());
-        appProperties.saveIfNeeded();
+    rebind_parameters_(); // in case the number of parameters changed too
+
+    for(std::size_t slot_i = 0; slot_i < slots_.size(); ++slot_i) {
+        auto* inner = slots_[slot_i]->get_instance();
+        const int first_parameter = slot_parameter_listeners_[slot_i]->first_parameter;
+
+        if(changed[slot_i] && inner != nullptr && first_parameter >= 0) {
+            forwarding_table_.refresh_metadata((std::size_t) first_parameter, inner->getParameters());
+        }
     }
+
+    updateHostDisplay(ChangeDetails().withParameterInfoChanged(true));
 }
 
-void HostAudioProcessor::swap_read_write() {
-                                              // xoring with 1 is equivalent to boolean negation
-    processor_read_ping_pong_index_.fetch_xor(1, std::memory_order_release); // use release because we need to make sure that all of our pointers have been set by the time the audio thread sees the new value of this variable
+void HostAudioProcessor::drain_parameter_changes_() noexcept {
+    // setValueNotifyingHost would also call setValue, which would just set the inner parameter to the value it already has
+    parameter_changes_.drain([this] (std::size_t parameter_index, float value) {
+        parameters_[parameter_index]->sendValueChangedMessageToListeners(value);
+    });
 }
 
 
@@ -3,6 +3,17 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 
 #include "forwarding_parameter_ptr.h"
+#include "epoch_reclaimer.h"
+#include "inner_plugin_loader.h"
+#include "inner_plugin_slot.h"
+#include "instance_pool.h"
+#include "latency_delay_line.h"
+#include "plugin_registry.h"
+#include "realtime_worker_pool.h"
+#include "sandboxed_plugin_instance.h"
+#include "state_chunks.h"
+
+#include <array>
 
 //using namespace juce;
 
@@ -12,10 +23,16 @@ class HostAudioProcessorEditor;
 
 //==============================================================================
 class HostAudioProcessor : public  juce::AudioProcessor,
-                           private juce::ChangeListener
+                           private juce::Timer
 {
 public:
     HostAudioProcessor();
+    ~HostAudioProcessor() override;
+
+    // hosts only ask for the wrapper's buses once, so they can't follow whatever plugin gets loaded. Instead there's a sidechain input and enough aux outputs
+    // for a multi-out instrument up front, all of them off until the host enables them. The inner plugins' aux buses get matched up with them by index, see channel_adapter
+    static constexpr int maximum_number_of_aux_outputs = 14;
+    static constexpr int maximum_number_of_channels = 31; // per side, all buses together. Any more and a juce::AudioBuffer that refers to the host's channels would allocate
 
     bool isBusesLayoutSupported (const BusesLayout& layouts) const final;
     void prepareToPlay (double sr, int bs) final;
@@ -28,6 +45,7 @@ public:
     void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) final;
 
     void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) final;
+    inline bool supportsDoublePrecisionProcessing() const final    { return true; }
 
     inline bool hasEditor() const override                         { return true; }
     inline juce::AudioProcessorEditor* createEditor() override;
@@ -35,7 +53,7 @@ public:
     inline const juce::String getName() const final                { return "HostPluginDemo-cmake"; }
     inline bool acceptsMidi() const final                          { return true; }
     inline bool producesMidi() const final                         { return true; }
-    inline double getTailLengthSeconds() const final               { return 0.0; }
+    inline double getTailLengthSeconds() const final               { return tail_seconds_.load (std::memory_order_relaxed); } // the longest branch's, see update_latency_
 
     inline int getNumPrograms() final                              { return 0; }
     inline int getCurrentProgram() final                           { return 0; }
@@ -46,46 +64,156 @@ public:
     void getStateInformation (juce::MemoryBlock& destData) final;
     void setStateInformation (const void* data, int sizeInBytes) final;
 
-    void setNewPlugin (const juce::PluginDescription& pd, EditorStyle where, const juce::MemoryBlock& mb = {});
-    void clearPlugin();
-    bool isPluginLoaded() const;
+    // the wrapper hosts a serial chain of plugins. Every slot can be loaded, cleared, bypassed and swapped independently
+    // everything that takes a slot index defaults to the slot that's currently selected in the editor
+    static constexpr int maximum_number_of_slots = 8;
+    static constexpr int selected_slot = -1;
+
+    void setNewPlugin (const juce::PluginDescription& pd, EditorStyle where, juce::MemoryBlock mb = {}, int slot_index = selected_slot); // mb is the inner state, it gets moved into the loader
+    void clearPlugin (int slot_index = selected_slot);
+    bool isPluginLoaded (int slot_index = selected_slot) const;
+
+    std::unique_ptr<juce::AudioProcessorEditor> createInnerEditor (int slot_index = selected_slot) const;
+
+    EditorStyle getEditorStyle (int slot_index = selected_slot) const noexcept;
+
+    /// message thread only. The audio thread has its own view of each slot's plugin
+    juce::AudioPluginInstance* get_inner (int slot_index = selected_slot) const noexcept;
+
+    /// a bypassed slot doesn't touch the audio or midi at all
+    void set_slot_bypassed (int slot_index, bool should_be_bypassed);
+    bool is_slot_bypassed (int slot_index) const;
+
+    /// a sandboxed slot runs its plugin in a separate process (see sandboxed_plugin_instance), so a crashing plugin doesn't take the DAW down with it
+    /// changing this reloads whatever is in the slot (with its current state). Sandboxed plugins don't have editors or parameters (yet)
+    void set_slot_sandboxed (int slot_index, bool should_be_sandboxed);
+    bool is_slot_sandboxed (int slot_index) const;
+
+    /// what the round trips to the slot's sandbox cost. Empty if the slot isn't sandboxed (or nothing's loaded)
+    sandboxed_plugin_instance::cost get_sandbox_cost (int slot_index = selected_slot) const;
+
+    /// runs the slot's plugin at 2, 4 or 8 times the session's sample rate (1 is off), for plugins that alias. See halfband_oversampler
+    /// like sandboxing, changing this reloads whatever is in the slot. The filters' latency is reported to the host
+    static constexpr std::array<int, 4> oversampling_factors { 1, 2, 4, 8 };
+
+    void set_slot_oversampling (int slot_index, int factor);
+    int get_slot_oversampling (int slot_index) const;
+
+    /// calls the slot's plugin with blocks of exactly this size, whatever the host's are (0 is off), for plugins with a lot of overhead per call
+    /// or that only behave with power of two blocks. The plugin gets prepared with this block size. See sub_block_fifo
+    /// costs one sub-block of latency, which is reported to the host. Changing it reloads the slot like oversampling does
+    static constexpr std::array<int, 7> sub_block_sizes { 0, 32, 64, 128, 256, 512, 1024 };
+
+    void set_slot_sub_block_size (int slot_index, int block_size);
+    int get_slot_sub_block_size (int slot_index) const;
+
+    /// channel filter, note range, transpose, velocity curve and CC remapping for the midi going into the slot's plugin. See midi_stage
+    /// takes effect from the next block on, nothing gets reloaded
+    void set_slot_midi_settings (int slot_index, const midi_stage::settings& settings);
+    const midi_stage::settings& get_slot_midi_settings (int slot_index) const;
+
+    /// what each slot costs the audio thread, timed every block. See process_stats. Safe from any thread
+    process_stats::snapshot get_slot_stats (int slot_index = selected_slot) const;
+    void reset_stats(); // every slot
+
+    /// every slot's stats with the name of the plugin that's in it, for finding the plugins that cause xruns. Message thread
+    enum class stats_format { csv, json };
+    juce::String export_stats (stats_format format) const;
+
+    /// plugins that are swapped out of a slot (or cleared) stay loaded and prepared in a warm pool for a while, so switching back to one of them is instant. See instance_pool
+    /// the budget is in megabytes, 0 (the default) keeps pinned plugins only. Least recently used plugins are evicted first
+    void set_warm_pool_budget_mb (int megabytes);
+    int get_warm_pool_budget_mb() const;
+
+    /// the newest pooled instance of a pinned plugin stays in the pool whatever the budget says
+    void set_plugin_pinned (const juce::PluginDescription& pd, bool should_be_pinned);
+    bool is_plugin_pinned (const juce::PluginDescription& pd) const;
+
+    instance_pool::stats get_warm_pool_stats() const;
+
+    void set_selected_slot (int slot_index);
+    inline int get_selected_slot() const noexcept { return selected_slot_; }
+
+    // slots can also be split into parallel branches (e.g. several instruments layered on the same midi, or parallel fx)
+    // every branch gets its own copy of the input, runs its slots in series, and the branches' outputs are summed
+    // a branch with less latency than the slowest one is delayed by the difference first, so they line up
+    // the branches run on a pool of real time worker threads. If only one branch has anything in it, the chain runs in place on the host's buffer
+    static constexpr int maximum_number_of_branches = maximum_number_of_slots;
 
-    std::unique_ptr<juce::AudioProcessorEditor> createInnerEditor() const;
+    void set_slot_branch (int slot_index, int branch);
+    int get_slot_branch (int slot_index) const;
 
-    inline EditorStyle getEditorStyle() const noexcept { return editorStyle; }
+    /// per branch processing time, to see how well the graph scales with the number of cores
+    /// times are measured on whichever thread ran the branch, from the first slot's processBlock to the end of the last one's
+    struct graph_cost {
+        struct branch {
+            int number_of_slots = 0;
+            juce::int64 blocks = 0;
+            double average_seconds = 0.0, peak_seconds = 0.0;
+        };
 
-    juce::ApplicationProperties appProperties;
-    juce::AudioPluginFormatManager pluginFormatManager;
-    juce::KnownPluginList pluginList;
+        std::array<branch, maximum_number_of_branches> branches {};
+
+        int number_of_workers = 0;               // not counting the audio thread, which runs branches too
+        juce::int64 parallel_blocks = 0;         // blocks where more than one branch ran
+        double average_parallel_seconds = 0.0;   // wall clock time of the whole graph in those blocks
+        double average_branch_seconds_sum = 0.0; // what those blocks would have cost if the branches had run one after another
+
+        /// 1 means the workers didn't help at all
+        inline double speedup() const noexcept { return average_parallel_seconds > 0.0 ? average_branch_seconds_sum / average_parallel_seconds : 1.0; }
+    };
+
+    graph_cost get_graph_cost() const;
+
+    /// every wrapper in the process shares the formats (and whatever they've cached), see plugin_registry
+    /// they replace the public members appProperties and pluginFormatManager, which every wrapper made for itself
+    inline juce::AudioPluginFormatManager& get_format_manager() noexcept { return registry_->get_format_manager(); }
+
+    /// message thread. Every wrapper in the process shares this list, it's decoded the first time anything asks for it (see plugin_index)
+    juce::KnownPluginList& get_plugin_list();
     std::function<void()> pluginChanged;
+    std::function<void()> pluginLoadStarted; // lets the editor start polling the load progress
 
+    /// how many threads the PluginListComponent should scan with. 0 (scan on the message thread) if there's no scanner executable,
+    /// because then plugins are scanned in process and plenty of them don't like being loaded on several threads at once
+    int get_number_of_scan_threads() const;
 
-    void set_plugin_changed_flag();
+    /// when the inner plugin is swapped, the old and new instances both run for this long and their outputs get equal power crossfaded
+    /// so there's no click and the old plugin's tail isn't cut off. 0 means a hard switch at a block boundary
+    void set_swap_crossfade_ms(float milliseconds);
+    float get_swap_crossfade_ms() const;
 
-    void swap_read_write();
+    /// what the overlap window costs. Both averages are wall clock time spent in processBlock
+    struct swap_crossfade_cost {
+        juce::int64 normal_blocks = 0, overlap_blocks = 0;
+        double average_normal_block_seconds = 0.0, average_overlap_block_seconds = 0.0;
 
+        inline double extra_seconds_per_overlap_block() const noexcept { return average_overlap_block_seconds - average_normal_block_seconds; }
+    };
 
-    inline       std::unique_ptr<juce::AudioPluginInstance>& editor_write_inner()       { return inner_ping_pong[!processor_read_ping_pong_index_];  }
-    inline const std::unique_ptr<juce::AudioPluginInstance>& editor_write_inner() const { return inner_ping_pong[!processor_read_ping_pong_index_];  }
+    swap_crossfade_cost get_swap_crossfade_cost() const;
 
-    inline       std::unique_ptr<juce::AudioPluginInstance>& processor_read_inner()         { return inner_ping_pong[processor_read_ping_pong_index_]; }
-    inline const std::unique_ptr<juce::AudioPluginInstance>& processor_read_inner()   const { return inner_ping_pong[processor_read_ping_pong_index_]; }
+    /// keeps the latency the host sees at this many ms, however much the chain actually has, by delaying the output by the difference
+    /// so swapping to a plugin with a different latency doesn't make the host recompute its delay compensation (which a lot of hosts only do on stop/start)
+    /// if the chain ever needs more than this, the chain's latency is reported instead. 0 turns it off and reports the chain's latency as it is
+    void set_constant_latency_ms(float milliseconds);
+    float get_constant_latency_ms() const;
 
+    /// puts slots whose plugin has gone silent to sleep, so idle plugins cost next to nothing (see inner_plugin_slot::set_silence_threshold). Message thread
+    /// off by default, because a plugin that makes sound without any input or midi (from its own on-screen keyboard, or a free running sequencer) would stay asleep
+    /// what it saves shows up in the slots' stats
+    void set_sleep_when_silent(bool should_sleep);
+    bool is_sleep_when_silent() const;
 
-    std::atomic<bool> plugin_already_changed_in_this_process_block_call; // this warrants some explanation
-                                                                         // Long story short, it's possible for swap_read_write to get called while processBlock is still using processor_read_inner()
-                                                                         // this isn't an issue on its own (doesn't cause a data race), because the usage of memory_order_release ensures that by the time the swapping atomic write is visible
-                                                                         // the new plugin is no longer being written to
-                                                                         // However, it does mean that, for the remainder of that process call, processBlock is technically reading old data
-                                                                         // again, on its own this doesn't cause a data race. But it does become an issue if another plugin gets loaded in that same processBlock call
-                                                                         // In that case, processBlock will be reading from editor_write_inner() while the editor is writing to it, causing a data race
-                                                                         // the solution I came up with for this issue is to set inside_process_block to true at the beginning of processBlock and false at the end,
-                                                                         // and set plugin_already_changed_in_this_process_block_call to true in swap_read_write and false also at the end of processBlock
-                                                                         // then, before trying to modify editor_write_inner(), the editor will check to see if(inside_process_block&&plugin_already_changed_in_this_process_block_call)
-                                                                         // and if it evaluates to true it will return from whatever function was being called without modifying editor_write_inner()
-                                                                         // I think this is an okay solution because I don't think it's physically possible for a user to interact with the gui fast enough to load multiple plugins within one processBlock call,
-                                                                         // (maybe it could happen if the gui freezes or something and a bunch of queued changes get reported to the processor at almost the same time)
-                                                                         // so this early out path will likely never be hit
+    /// the peak level input and output have to stay at or below to count as silent
+    void set_silence_threshold_db(float decibels);
+    float get_silence_threshold_db() const;
+
+    /// these are all message thread only. setNewPlugin returns straight away, the plugin is built in the background
+    bool is_loading_plugin (int slot_index = selected_slot) const;
+    float get_plugin_load_progress (int slot_index = selected_slot) const;
+    juce::String get_plugin_load_stage (int slot_index = selected_slot) const;
+    void cancel_plugin_load (int slot_index = selected_slot);
 
 private:
     juce::CriticalSection innerMutex; // I don't understand why this is necessary, because afaict this mutex only ever gets locked on the message thread
@@ -93,30 +221,227 @@ private:
                                       // but mutexes really shouldn't be used on the audio thread to begin with, so idk
                                       // --original-picture
 
-    std::unique_ptr<juce::AudioPluginInstance> inner_ping_pong[2] = {nullptr, nullptr}; // my lock-free solution for synchronizing plugin changes is to hold two AudioPluginInstances and ping pong between them using an atomic index
-                                                                                        // so that one plugin can be loaded on the message thread while the other is being used on the audio thread without either messing with the other's data
-                                                                                        // --original-picture
-
     //std::unique_ptr<juce::AudioPluginInstance> inner; // this is how it looked in the original HostPluginDemo --original-picture
 
-    std::atomic<unsigned char> processor_read_ping_pong_index_ = 0; // I would have used a bool for this variable (because the index can only ever be 0 or 1),
-                                                                    // but I need to atomically flip it and std::atomic<bool> has no atomic negation operation
-                                                                    // so instead I use unsigned char and flip it by atomically xoring it with 1
+    juce::SharedResourcePointer<plugin_registry> registry_; // before everything that holds instances, so the formats that made them are destroyed after all of them
+
+    epoch_reclaimer reclaimer_ { maximum_number_of_slots * inner_plugin_slot::pins_per_slot }; // shared by all slots, so processBlock only has to publish one epoch per block
+
+    std::array<std::unique_ptr<inner_plugin_slot>, maximum_number_of_slots> slots_; // each slot owns its instance on the message thread and publishes it to the audio thread
+                                                                                     // this replaces the ping pong between two instances, which only worked as long as nobody swapped twice within one processBlock call
+    std::array<EditorStyle, maximum_number_of_slots> editor_styles_ {};
+    std::array<bool, maximum_number_of_slots> sandboxed_ {}; // message thread. What the next load of the slot does
+    std::array<int, maximum_number_of_slots> oversampling_ {}; // same. Filled with 1s in the constructor
+    std::array<int, maximum_number_of_slots> sub_block_sizes_ {}; // same. 0 is off
+    int selected_slot_ = 0; // message thread
+
+    inline int resolve_slot_(int slot_index) const noexcept { return slot_index == selected_slot ? selected_slot_ : slot_index; }
+
+    inner_plugin_loader loader_ { *registry_ };
+    instance_pool pool_; // message thread. Every slot recycles its replaced instances into it
+
+    static constexpr int default_warm_pool_budget_mb_ = 0; // every wrapper has its own pool, so a budget by default would be that times however many wrappers the session has
+
+    // what getStateInformation saves of the pool. Hosts can call that from their own save threads, and the pool itself is message thread only,
+    // so these are kept up to date whenever the message thread changes the pool's settings
+    std::atomic<int> warm_pool_budget_mb_ = default_warm_pool_budget_mb_;
+    juce::String pinned_plugins_; // innerMutex. The pinned plugin identifiers, one per line
+
+    /// message thread. Copies pool_.get_pinned() into pinned_plugins_
+    void update_pinned_plugins_();
+
+    std::atomic<realtime_worker_pool*> workers_ = nullptr; // the registry's, once a slot is on a branch other than the first. Until then the graph runs on the host's thread alone
+
+    // audio thread. Rebuilt at the start of every block from the slots' branch assignments
+    struct graph_routing {
+        std::array<std::array<int, maximum_number_of_slots>, maximum_number_of_branches> slots {};
+        std::array<int, maximum_number_of_branches> number_of_slots {};
+        std::array<int, maximum_number_of_branches> active_branches {}; // only branches with at least one slot that has work
+        int number_of_active_branches = 0;
+        std::array<bool, maximum_number_of_branches> overlapping {};     // written by whichever thread ran the branch
+    } routing_;
+
+    // one copy of the input per branch (the first active branch works in place on the host's buffer). Allocated in prepareToPlay for the precision we're using
+    std::array<juce::AudioBuffer<float>,  maximum_number_of_branches> branch_audio_;
+    std::array<juce::AudioBuffer<double>, maximum_number_of_branches> branch_audio_double_;
+    std::array<juce::MidiBuffer, maximum_number_of_branches> branch_midi_;
+    static constexpr int branch_midi_bytes_ = 16384;
+
+    // a block bigger than prepareToPlay promised goes through the graph in chunks, see process_in_chunks_. Its midi gets split and merged back with these
+    juce::MidiBuffer chunk_midi_, chunk_midi_out_;
+
+    struct graph_stats {
+        struct branch {
+            std::atomic<juce::int64> blocks = 0, ticks = 0, peak_ticks = 0;
+        };
 
+        std::array<branch, maximum_number_of_branches> branches;
+        std::atomic<juce::int64> parallel_blocks = 0, parallel_ticks = 0, parallel_branch_ticks = 0;
 
-    // arbitrary limit --original-picture
-    static constexpr std::size_t maximum_number_of_parameters_ = 64;
+        void reset() noexcept;
+        void record_branch(int branch, juce::int64 ticks) noexcept;
+        void record_parallel_block(juce::int64 ticks, juce::int64 branch_ticks) noexcept;
+    } graph_stats_;
+
+    // what prepareToPlay worked out from the layout, so processBlock doesn't have to ask for it (getBusesLayout allocates)
+    int main_input_channels_ = 0, sidechain_channels_ = 0, output_channels_ = 0;
+
+    // the host's sidechain, if it shares channels with anything we output (the aux outputs, whenever both are enabled). Copied at the start of every block, before anything writes there
+    juce::AudioBuffer<float>  sidechain_audio_;
+    juce::AudioBuffer<double> sidechain_audio_double_;
+
+    template<typename sample_t> struct graph_block;
+
+    /// audio thread. Both processBlocks, so the float and the double path can't drift apart
+    template<typename sample_t>
+    void process_block_ (juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer);
+
+    /// audio thread. Runs every slot, in series within a branch and in parallel across branches. Returns true if any slot was crossfading
+    /// every slot gets the same sidechain, see inner_plugin_slot::process
+    template<typename sample_t>
+    bool process_graph_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain, int crossfade_length);
+
+    /// audio thread. The first number_of_branches active branches, summed into the host's buffer. Needs the scratch to be big enough for the buffer
+    template<typename sample_t>
+    bool process_branches_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain, int crossfade_length, int number_of_branches);
+
+    /// audio thread. process_branches_ on one chunk_size piece of the buffer after the other, for hosts that send more than they said they would
+    template<typename sample_t>
+    bool process_in_chunks_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain, int crossfade_length, int chunk_size);
+
+    template<typename sample_t>
+    static void process_branch_(void* context, int active_branch_index) noexcept;
+
+    void build_routing_() noexcept;
+
+    static constexpr float maximum_swap_crossfade_ms_ = 2000.f;
+    std::atomic<float> swap_crossfade_ms_ = 0.f;
+
+    static constexpr float maximum_constant_latency_ms_ = 500.f;
+    std::atomic<float> constant_latency_ms_ = 0.f;
+
+    static constexpr float minimum_silence_threshold_db_ = -150.f, maximum_silence_threshold_db_ = -30.f;
+    bool sleep_when_silent_ = false;       // message thread
+    float silence_threshold_db_ = -100.f;  // same
+
+    /// message thread. Tells every slot what set_sleep_when_silent and set_silence_threshold_db add up to
+    void apply_silence_threshold_();
+    std::atomic<int> compensation_delay_ = 0;      // samples, what the output delay should be right now. Set by update_latency_
+    std::atomic<double> tail_seconds_ = 0.0;       // same
+
+    /// what set_constant_latency_ms delays the output with. Published and retired like a slot's midi_stage, only the precision we're using gets memory
+    struct output_delay {
+        latency_delay_line<float> line;
+        latency_delay_line<double> line_double;
+    };
+
+    std::unique_ptr<output_delay> output_delay_;                     // message thread (or prepareToPlay), null if there's no constant latency
+    std::atomic<output_delay*> published_output_delay_ = nullptr;    // only used within a block, so it doesn't need a pin
+
+    /// message thread (or prepareToPlay). Builds output_delay_ for the current constant latency, sample rate and block size, and publishes it
+    /// the new line starts out silent, so changing the constant latency while playing drops whatever the old one still held, same as when a host changes its own delay compensation
+    void rebuild_output_delay_();
+    int prepared_block_size_ = 0; // what prepareToPlay was last called with
+
+    /// what lines the parallel branches up with the slowest one before they're summed. Published and retired like output_delay, only the precision we're using gets memory
+    /// a branch's line only has room for the delay it needed when it was built
+    struct branch_delays {
+        std::array<latency_delay_line<float>,  maximum_number_of_branches> lines;
+        std::array<latency_delay_line<double>, maximum_number_of_branches> lines_double;
+    };
+
+    std::array<std::atomic<int>, maximum_number_of_branches> branch_delay_samples_ {}; // how far behind the slowest branch each one is. Set by update_latency_
+    std::unique_ptr<branch_delays> branch_delays_;                                      // message thread (or prepareToPlay), null if the branches line up anyway
+    std::atomic<branch_delays*> published_branch_delays_ = nullptr;                     // only used within a block, so it doesn't need a pin
+
+    /// message thread (or prepareToPlay). Builds branch_delays_ if a branch needs more delay than its line has room for, or always if rebuild is true
+    /// a rebuilt line starts out silent, same as rebuild_output_delay_
+    void update_branch_delays_(bool rebuild);
+
+    /// constant_latency_ms_ at the current sample rate, rounded up. 0 if it's off
+    int get_constant_latency_samples_() const noexcept;
+
+    struct crossfade_stats {
+        std::atomic<juce::int64> normal_blocks = 0, normal_ticks = 0, overlap_blocks = 0, overlap_ticks = 0;
+
+        void reset() noexcept;
+        void record(bool overlapping, juce::int64 ticks) noexcept;
+        swap_crossfade_cost get() const noexcept;
+    } crossfade_stats_;
+
+    /// message thread. Makes instance the one processBlock uses for that slot and hands the old one to reclaimer_
+    void publish_inner_(int slot_index, std::unique_ptr<juce::AudioPluginInstance> instance, channel_adapter adapter = {});
+
+    /// message thread. Everything setNewPlugin does once it has an instance, whether that came from the loader or from pool_
+    void finish_load_(int slot_index, EditorStyle where, inner_plugin_loader::result&& loaded);
+
+    /// message thread (or prepareToPlay). Tells the host what the slots add up to (see inner_plugin_slot::get_latency_samples), or the constant latency if there is one,
+    /// and what the longest tail is. Whenever a slot changes, or a plugin says its latency did
+    void update_latency_();
+
+    /// message thread. Forwards the parameters of every loaded slot, in chain order. Returns how many parameters the chain has in total
+    unsigned rebind_parameters_();
+
+    // hosts want a fixed number of parameters, so this many always exist. Big enough for the biggest synths around, rather than the demo's arbitrary 64
+    static constexpr std::size_t maximum_number_of_parameters_ = 2048;
+
+    // the inner plugins' parameter changes are queued (from any thread) and passed on to the host in drain_parameter_changes_(),
+    // which runs at the end of every block and on the timer, rather than with a synchronous setValueNotifyingHost from whatever thread the change happened on
+    parameter_change_queue parameter_changes_ { maximum_number_of_parameters_ };
+    parameter_forwarding_table forwarding_table_ { maximum_number_of_parameters_, parameter_changes_ };
+
+    std::vector<forwarding_parameter_ptr*> parameters_; // owned by AudioProcessor
+
+    // one per slot instead of one per parameter. The inner plugin's parameter i is the wrapper's parameter first_parameter + i
+    struct slot_parameter_listener final : public juce::AudioProcessorListener {
+        slot_parameter_listener (parameter_forwarding_table& t, inner_plugin_slot& s) : table (t), slot (s) {}
+
+        void audioProcessorParameterChanged (juce::AudioProcessor*, int parameter_index, float value) override;
+        void audioProcessorChanged (juce::AudioProcessor*, const ChangeDetails& details) override;
+
+        parameter_forwarding_table& table;
+        inner_plugin_slot& slot;                          // woken up by every change, see inner_plugin_slot::wake
+        std::atomic<bool> parameter_info_changed = false; // set from whatever thread the plugin tells us on, handled by the timer
+        std::atomic<bool> latency_changed = false;        // same
+        std::atomic<int> first_parameter = -1;        // -1 while the slot is empty (or doesn't fit in the table at all)
+        juce::AudioProcessor* listening_to = nullptr; // message thread
+    };
+
+    std::array<std::unique_ptr<slot_parameter_listener>, maximum_number_of_slots> slot_parameter_listeners_;
+
+    /// any thread, doesn't block. Does nothing if another thread is already draining
+    void drain_parameter_changes_() noexcept;
+
+    /// message thread. Recaptures the parameter metadata of every slot whose plugin said its parameter info changed
+    void refresh_parameter_metadata_();
+
+    /// message thread. update_latency_ if any slot's plugin said its latency changed
+    void refresh_latency_();
+
+    static constexpr int timer_interval_ms_ = 30;
 
-    std::vector<forwarding_parameter_ptr*> parameters_;
 
 
 
-    EditorStyle editorStyle = EditorStyle{};
     bool active = false; // I don't know what this does --original-picture
     juce::ScopedMessageBox messageBox;
 
     static constexpr const char* innerStateTag = "inner_state";
     static constexpr const char* editorStyleTag = "editor_style";
-
-    void changeListenerCallback (juce::ChangeBroadcaster* source) final;
+    static constexpr const char* swapCrossfadeTag = "swap_crossfade_ms";
+    static constexpr const char* slotTag = "slot";
+    static constexpr const char* slotIndexTag = "index";
+    static constexpr const char* bypassedTag = "bypassed";
+    static constexpr const char* selectedSlotTag = "selected_slot";
+    static constexpr const char* branchTag = "branch";
+
+    // chunk ids of the binary state, see state_chunks.h. The tags above are only used for reading the old xml state now
+    static constexpr const char wrapperChunk[5] = "WRAP";
+    static constexpr const char slotChunk[5] = "SLOT";
+
+    void restore_binary_state_ (const void* data, std::size_t size, std::array<bool, maximum_number_of_slots>& restored);
+    void restore_xml_state_ (const void* data, std::size_t size, std::array<bool, maximum_number_of_slots>& restored);
+    void restore_slot_ (int slot_index, const juce::PluginDescription& pd, EditorStyle where, bool bypassed, int branch, bool sandboxed, int oversampling, int sub_block_size, juce::MemoryBlock state);
+
+    void timerCallback() final; // collects retired inner plugins, drains parameter changes and picks up latency changes
 };
@@ -0,0 +1,787 @@
+/**
+ * HostPluginDemo-cmake-bench
+ *
+ * drives HostAudioProcessor offline, without an audio device or a window, so it can run on CI machines as a regression gate
+ *     HostPluginDemo-cmake-bench [plugin file or identifier] [options]
+ * loads the plugin into slot 1 (or runs the empty wrapper if there isn't one), renders synthetic audio and midi through processBlock
+ * for every block size asked for, and reports
+ *     - throughput (realtime factor) and the per-block latency percentiles, and how many blocks took longer than they last
+ *     - heap allocations per block (operator new, on any thread, while processBlock is running)
+ *     - the cost of automating a number of the wrapper's parameters every block (--automate)
+ *     - getStateInformation/setStateInformation time, state size and the peak heap they need on top of what's already allocated
+ *     - how long a plugin swap takes, from setNewPlugin until the new instance is live (that includes rebinding the parameters)
+ *     - the state format on its own, without a plugin: the binary chunks against the old xml/base64 format, for generated inner states of a few sizes
+ *     - parameter_forwarding_table::bind on its own, for synthetic plugins with more and more parameters
+ *
+ * options
+ *     --format <name>         the plugin format (VST3, LV2, ...). Default: the first one that finds a plugin in the file
+ *     --rate <hz>             default 48000
+ *     --blocks <n,n,...>      block sizes, default 32,64,128,256,512,1024
+ *     --seconds <s>           how much audio to render per block size (and automation count), default 10
+ *     --midi <events/s>       density of the synthetic notes and controllers, default 1000
+ *     --automate <n,n,...>    how many parameters get a new value every block, default 0
+ *     --sub-block <n>         run slot 1 in sub-blocks of n samples (see sub_block_fifo)
+ *     --oversampling <n>      run slot 1 at 2, 4 or 8 times the rate
+ *     --double                process in double precision
+ *     --iterations <n>        state and swap repetitions, default 10
+ *     --warm-pool <mb>        the warm pool's budget (see instance_pool). Default 0, so every state load and swap is a real load. With a budget they mostly come out of the pool
+ *     --state-mb <n,n,...>    inner state sizes for the format comparison, default 1,4,16,64. 0 skips it
+ *     --parameters <n,n,...>  parameter counts for the bind sweep, default 16,64,256,1024,4096. 0 skips it
+ *     --json                  print one JSON object instead of the tables
+ *
+ * exit codes: 0 if everything ran, 1 for bad arguments or a plugin that didn't load
+ */
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "PluginProcessor.h"
+#include "parameter_change_queue.h"
+#include "parameter_forwarding_table.h"
+#include "state_chunks.h"
+
+//==============================================================================
+// counts every allocation in the process. The size goes in front of the block so that delete knows how much is being given back
+namespace {
+    std::atomic<std::uint64_t> allocations { 0 };
+    std::atomic<std::int64_t> allocated_bytes { 0 }, peak_allocated_bytes { 0 };
+
+    constexpr std::size_t allocation_header = alignof(std::max_align_t);
+
+    void* counted_allocate(std::size_t size) noexcept {
+        auto* block = static_cast<unsigned char*>(std::malloc(size + allocation_header));
+
+        if(block == nullptr) {
+            return nullptr;
+        }
+
+        *reinterpret_cast<std::size_t*>(block) = size;
+
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        const auto now = allocated_bytes.fetch_add((std::int64_t) size, std::memory_order_relaxed) + (std::int64_t) size;
+
+        for(auto peak = peak_allocated_bytes.load(std::memory_order_relaxed); now > peak && ! peak_allocated_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed);) {}
+
+        return block + allocation_header;
+    }
+
+    void counted_free(void* pointer) noexcept {
+        if(pointer == nullptr) {
+            return;
+        }
+
+        auto* block = static_cast<unsigned char*>(pointer) - allocation_header;
+        allocated_bytes.fetch_sub((std::int64_t) *reinterpret_cast<std::size_t*>(block), std::memory_order_relaxed);
+        std::free(block);
+    }
+}
+
+void* operator new(std::size_t size) {
+    if(auto* pointer = counted_allocate(size)) {
+        return pointer;
+    }
+
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept   { return counted_allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return counted_allocate(size); }
+
+void operator delete(void* pointer) noexcept                           { counted_free(pointer); }
+void operator delete[](void* pointer) noexcept                         { counted_free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept              { counted_free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept            { counted_free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept    { counted_free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept  { counted_free(pointer); }
+
+//==============================================================================
+namespace {
+    constexpr int exit_ok = 0, exit_failed = 1;
+
+    struct options {
+        juce::String plugin, format;
+        double sample_rate = 48000.0;
+        juce::Array<int> block_sizes { 32, 64, 128, 256, 512, 1024 };
+        double seconds = 10.0;
+        double midi_events_per_second = 1000.0;
+        juce::Array<int> automated_parameters { 0 };
+        int sub_block_size = 0, oversampling_factor = 1;
+        bool double_precision = false;
+        int iterations = 10;
+        int warm_pool_mb = 0;
+        juce::Array<int> state_sizes_mb { 1, 4, 16, 64 };
+        juce::Array<int> parameter_counts { 16, 64, 256, 1024, 4096 };
+        bool json = false;
+    };
+
+    juce::Array<int> parse_list(const juce::String& text) {
+        juce::Array<int> values;
+
+        for(const auto& token : juce::StringArray::fromTokens(text, ",", "")) {
+            if(token.trim().isNotEmpty()) {
+                values.add(token.trim().getIntValue());
+            }
+        }
+
+        return values;
+    }
+
+    bool parse(const juce::ArgumentList& arguments, options& o) {
+        for(int i = 0; i < arguments.size(); ++i) {
+            const auto& argument = arguments[i].text;
+            const bool has_value = i + 1 < arguments.size();
+
+            if(argument == "--double")                      o.double_precision = true;
+            else if(argument == "--json")                   o.json = true;
+            else if(! argument.startsWith("--"))            o.plugin = argument;
+            else if(! has_value)                            return false;
+            else if(argument == "--format")                 o.format = arguments[++i].text;
+            else if(argument == "--rate")                   o.sample_rate = arguments[++i].text.getDoubleValue();
+            else if(argument == "--blocks")                 o.block_sizes = parse_list(arguments[++i].text);
+            else if(argument == "--seconds")                o.seconds = arguments[++i].text.getDoubleValue();
+            else if(argument == "--midi")                   o.midi_events_per_second = arguments[++i].text.getDoubleValue();
+            else if(argument == "--automate")               o.automated_parameters = parse_list(arguments[++i].text);
+            else if(argument == "--sub-block")              o.sub_block_size = arguments[++i].text.getIntValue();
+            else if(argument == "--oversampling")           o.oversampling_factor = arguments[++i].text.getIntValue();
+            else if(argument == "--iterations")             o.iterations = arguments[++i].text.getIntValue();
+            else if(argument == "--warm-pool")              o.warm_pool_mb = arguments[++i].text.getIntValue();
+            else if(argument == "--state-mb")               o.state_sizes_mb = parse_list(arguments[++i].text);
+            else if(argument == "--parameters")             o.parameter_counts = parse_list(arguments[++i].text);
+            else                                            return false;
+        }
+
+        const auto contains = [] (const auto& values, int value) { return std::find(values.begin(), values.end(), value) != values.end(); };
+        const auto is_positive = [] (int value) { return value > 0; };
+
+        o.state_sizes_mb.removeAllInstancesOf(0);
+        o.parameter_counts.removeAllInstancesOf(0);
+
+        return o.sample_rate > 0.0 && o.seconds > 0.0 && o.iterations > 0 && o.warm_pool_mb >= 0 && ! o.block_sizes.isEmpty() && ! o.automated_parameters.isEmpty()
+            && std::all_of(o.block_sizes.begin(), o.block_sizes.end(), is_positive)
+            && std::all_of(o.state_sizes_mb.begin(), o.state_sizes_mb.end(), is_positive)
+            && std::all_of(o.parameter_counts.begin(), o.parameter_counts.end(), is_positive)
+            && contains(HostAudioProcessor::sub_block_sizes, o.sub_block_size)
+            && contains(HostAudioProcessor::oversampling_factors, o.oversampling_factor);
+    }
+
+    /// runs the message loop until done() or the timeout. The wrapper's loads finish on the message thread
+    template<typename predicate_t>
+    bool pump_until(predicate_t&& done, int timeout_ms = 60000) {
+        const auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32) timeout_ms;
+
+        while(! done()) {
+            if(juce::Time::getMillisecondCounter() > deadline) {
+                return false;
+            }
+
+            juce::MessageManager::getInstance()->runDispatchLoopUntil(1);
+        }
+
+        return true;
+    }
+
+    bool is_settled(const HostAudioProcessor& processor) {
+        return ! processor.is_loading_plugin(0);
+    }
+
+    double get_seconds(juce::int64 ticks) {
+        return juce::Time::highResolutionTicksToSeconds(ticks);
+    }
+
+    /// p between 0 and 1, of values sorted in ascending order
+    double get_percentile(const std::vector<double>& sorted, double p) {
+        if(sorted.empty()) {
+            return 0.0;
+        }
+
+        return sorted[juce::jmin(sorted.size() - 1, (std::size_t) (p * (double) sorted.size()))];
+    }
+
+    std::unique_ptr<juce::PluginDescription> find_plugin(juce::AudioPluginFormatManager& format_manager, const options& o) {
+        for(auto* format : format_manager.getFormats()) {
+            if(o.format.isNotEmpty() && format->getName() != o.format) {
+                continue;
+            }
+
+            juce::OwnedArray<juce::PluginDescription> found;
+            format->findAllTypesForFile(found, o.plugin);
+
+            if(! found.isEmpty()) {
+                return std::make_unique<juce::PluginDescription>(*found[0]);
+            }
+        }
+
+        return nullptr;
+    }
+
+    //==============================================================================
+    struct render_result {
+        int block_size = 0, automated = 0;
+        juce::int64 blocks = 0, overruns = 0, blocks_that_allocated = 0;
+        double realtime_factor = 0.0, mean_us = 0.0, ns_per_sample = 0.0, allocations_per_block = 0.0;
+        double p50_us = 0.0, p90_us = 0.0, p99_us = 0.0, p999_us = 0.0, worst_us = 0.0;
+
+        juce::var to_var() const {
+            auto* object = new juce::DynamicObject();
+
+            object->setProperty("block_size", block_size);
+            object->setProperty("automated_parameters", automated);
+            object->setProperty("blocks", blocks);
+            object->setProperty("realtime_factor", realtime_factor);
+            object->setProperty("mean_us", mean_us);
+            object->setProperty("ns_per_sample", ns_per_sample);
+            object->setProperty("p50_us", p50_us);
+            object->setProperty("p90_us", p90_us);
+            object->setProperty("p99_us", p99_us);
+            object->setProperty("p999_us", p999_us);
+            object->setProperty("worst_us", worst_us);
+            object->setProperty("overruns", overruns);
+            object->setProperty("allocations_per_block", allocations_per_block);
+            object->setProperty("blocks_that_allocated", blocks_that_allocated);
+
+            return juce::var(object);
+        }
+    };
+
+    template<typename sample_t>
+    render_result render(HostAudioProcessor& processor, const options& o, int block_size, int automated) {
+        processor.setProcessingPrecision(std::is_same_v<sample_t, double> ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails(o.sample_rate, block_size);
+        processor.prepareToPlay(o.sample_rate, block_size);
+        pump_until([&processor] { return is_settled(processor); }); // the plugin might get re-prepared on the message thread
+
+        const int number_of_channels = juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+        const auto number_of_blocks = (juce::int64) std::ceil(o.seconds * o.sample_rate / block_size);
+        const auto warm_up_blocks = (juce::int64) std::ceil(0.5 * o.sample_rate / block_size);
+
+        // everything the blocks need is made up front, so none of it gets timed or counted
+        juce::AudioBuffer<sample_t> audio(number_of_channels, block_size);
+        juce::MidiBuffer midi;
+        midi.ensureSize(65536);
+
+        juce::Random random(1234);
+        std::vector<double> block_seconds;
+        block_seconds.reserve((std::size_t) number_of_blocks);
+
+        auto& parameters = processor.getParameters();
+        const int number_of_automated = juce::jmin(automated, parameters.size());
+        const double events_per_block = o.midi_events_per_second * block_size / o.sample_rate;
+        double pending_events = 0.0;
+
+        render_result result;
+        result.block_size = block_size;
+        result.automated = number_of_automated;
+
+        std::uint64_t total_allocations = 0;
+        juce::int64 total_ticks = 0;
+
+        for(juce::int64 block_i = -warm_up_blocks; block_i < number_of_blocks; ++block_i) {
+            for(int channel = 0; channel < number_of_channels; ++channel) {
+                auto* samples = audio.getWritePointer(channel);
+
+                for(int sample = 0; sample < block_size; ++sample) {
+                    samples[sample] = (sample_t) (random.nextFloat() * 0.2f - 0.1f);
+                }
+            }
+
+            // notes and controllers, half and half. Every note on gets its note off in the same block, so nothing hangs
+            midi.clear();
+
+            for(pending_events += events_per_block; pending_events >= 1.0; pending_events -= 1.0) {
+                const int position = random.nextInt(block_size);
+                const int channel = 1 + random.nextInt(16);
+
+                if(random.nextBool()) {
+                    const int note = random.nextInt(128);
+                    midi.addEvent(juce::MidiMessage::noteOn(channel, note, (juce::uint8) (1 + random.nextInt(127))), position);
+                    midi.addEvent(juce::MidiMessage::noteOff(channel, note), juce::jmin(block_size - 1, position + 1));
+                }
+                else {
+                    midi.addEvent(juce::MidiMessage::controllerEvent(channel, random.nextInt(120), random.nextInt(128)), position);
+                }
+            }
+
+            const auto allocations_before = allocations.load(std::memory_order_relaxed);
+            const auto started = juce::Time::getHighResolutionTicks();
+
+            // what a host does for automation: set the values, then call processBlock
+            for(int parameter = 0; parameter < number_of_automated; ++parameter) {
+                parameters.getUnchecked(parameter)->setValue((float) ((block_i + parameter) & 0xff) / 255.f);
+            }
+
+            processor.processBlock(audio, midi);
+
+            const auto elapsed = juce::Time::getHighResolutionTicks() - started;
+            const auto block_allocations = allocations.load(std::memory_order_relaxed) - allocations_before;
+
+            if(block_i < 0) {
+                continue; // warming up
+            }
+
+            block_seconds.push_back(get_seconds(elapsed));
+            total_ticks += elapsed;
+            total_allocations += block_allocations;
+            result.blocks_that_allocated += block_allocations > 0 ? 1 : 0;
+            result.overruns += get_seconds(elapsed) > block_size / o.sample_rate ? 1 : 0;
+        }
+
+        processor.releaseResources();
+
+        std::sort(block_seconds.begin(), block_seconds.end());
+
+        result.blocks = number_of_blocks;
+        result.realtime_factor = (double) number_of_blocks * block_size / o.sample_rate / juce::jmax(1.0e-9, get_seconds(total_ticks));
+        result.mean_us = get_seconds(total_ticks) * 1.0e6 / (double) number_of_blocks;
+        result.ns_per_sample = result.mean_us * 1.0e3 / block_size;
+        result.p50_us = get_percentile(block_seconds, 0.5) * 1.0e6;
+        result.p90_us = get_percentile(block_seconds, 0.9) * 1.0e6;
+        result.p99_us = get_percentile(block_seconds, 0.99) * 1.0e6;
+        result.p999_us = get_percentile(block_seconds, 0.999) * 1.0e6;
+        result.worst_us = block_seconds.empty() ? 0.0 : block_seconds.back() * 1.0e6;
+        result.allocations_per_block = (double) total_allocations / (double) number_of_blocks;
+
+        return result;
+    }
+
+    //==============================================================================
+    struct timing {
+        double mean_ms = 0.0, worst_ms = 0.0;
+        juce::int64 peak_extra_bytes = 0;  // the most the heap grew by during one repetition
+
+        void add(juce::int64 ticks, juce::int64 extra_bytes, int iterations) {
+            const double ms = get_seconds(ticks) * 1.0e3;
+            mean_ms += ms / iterations;
+            worst_ms = juce::jmax(worst_ms, ms);
+            peak_extra_bytes = juce::jmax(peak_extra_bytes, extra_bytes);
+        }
+
+        juce::var to_var() const {
+            auto* object = new juce::DynamicObject();
+            object->setProperty("mean_ms", mean_ms);
+            object->setProperty("worst_ms", worst_ms);
+            object->setProperty("peak_extra_bytes", peak_extra_bytes);
+            return juce::var(object);
+        }
+    };
+
+    /// peak_allocated_bytes from here on, relative to what's allocated now
+    juce::int64 begin_peak() {
+        const auto now = allocated_bytes.load(std::memory_order_relaxed);
+        peak_allocated_bytes.store(now, std::memory_order_relaxed);
+        return now;
+    }
+
+    struct state_result {
+        timing save, load;
+        std::size_t state_size = 0;
+    };
+
+    state_result measure_state(HostAudioProcessor& processor, const options& o) {
+        state_result result;
+        juce::MemoryBlock state;
+
+        for(int i = 0; i < o.iterations; ++i) {
+            state.reset();
+
+            const auto base = begin_peak();
+            const auto started = juce::Time::getHighResolutionTicks();
+            processor.getStateInformation(state);
+            result.save.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+        }
+
+        result.state_size = state.getSize();
+
+        for(int i = 0; i < o.iterations; ++i) {
+            const auto base = begin_peak();
+            const auto started = juce::Time::getHighResolutionTicks();
+
+            // setStateInformation only starts the load, it's done once the plugin has been published on the message thread
+            processor.setStateInformation(state.getData(), (int) state.getSize());
+            pump_until([&processor] { return is_settled(processor); });
+
+            result.load.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+        }
+
+        return result;
+    }
+
+    timing measure_swaps(HostAudioProcessor& processor, const juce::PluginDescription& description, const options& o) {
+        timing result;
+
+        for(int i = 0; i < o.iterations; ++i) {
+            juce::MemoryBlock state;
+            processor.get_inner(0)->getStateInformation(state);
+
+            bool swapped = false;
+            processor.pluginChanged = [&swapped] { swapped = true; };
+
+            const auto base = begin_peak();
+            const auto started = juce::Time::getHighResolutionTicks();
+
+            processor.setNewPlugin(description, EditorStyle::thisWindow, std::move(state), 0);
+            pump_until([&] { return swapped && is_settled(processor); });
+
+            result.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+            processor.pluginChanged = nullptr;
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    // the state format without a plugin behind it, so what the format costs isn't lost in what the plugin's own save and load cost
+    struct format_result {
+        int state_mb = 0;
+        std::size_t xml_size = 0, binary_size = 0;
+        timing xml_save, xml_load, binary_save, binary_load;
+
+        juce::var to_var() const {
+            auto* object = new juce::DynamicObject();
+            object->setProperty("state_mb", state_mb);
+            object->setProperty("xml_size", (juce::int64) xml_size);
+            object->setProperty("binary_size", (juce::int64) binary_size);
+            object->setProperty("xml_save", xml_save.to_var());
+            object->setProperty("xml_load", xml_load.to_var());
+            object->setProperty("binary_save", binary_save.to_var());
+            object->setProperty("binary_load", binary_load.to_var());
+            return juce::var(object);
+        }
+    };
+
+    /// what getStateInformation wrote before state_chunks: an xml document with the inner state base64 encoded into a text node
+    void save_xml(const juce::MemoryBlock& inner_state, juce::MemoryBlock& destination) {
+        juce::XmlElement xml("state");
+        xml.createNewChildElement("INNER_STATE")->addTextElement(inner_state.toBase64Encoding());
+
+        const auto text = xml.toString();
+        destination.replaceAll(text.toRawUTF8(), text.getNumBytesAsUTF8());
+    }
+
+    /// and what setStateInformation did with it, up to having the inner state to hand to the plugin
+    bool load_xml(const juce::MemoryBlock& data, juce::MemoryBlock& inner_state) {
+        const auto xml = juce::XmlDocument::parse(juce::String(juce::CharPointer_UTF8(static_cast<const char*>(data.getData())), data.getSize()));
+        return xml != nullptr && inner_state.fromBase64Encoding(xml->getChildElementAllSubText("INNER_STATE", {}));
+    }
+
+    void save_binary(const juce::MemoryBlock& inner_state, juce::MemoryBlock& destination) {
+        state_chunks::writer writer(destination);
+        writer.reserve(inner_state.getSize() + 64); // like getStateInformation does
+        writer.begin_chunk("SLOT");
+        writer.write_bytes(inner_state.getData(), inner_state.getSize());
+        writer.end_chunk();
+    }
+
+    /// the inner state is handed to the plugin straight out of the data, so there's nothing to copy
+    bool load_binary(const juce::MemoryBlock& data, const void*& inner_state, std::size_t& inner_size) {
+        state_chunks::reader reader(data.getData(), data.getSize());
+
+        while(reader.next_chunk()) {
+            if(reader.chunk_is("SLOT")) {
+                return reader.read_bytes(inner_state, inner_size);
+            }
+        }
+
+        return false;
+    }
+
+    format_result measure_formats(int state_mb, const options& o) {
+        format_result result;
+        result.state_mb = state_mb;
+
+        // random bytes, like a sample based instrument's state, which doesn't compress either
+        juce::MemoryBlock inner_state((std::size_t) state_mb * 1024 * 1024);
+        juce::Random(1234).fillBitsRandomly(inner_state.getData(), inner_state.getSize());
+
+        juce::MemoryBlock xml, binary, loaded;
+
+        for(int i = 0; i < o.iterations; ++i) {
+            xml.reset();
+            binary.reset();
+
+            auto base = begin_peak();
+            auto started = juce::Time::getHighResolutionTicks();
+            save_xml(inner_state, xml);
+            result.xml_save.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+
+            base = begin_peak();
+            started = juce::Time::getHighResolutionTicks();
+            save_binary(inner_state, binary);
+            result.binary_save.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+        }
+
+        result.xml_size = xml.getSize();
+        result.binary_size = binary.getSize();
+
+        for(int i = 0; i < o.iterations; ++i) {
+            loaded.reset();
+
+            auto base = begin_peak();
+            auto started = juce::Time::getHighResolutionTicks();
+            const bool xml_loaded = load_xml(xml, loaded);
+            result.xml_load.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+
+            const void* binary_state = nullptr;
+            std::size_t binary_state_size = 0;
+
+            base = begin_peak();
+            started = juce::Time::getHighResolutionTicks();
+            const bool binary_loaded = load_binary(binary, binary_state, binary_state_size);
+            result.binary_load.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+
+            // both have to give back what went in, or the numbers don't mean anything
+            jassert(xml_loaded && loaded == inner_state);
+            jassert(binary_loaded && binary_state_size == inner_state.getSize() && std::memcmp(binary_state, inner_state.getData(), binary_state_size) == 0);
+            juce::ignoreUnused(xml_loaded, binary_loaded);
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    // parameter_forwarding_table::bind without a plugin load around it, for plugins with more and more parameters
+    struct bind_result {
+        int parameters = 0;
+        timing bind, rebind, unbind;
+
+        juce::var to_var() const {
+            auto* object = new juce::DynamicObject();
+            object->setProperty("parameters", parameters);
+            object->setProperty("bind", bind.to_var());
+            object->setProperty("rebind", rebind.to_var());
+            object->setProperty("unbind", unbind.to_var());
+            return juce::var(object);
+        }
+    };
+
+    bind_result measure_binds(int number_of_parameters, const options& o) {
+        bind_result result;
+        result.parameters = number_of_parameters;
+
+        // a synthetic plugin's parameters. Every eighth one is discrete, so its step texts get captured too, like a real plugin's switches
+        juce::OwnedArray<juce::AudioProcessorParameter> owned;
+        juce::Array<juce::AudioProcessorParameter*> parameters;
+
+        for(int i = 0; i < number_of_parameters; ++i) {
+            const juce::String id = "parameter_" + juce::String(i);
+
+            if(i % 8 == 7) owned.add(new juce::AudioParameterInt(id, "Switch " + juce::String(i), 0, 15, 0));
+            else           owned.add(new juce::AudioParameterFloat(id, "Parameter " + juce::String(i), 0.f, 1.f, 0.5f));
+
+            parameters.add(owned.getLast());
+        }
+
+        parameter_change_queue changes((std::size_t) number_of_parameters);
+        parameter_forwarding_table table((std::size_t) number_of_parameters, changes);
+
+        const auto time = [&] (timing& t, auto&& work) {
+            const auto base = begin_peak();
+            const auto started = juce::Time::getHighResolutionTicks();
+            work();
+            t.add(juce::Time::getHighResolutionTicks() - started, peak_allocated_bytes.load() - base, o.iterations);
+
+            changes.drain([] (std::size_t, float) {}); // what the wrapper's timer would do, untimed
+        };
+
+        for(int i = 0; i < o.iterations; ++i) {
+            time(result.bind,   [&] { table.bind(0, parameters); });   // a swap to this plugin: every entry is new
+            time(result.rebind, [&] { table.bind(0, parameters); });   // another slot changed: every entry already points at the right parameter
+            time(result.unbind, [&] { table.unbind_from(0); });        // a swap away from it
+        }
+
+        return result;
+    }
+
+    //==============================================================================
+    void print_usage() {
+        std::cerr << "usage: HostPluginDemo-cmake-bench [plugin file or identifier] [--format <name>] [--rate <hz>] [--blocks <n,n,...>] [--seconds <s>]" << std::endl
+                  << "                                  [--midi <events/s>] [--automate <n,n,...>] [--sub-block <n>] [--oversampling <n>] [--double]" << std::endl
+                  << "                                  [--iterations <n>] [--warm-pool <mb>] [--state-mb <n,n,...>] [--parameters <n,n,...>] [--json]" << std::endl;
+    }
+
+    juce::String format_row(const juce::StringArray& cells) {
+        juce::String row;
+
+        for(const auto& cell : cells) {
+            row << cell.paddedLeft(' ', 11);
+        }
+
+        return row;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    options o;
+
+    if(! parse(juce::ArgumentList(argc, argv), o)) {
+        print_usage();
+        return exit_failed;
+    }
+
+    juce::ScopedJuceInitialiser_GUI juce_initialiser; // the wrapper (and plenty of plugins) need a message thread, this one is it
+
+    auto processor = std::make_unique<HostAudioProcessor>();
+    processor->set_warm_pool_budget_mb(o.warm_pool_mb);
+    processor->setRateAndBufferSizeDetails(o.sample_rate, o.block_sizes.getFirst());
+    processor->prepareToPlay(o.sample_rate, o.block_sizes.getFirst()); // so the plugin gets prepared by the loader, like it would in a running session
+
+    std::unique_ptr<juce::PluginDescription> description;
+    timing first_load;
+
+    if(o.plugin.isNotEmpty()) {
+        description = find_plugin(processor->get_format_manager(), o);
+
+        if(description == nullptr) {
+            std::cerr << "no plugin found in " << o.plugin << std::endl;
+            return exit_failed;
+        }
+
+        processor->set_slot_sub_block_size(0, o.sub_block_size);
+        processor->set_slot_oversampling(0, o.oversampling_factor);
+
+        const auto started = juce::Time::getHighResolutionTicks();
+        processor->setNewPlugin(*description, EditorStyle::thisWindow, {}, 0);
+
+        if(! pump_until([&processor] { return processor->isPluginLoaded(0) && is_settled(*processor); })) {
+            std::cerr << "couldn't load " << description->name << std::endl;
+            return exit_failed;
+        }
+
+        first_load.add(juce::Time::getHighResolutionTicks() - started, 0, 1);
+    }
+
+    processor->releaseResources();
+
+    std::vector<render_result> renders;
+
+    for(const int block_size : o.block_sizes) {
+        for(const int automated : o.automated_parameters) {
+            renders.push_back(o.double_precision ? render<double>(*processor, o, block_size, automated) : render<float>(*processor, o, block_size, automated));
+        }
+    }
+
+    processor->setRateAndBufferSizeDetails(o.sample_rate, o.block_sizes.getFirst());
+    processor->prepareToPlay(o.sample_rate, o.block_sizes.getFirst());
+
+    const auto state = measure_state(*processor, o);
+    const auto swaps = description != nullptr ? measure_swaps(*processor, *description, o) : timing {};
+
+    processor->releaseResources();
+
+    std::vector<format_result> formats;
+
+    for(const int state_mb : o.state_sizes_mb) {
+        formats.push_back(measure_formats(state_mb, o));
+    }
+
+    std::vector<bind_result> binds;
+
+    for(const int number_of_parameters : o.parameter_counts) {
+        binds.push_back(measure_binds(number_of_parameters, o));
+    }
+
+    const juce::String plugin_name = description != nullptr ? description->name : juce::String("(none)");
+    const int number_of_parameters = processor->getParameters().size();
+
+    if(o.json) {
+        auto* root = new juce::DynamicObject();
+        root->setProperty("plugin", plugin_name);
+        root->setProperty("sample_rate", o.sample_rate);
+        root->setProperty("double_precision", o.double_precision);
+        root->setProperty("sub_block_size", o.sub_block_size);
+        root->setProperty("oversampling", o.oversampling_factor);
+        root->setProperty("parameters", number_of_parameters);
+        root->setProperty("first_load", first_load.to_var());
+        root->setProperty("state_size", (juce::int64) state.state_size);
+        root->setProperty("state_save", state.save.to_var());
+        root->setProperty("state_load", state.load.to_var());
+        root->setProperty("swap", swaps.to_var());
+        root->setProperty("warm_pool_hits", (juce::int64) processor->get_warm_pool_stats().hits);
+
+        juce::Array<juce::var> render_vars;
+
+        for(const auto& r : renders) {
+            render_vars.add(r.to_var());
+        }
+
+        root->setProperty("renders", render_vars);
+
+        juce::Array<juce::var> format_vars, bind_vars;
+
+        for(const auto& f : formats) {
+            format_vars.add(f.to_var());
+        }
+
+        for(const auto& b : binds) {
+            bind_vars.add(b.to_var());
+        }
+
+        root->setProperty("state_formats", format_vars);
+        root->setProperty("parameter_binds", bind_vars);
+
+        std::cout << juce::JSON::toString(juce::var(root)) << std::endl;
+        return exit_ok;
+    }
+
+    std::cout << "plugin " << plugin_name << ", " << number_of_parameters << " parameters, " << o.sample_rate << " Hz"
+              << (o.double_precision ? ", double" : "") << (o.sub_block_size > 0 ? ", sub-blocks of " + juce::String(o.sub_block_size) : juce::String())
+              << (o.oversampling_factor > 1 ? ", " + juce::String(o.oversampling_factor) + "x oversampling" : juce::String()) << std::endl << std::endl;
+
+    std::cout << format_row({ "block", "automated", "realtime", "ns/sample", "p50 us", "p90 us", "p99 us", "p99.9 us", "worst us", "overruns", "allocs/blk" }) << std::endl;
+
+    for(const auto& r : renders) {
+        std::cout << format_row({ juce::String(r.block_size), juce::String(r.automated), juce::String(r.realtime_factor, 1) + "x", juce::String(r.ns_per_sample, 1),
+                                  juce::String(r.p50_us, 1), juce::String(r.p90_us, 1), juce::String(r.p99_us, 1), juce::String(r.p999_us, 1), juce::String(r.worst_us, 1),
+                                  juce::String(r.overruns), juce::String(r.allocations_per_block, 2) }) << std::endl;
+    }
+
+    const auto print_timing = [] (const char* name, const timing& t) {
+        std::cout << juce::String(name).paddedRight(' ', 12) << juce::String(t.mean_ms, 2) << " ms mean, " << juce::String(t.worst_ms, 2) << " ms worst, "
+                  << juce::String((double) t.peak_extra_bytes / (1024.0 * 1024.0), 2) << " MB peak heap" << std::endl;
+    };
+
+    std::cout << std::endl << "state: " << state.state_size << " bytes" << std::endl;
+    print_timing("first load", first_load);
+    print_timing("state save", state.save);
+    print_timing("state load", state.load);
+    print_timing("swap", swaps);
+    std::cout << "warm pool: " << processor->get_warm_pool_stats().hits << " hits, " << processor->get_warm_pool_stats().misses << " misses" << std::endl;
+
+    const auto megabytes = [] (juce::int64 bytes) { return juce::String((double) bytes / (1024.0 * 1024.0), 2); };
+
+    if(! formats.empty()) {
+        std::cout << std::endl << "state format, without a plugin (ms mean / MB peak heap)" << std::endl;
+        std::cout << format_row({ "state MB", "xml MB", "xml save", "xml load", "binary MB", "binary save", "binary load" }) << std::endl;
+
+        for(const auto& f : formats) {
+            const auto cell = [&megabytes] (const timing& t) { return juce::String(t.mean_ms, 2) + "/" + megabytes(t.peak_extra_bytes); };
+
+            std::cout << format_row({ juce::String(f.state_mb), megabytes((juce::int64) f.xml_size), cell(f.xml_save), cell(f.xml_load),
+                                      megabytes((juce::int64) f.binary_size), cell(f.binary_save), cell(f.binary_load) }) << std::endl;
+        }
+    }
+
+    if(! binds.empty()) {
+        std::cout << std::endl << "parameter bind, without a plugin (us mean)" << std::endl;
+        std::cout << format_row({ "parameters", "bind", "rebind", "unbind", "bind us/par" }) << std::endl;
+
+        for(const auto& b : binds) {
+            std::cout << format_row({ juce::String(b.parameters), juce::String(b.bind.mean_ms * 1.0e3, 1), juce::String(b.rebind.mean_ms * 1.0e3, 1),
+                                      juce::String(b.unbind.mean_ms * 1.0e3, 1), juce::String(b.bind.mean_ms * 1.0e3 / b.parameters, 3) }) << std::endl;
+        }
+    }
+
+    return exit_ok;
+}
@@ -0,0 +1,689 @@
+#include "channel_adapter.h"
+
+#include "simd_kernels.h"
+
+#include <array>
+#include <optional>
+#include <type_traits>
+
+namespace {
+    enum class channel_side { left, right, centre, lfe, other };
+
+    channel_side get_side(juce::AudioChannelSet::ChannelType type) {
+        using set = juce::AudioChannelSet;
+
+        switch(type) {
+            case set::left: case set::leftCentre: case set::leftSurround: case set::leftSurroundSide: case set::leftSurroundRear: case set::wideLeft:
+            case set::topFrontLeft: case set::topRearLeft:
+                return channel_side::left;
+
+            case set::right: case set::rightCentre: case set::rightSurround: case set::rightSurroundSide: case set::rightSurroundRear: case set::wideRight:
+            case set::topFrontRight: case set::topRearRight:
+                return channel_side::right;
+
+            case set::centre: case set::centreSurround: case set::topMiddle: case set::topFrontCentre: case set::topRearCentre:
+                return channel_side::centre;
+
+            case set::LFE: case set::LFE2:
+                return channel_side::lfe;
+
+            default:
+                return channel_side::other; // ambisonics and whatever else doesn't have an obvious place in a smaller layout
+        }
+    }
+
+    int count_channels(const juce::Array<juce::AudioChannelSet>& buses) {
+        int number_of_channels = 0;
+
+        for(const auto& bus : buses) {
+            number_of_channels += bus.size();
+        }
+
+        return number_of_channels;
+    }
+
+    /// the layouts we try for one bus, closest to target first
+    juce::Array<juce::AudioChannelSet> get_candidates(const juce::AudioChannelSet& target, const juce::AudioChannelSet& plugin_default, bool allow_disabled) {
+        juce::Array<juce::AudioChannelSet> candidates;
+
+        const auto add = [&candidates] (const juce::AudioChannelSet& set) {
+            if(! set.isDisabled()) {
+                candidates.addIfNotAlreadyThere(set);
+            }
+        };
+
+        if(target.isDisabled()) {
+            candidates.add(target); // the wrapper has no input, so ideally the plugin doesn't either
+        }
+
+        const int size = target.size();
+
+        add(target);
+        add(juce::AudioChannelSet::canonicalChannelSet(size));
+        add(juce::AudioChannelSet::discreteChannels(size));
+        add(juce::AudioChannelSet::stereo());
+        add(juce::AudioChannelSet::mono());
+        add(plugin_default);
+        add(juce::AudioChannelSet::quadraphonic());
+        add(juce::AudioChannelSet::create5point0());
+        add(juce::AudioChannelSet::create5point1());
+        add(juce::AudioChannelSet::create7point0());
+        add(juce::AudioChannelSet::create7point1());
+
+        if(allow_disabled && ! target.isDisabled()) {
+            candidates.add(juce::AudioChannelSet::disabled()); // last resort, the plugin just doesn't get any input
+        }
+
+        return candidates;
+    }
+}
+
+bool channel_adapter::negotiate(juce::AudioPluginInstance& instance, const juce::AudioProcessor::BusesLayout& outer_layout, juce::String& error) {
+    const auto plugin_default = instance.getBusesLayout();
+
+    const bool has_input  = ! plugin_default.inputBuses.isEmpty();
+    const bool has_output = ! plugin_default.outputBuses.isEmpty();
+
+    // the plugin's aux buses get whatever the wrapper's have (sidechain in, aux outs), or are off where the host didn't enable the wrapper's
+    auto mirrored = plugin_default;
+
+    for(int bus_i = 1; bus_i < mirrored.inputBuses.size(); ++bus_i) {
+        mirrored.inputBuses.getReference(bus_i) = bus_i < outer_layout.inputBuses.size() ? outer_layout.inputBuses[bus_i] : juce::AudioChannelSet::disabled();
+    }
+
+    for(int bus_i = 1; bus_i < mirrored.outputBuses.size(); ++bus_i) {
+        mirrored.outputBuses.getReference(bus_i) = bus_i < outer_layout.outputBuses.size() ? outer_layout.outputBuses[bus_i] : juce::AudioChannelSet::disabled();
+    }
+
+    // if the plugin doesn't take those, its aux buses are off if it lets us
+    auto without_aux = plugin_default;
+
+    for(int bus_i = 1; bus_i < without_aux.inputBuses.size(); ++bus_i) {
+        without_aux.inputBuses.getReference(bus_i) = juce::AudioChannelSet::disabled();
+    }
+
+    for(int bus_i = 1; bus_i < without_aux.outputBuses.size(); ++bus_i) {
+        without_aux.outputBuses.getReference(bus_i) = juce::AudioChannelSet::disabled();
+    }
+
+    const auto outer_input  = outer_layout.getMainInputChannelSet();
+    const auto outer_output = outer_layout.getMainOutputChannelSet();
+
+    // a plugin without buses on one side gets a single placeholder there, so the loops below still run once
+    const auto inputs  = has_input  ? get_candidates(outer_input,  plugin_default.getMainInputChannelSet(),  true)  : juce::Array<juce::AudioChannelSet> (juce::AudioChannelSet());
+    const auto outputs = has_output ? get_candidates(outer_output, plugin_default.getMainOutputChannelSet(), false) : juce::Array<juce::AudioChannelSet> (juce::AudioChannelSet());
+
+    const std::array<const juce::AudioProcessor::BusesLayout*, 3> bases { &mirrored, &without_aux, &plugin_default };
+
+    const auto find_layout = [&] (juce::AudioProcessor::BusesLayout& found) {
+        for(const auto& output : outputs) {
+            for(const auto& input : inputs) {
+                for(const auto* base : bases) {
+                    auto layout = *base;
+
+                    if(has_input)  layout.inputBuses.getReference(0)  = input;
+                    if(has_output) layout.outputBuses.getReference(0) = output;
+
+                    if(instance.checkBusesLayoutSupported(layout)) {
+                        found = layout;
+                        return true;
+                    }
+                }
+            }
+        }
+
+        return false;
+    };
+
+    juce::AudioProcessor::BusesLayout inner_layout;
+
+    if(! find_layout(inner_layout) || ! instance.setBusesLayout(inner_layout)) {
+        error = "the plugin you're trying to load doesn't support any bus layout the host plugin can adapt to (the host plugin is "
+              + outer_output.getDescription() + ")!";
+        return false;
+    }
+
+    const auto inner_input  = inner_layout.getMainInputChannelSet();
+    const auto inner_output = inner_layout.getMainOutputChannelSet();
+
+    outer_layout_ = outer_layout;
+    outer_channels_ = juce::jmax(count_channels(outer_layout.inputBuses), count_channels(outer_layout.outputBuses));
+    outer_main_channels_ = juce::jmax(outer_input.size(), outer_output.size());
+    sidechain_channels_ = count_channels(outer_layout.inputBuses) - outer_input.size();
+    inner_channels_ = juce::jmax(count_channels(inner_layout.inputBuses), count_channels(inner_layout.outputBuses));
+    inner_outputs_ = count_channels(inner_layout.outputBuses);
+
+    identity_ = inner_input == outer_input && inner_output == outer_output
+             && count_channels(inner_layout.inputBuses) == inner_input.size() && count_channels(inner_layout.outputBuses) == inner_output.size();
+
+    // the main buses come first in both processBlock buffers, so the routes' indices are buffer channels too
+    input_routes_  = identity_ ? std::vector<route>{} : make_routes_(outer_input, inner_input);
+    output_routes_ = identity_ ? std::vector<route>{} : make_routes_(inner_output, outer_output);
+
+    // the aux buses come after them, in bus order. The sidechain buffer only has the wrapper's aux inputs, so those start at 0
+    aux_input_routes_.clear();
+    aux_output_routes_.clear();
+    aux_output_targets_.clear();
+
+    for(int bus_i = 1, inner_offset = inner_input.size(), outer_offset = 0; bus_i < inner_layout.inputBuses.size(); ++bus_i) {
+        const auto& set = inner_layout.inputBuses[bus_i];
+
+        if(bus_i < outer_layout.inputBuses.size()) {
+            append_routes_(aux_input_routes_, outer_layout.inputBuses[bus_i], outer_offset, set, inner_offset);
+            outer_offset += outer_layout.inputBuses[bus_i].size();
+        }
+
+        inner_offset += set.size();
+    }
+
+    for(int bus_i = 1, inner_offset = inner_output.size(), outer_offset = outer_output.size(); bus_i < inner_layout.outputBuses.size(); ++bus_i) {
+        const auto& set = inner_layout.outputBuses[bus_i];
+
+        if(bus_i < outer_layout.outputBuses.size()) {
+            const auto& outer_set = outer_layout.outputBuses[bus_i];
+            append_routes_(aux_output_routes_, set, inner_offset, outer_set, outer_offset);
+
+            for(int channel = 0; ! set.isDisabled() && channel < outer_set.size(); ++channel) {
+                aux_output_targets_.push_back(outer_offset + channel);
+            }
+
+            outer_offset += outer_set.size();
+        }
+
+        inner_offset += set.size();
+    }
+
+    main_inputs_read_ = inner_input.isDisabled() ? 0 : outer_input.size();
+    reads_sidechain_ = ! aux_input_routes_.empty();
+
+    direct_ = ! identity_ && make_direct_(inner_layout);
+
+    if(! direct_) {
+        direct_channels_.clear();
+        direct_cleared_.clear();
+    }
+
+    return true;
+}
+
+bool channel_adapter::make_direct_(const juce::AudioProcessor::BusesLayout& inner_layout) {
+    const auto inner_input = inner_layout.getMainInputChannelSet();
+
+    // the main buses have to be the wrapper's, except that a plugin without an input (an instrument) can just have silence there
+    if(inner_layout.getMainOutputChannelSet() != outer_layout_.getMainOutputChannelSet()
+       || (! inner_input.isDisabled() && inner_input != outer_layout_.getMainInputChannelSet())) {
+        return false;
+    }
+
+    // where every channel of the plugin's buffer comes from, and where it goes. Every bus the plugin has enabled has to be exactly the wrapper's
+    std::vector<std::optional<direct_channel>> from((std::size_t) inner_channels_), to((std::size_t) inner_channels_);
+
+    for(int bus_i = 0, offset = 0, sidechain_offset = 0; bus_i < inner_layout.inputBuses.size(); ++bus_i) {
+        const auto& set = inner_layout.inputBuses[bus_i];
+        const auto outer_set = bus_i < outer_layout_.inputBuses.size() ? outer_layout_.inputBuses[bus_i] : juce::AudioChannelSet::disabled();
+
+        if(! set.isDisabled() && set != outer_set) {
+            return false;
+        }
+
+        for(int channel = 0; channel < set.size(); ++channel) {
+            from[(std::size_t) (offset + channel)] = direct_channel { bus_i > 0, bus_i > 0 ? sidechain_offset + channel : channel };
+        }
+
+        offset += set.size();
+        sidechain_offset += bus_i > 0 ? outer_set.size() : 0;
+    }
+
+    for(int bus_i = 0, offset = 0, outer_offset = 0; bus_i < inner_layout.outputBuses.size(); ++bus_i) {
+        const auto& set = inner_layout.outputBuses[bus_i];
+        const auto outer_set = bus_i < outer_layout_.outputBuses.size() ? outer_layout_.outputBuses[bus_i] : juce::AudioChannelSet::disabled();
+
+        if(! set.isDisabled() && set != outer_set) {
+            return false;
+        }
+
+        for(int channel = 0; channel < set.size(); ++channel) {
+            to[(std::size_t) (offset + channel)] = direct_channel { false, outer_offset + channel };
+        }
+
+        offset += set.size();
+        outer_offset += outer_set.size();
+    }
+
+    direct_channels_.clear();
+    direct_cleared_.clear();
+
+    for(std::size_t channel = 0; channel < (std::size_t) inner_channels_; ++channel) {
+        const auto& in = from[channel];
+        const auto& out = to[channel];
+
+        if(in.has_value() && out.has_value()) {
+            if(in->from_sidechain || in->index != out->index) {
+                return false; // e.g. a plugin with a sidechain and aux outputs, whose buffer has the two on the same channels
+            }
+
+            direct_channels_.push_back(*out); // a main channel, processed in place
+        }
+        else if(out.has_value()) {
+            direct_channels_.push_back(*out);
+            direct_cleared_.push_back(out->index); // only written, so it starts out silent, same as in a buffer of its own
+        }
+        else if(in.has_value()) {
+            direct_channels_.push_back(*in);
+        }
+        else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void channel_adapter::prepare(const juce::AudioPluginInstance& instance, int block_size, bool double_precision) {
+    if(outer_channels_ == 0 && inner_channels_ == 0) {
+        // never negotiated, so the plugin runs on whatever it's been given
+        outer_channels_ = outer_main_channels_ = inner_channels_ = inner_outputs_ = juce::jmax(instance.getTotalNumInputChannels(), instance.getTotalNumOutputChannels());
+        sidechain_channels_ = 0;
+        main_inputs_read_ = instance.getTotalNumInputChannels();
+        reads_sidechain_ = false;
+    }
+
+    const bool convert = double_precision && ! instance.isUsingDoublePrecision();
+    const bool inner_is_double = double_precision && ! convert;
+
+    // the fifo runs at the wrapper's rate, so the oversampler only ever sees sub-blocks
+    sub_blocks_       .prepare(inner_is_double ? 0 : sub_block_size_, inner_channels_);
+    sub_blocks_double_.prepare(inner_is_double ? sub_block_size_ : 0, inner_channels_);
+
+    const int oversampler_block_size = sub_block_size_ > 0 ? sub_block_size_ : block_size;
+
+    oversampler_.prepare(oversampling_factor_, oversampling_factor_ > 1 ? inner_channels_ : 0, oversampling_factor_ > 1 ? oversampler_block_size : 0);
+    oversampled_midi_.ensureSize(oversampling_factor_ > 1 ? midi_scratch_bytes_ : 0);
+
+    const bool adapted = ! identity_ && ! direct_;
+
+    conversion_scratch_  .setSize(convert ? outer_channels_ + sidechain_channels_ : 0,  convert ? block_size : 0,                      false, true, false);
+    inner_scratch_       .setSize(adapted && ! inner_is_double ? inner_channels_ : 0, adapted && ! inner_is_double ? block_size : 0, false, true, false);
+    inner_scratch_double_.setSize(adapted && inner_is_double ? inner_channels_ : 0,   adapted && inner_is_double ? block_size : 0,   false, true, false);
+
+    direct_pointers_      .assign(direct_ && ! inner_is_double ? (std::size_t) inner_channels_ : 0, nullptr);
+    direct_pointers_double_.assign(direct_ && inner_is_double ? (std::size_t) inner_channels_ : 0, nullptr);
+
+    prepared_block_size_ = block_size;
+    prepared_double_precision_ = double_precision;
+}
+
+void channel_adapter::reset() noexcept {
+    sub_blocks_.reset();
+    sub_blocks_double_.reset();
+    oversampler_.reset();
+}
+
+void channel_adapter::process(juce::AudioPluginInstance& instance, juce::AudioBuffer<float>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<float>& sidechain) {
+    process_adapted_(instance, audio_buffer, midi_buffer, sidechain);
+}
+
+void channel_adapter::process(juce::AudioPluginInstance& instance, juce::AudioBuffer<double>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<double>& sidechain) {
+    if(instance.isUsingDoublePrecision()) {
+        process_adapted_(instance, audio_buffer, midi_buffer, sidechain); // no conversion at all
+        return;
+    }
+
+    const int number_of_channels = audio_buffer.getNumChannels();
+    const int number_of_sidechain_channels = sidechain.getNumChannels();
+    const int number_of_samples = audio_buffer.getNumSamples();
+
+    if(number_of_channels + number_of_sidechain_channels > conversion_scratch_.getNumChannels() || number_of_samples > conversion_scratch_.getNumSamples()) {
+        // the host gave us a bigger buffer than it promised in prepareToPlay. The plugin gets skipped (the block stays dry) rather than allocating
+        jassertfalse;
+        return;
+    }
+
+    juce::AudioBuffer<float> converted(conversion_scratch_.getArrayOfWritePointers(), number_of_channels, number_of_samples); // no allocation
+    juce::AudioBuffer<float> converted_sidechain(conversion_scratch_.getArrayOfWritePointers() + number_of_channels, number_of_sidechain_channels, number_of_samples);
+
+    for(int channel = 0; channel < number_of_channels; ++channel) {
+        simd_kernels::convert(audio_buffer.getReadPointer(channel), converted.getWritePointer(channel), number_of_samples);
+    }
+
+    for(int channel = 0; channel < number_of_sidechain_channels; ++channel) {
+        simd_kernels::convert(sidechain.getReadPointer(channel), converted_sidechain.getWritePointer(channel), number_of_samples);
+    }
+
+    process_adapted_(instance, converted, midi_buffer, converted_sidechain);
+
+    for(int channel = 0; channel < number_of_channels; ++channel) {
+        simd_kernels::convert(converted.getReadPointer(channel), audio_buffer.getWritePointer(channel), number_of_samples);
+    }
+}
+
+bool channel_adapter::is_input_silent(const juce::AudioBuffer<float>& audio_buffer, const juce::AudioBuffer<float>& sidechain, float threshold) const noexcept {
+    return is_input_silent_(audio_buffer, sidechain, threshold);
+}
+
+bool channel_adapter::is_input_silent(const juce::AudioBuffer<double>& audio_buffer, const juce::AudioBuffer<double>& sidechain, float threshold) const noexcept {
+    return is_input_silent_(audio_buffer, sidechain, threshold);
+}
+
+bool channel_adapter::is_output_silent(const juce::AudioBuffer<float>& audio_buffer, float threshold) const noexcept {
+    return is_output_silent_(audio_buffer, threshold);
+}
+
+bool channel_adapter::is_output_silent(const juce::AudioBuffer<double>& audio_buffer, float threshold) const noexcept {
+    return is_output_silent_(audio_buffer, threshold);
+}
+
+void channel_adapter::silence(juce::AudioBuffer<float>& audio_buffer) const noexcept {
+    silence_(audio_buffer);
+}
+
+void channel_adapter::silence(juce::AudioBuffer<double>& audio_buffer) const noexcept {
+    silence_(audio_buffer);
+}
+
+template<typename sample_t>
+bool channel_adapter::is_input_silent_(const juce::AudioBuffer<sample_t>& outer, const juce::AudioBuffer<sample_t>& sidechain, float threshold) const noexcept {
+    const int number_of_samples = outer.getNumSamples();
+
+    for(int channel = 0; channel < juce::jmin(main_inputs_read_, outer.getNumChannels()); ++channel) {
+        if(simd_kernels::peak(outer.getReadPointer(channel), number_of_samples) > (sample_t) threshold) {
+            return false;
+        }
+    }
+
+    for(int channel = 0; reads_sidechain_ && channel < sidechain.getNumChannels(); ++channel) {
+        if(simd_kernels::peak(sidechain.getReadPointer(channel), number_of_samples) > (sample_t) threshold) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename sample_t>
+bool channel_adapter::is_output_silent_(const juce::AudioBuffer<sample_t>& outer, float threshold) const noexcept {
+    if(inner_outputs_ == 0) {
+        return true;
+    }
+
+    const int number_of_samples = outer.getNumSamples();
+
+    for(int channel = 0; channel < juce::jmin(outer_main_channels_, outer.getNumChannels()); ++channel) {
+        if(simd_kernels::peak(outer.getReadPointer(channel), number_of_samples) > (sample_t) threshold) {
+            return false;
+        }
+    }
+
+    for(const int channel : aux_output_targets_) {
+        if(channel < outer.getNumChannels() && simd_kernels::peak(outer.getReadPointer(channel), number_of_samples) > (sample_t) threshold) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<typename sample_t>
+void channel_adapter::silence_(juce::AudioBuffer<sample_t>& outer) const noexcept {
+    if(inner_outputs_ == 0) {
+        return; // the audio passes through untouched, same as when the plugin runs
+    }
+
+    const int number_of_samples = outer.getNumSamples();
+
+    for(int channel = 0; channel < juce::jmin(outer_main_channels_, outer.getNumChannels()); ++channel) {
+        outer.clear(channel, 0, number_of_samples);
+    }
+
+    for(const int channel : aux_output_targets_) {
+        if(channel < outer.getNumChannels()) {
+            outer.clear(channel, 0, number_of_samples);
+        }
+    }
+}
+
+template<typename sample_t>
+void channel_adapter::process_adapted_(juce::AudioPluginInstance& instance, juce::AudioBuffer<sample_t>& outer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain) {
+    const int number_of_samples = outer.getNumSamples();
+
+    if(identity_) {
+        if(outer.getNumChannels() <= outer_main_channels_) {
+            process_inner_(instance, outer, midi_buffer);
+            return;
+        }
+
+        // the wrapper's aux buses are enabled, but this plugin doesn't have any, so it only gets the main channels
+        juce::AudioBuffer<sample_t> main(outer.getArrayOfWritePointers(), outer_main_channels_, number_of_samples); // no allocation
+        process_inner_(instance, main, midi_buffer);
+        return;
+    }
+
+    if(direct_) {
+        auto& pointers = [this] () -> auto& {
+            if constexpr (std::is_same_v<sample_t, float>) return direct_pointers_;
+            else                                           return direct_pointers_double_;
+        }();
+
+        if(outer.getNumChannels() < outer_channels_ || sidechain.getNumChannels() < sidechain_channels_ || pointers.size() != direct_channels_.size()) {
+            jassertfalse; // the wrapper's layout changed without us being prepared again
+            return;
+        }
+
+        for(const int channel : direct_cleared_) {
+            outer.clear(channel, 0, number_of_samples);
+        }
+
+        for(std::size_t channel = 0; channel < pointers.size(); ++channel) {
+            const auto& source = direct_channels_[channel];
+            pointers[channel] = source.from_sidechain ? sidechain.getWritePointer(source.index) : outer.getWritePointer(source.index);
+        }
+
+        juce::AudioBuffer<sample_t> inner(pointers.data(), inner_channels_, number_of_samples); // no allocation, and no copy
+        process_inner_(instance, inner, midi_buffer);
+        return;
+    }
+
+    auto& scratch = [this] () -> auto& {
+        if constexpr (std::is_same_v<sample_t, float>) return inner_scratch_;
+        else                                           return inner_scratch_double_;
+    }();
+
+    if(number_of_samples > scratch.getNumSamples()) {
+        jassertfalse; // same as above, bigger than promised
+        return;
+    }
+
+    juce::AudioBuffer<sample_t> inner(scratch.getArrayOfWritePointers(), inner_channels_, number_of_samples);
+
+    inner.clear(); // channels nothing gets routed to (aux buses the wrapper doesn't have, surrounds from a stereo source) are silent
+    mix_(input_routes_, outer, inner, number_of_samples);
+    mix_(aux_input_routes_, sidechain, inner, number_of_samples);
+
+    process_inner_(instance, inner, midi_buffer);
+
+    if(inner_outputs_ == 0) {
+        return; // no audio outputs at all (a midi effect), the wrapper's audio passes through untouched
+    }
+
+    for(int channel = 0; channel < juce::jmin(outer_main_channels_, outer.getNumChannels()); ++channel) {
+        outer.clear(channel, 0, number_of_samples);
+    }
+
+    for(const int channel : aux_output_targets_) {
+        if(channel < outer.getNumChannels()) {
+            outer.clear(channel, 0, number_of_samples);
+        }
+    }
+
+    mix_(output_routes_, inner, outer, number_of_samples);
+    mix_(aux_output_routes_, inner, outer, number_of_samples);
+}
+
+template<typename sample_t>
+void channel_adapter::process_inner_(juce::AudioPluginInstance& instance, juce::AudioBuffer<sample_t>& buffer, juce::MidiBuffer& midi_buffer) {
+    if(sub_block_size_ == 0) {
+        process_plugin_(instance, buffer, midi_buffer);
+        return;
+    }
+
+    auto& sub_blocks = [this] () -> auto& {
+        if constexpr (std::is_same_v<sample_t, float>) return sub_blocks_;
+        else                                           return sub_blocks_double_;
+    }();
+
+    sub_blocks.process(buffer, midi_buffer, [this, &instance] (juce::AudioBuffer<sample_t>& block, juce::MidiBuffer& block_midi) {
+        process_plugin_(instance, block, block_midi);
+    });
+}
+
+template<typename sample_t>
+void channel_adapter::process_plugin_(juce::AudioPluginInstance& instance, juce::AudioBuffer<sample_t>& buffer, juce::MidiBuffer& midi_buffer) {
+    if constexpr (std::is_same_v<sample_t, float>) {
+        if(oversampling_factor_ > 1) {
+            process_oversampled_(instance, buffer, midi_buffer);
+            return;
+        }
+    }
+
+    instance.processBlock(buffer, midi_buffer);
+}
+
+void channel_adapter::process_oversampled_(juce::AudioPluginInstance& instance, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi_buffer) {
+    const int factor = oversampling_factor_;
+
+    // the plugin gets its midi at its own rate, and whatever it sends back gets squashed back down to ours
+    // MidiBuffer::clear keeps its storage, so this doesn't allocate as long as the block's midi fits
+    oversampled_midi_.clear();
+
+    for(const auto metadata : midi_buffer) {
+        oversampled_midi_.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition * factor);
+    }
+
+    oversampler_.process(buffer, [&] (juce::AudioBuffer<float>& oversampled) {
+        instance.processBlock(oversampled, oversampled_midi_);
+    });
+
+    midi_buffer.clear();
+
+    for(const auto metadata : oversampled_midi_) {
+        midi_buffer.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition / factor);
+    }
+}
+
+template<typename sample_t>
+void channel_adapter::mix_(const std::vector<route>& routes, const juce::AudioBuffer<sample_t>& source, juce::AudioBuffer<sample_t>& destination, int number_of_samples) noexcept {
+    for(const auto& r : routes) {
+        if(r.from < source.getNumChannels() && r.to < destination.getNumChannels()) {
+            juce::FloatVectorOperations::addWithMultiply(destination.getWritePointer(r.to), source.getReadPointer(r.from), (sample_t) r.gain, number_of_samples);
+        }
+    }
+}
+
+void channel_adapter::append_routes_(std::vector<route>& routes, const juce::AudioChannelSet& from, int from_offset, const juce::AudioChannelSet& to, int to_offset) {
+    for(const auto& r : make_routes_(from, to)) {
+        routes.push_back({ r.from + from_offset, r.to + to_offset, r.gain });
+    }
+}
+
+std::vector<channel_adapter::route> channel_adapter::make_routes_(const juce::AudioChannelSet& from, const juce::AudioChannelSet& to) {
+    std::vector<route> routes;
+
+    const int from_size = from.size();
+    const int to_size = to.size();
+
+    if(from_size == 0 || to_size == 0) {
+        return routes;
+    }
+
+    // discrete channels have no meaning we could match up, so those just go by index
+    if(from.isDiscreteLayout() || to.isDiscreteLayout()) {
+        for(int channel = 0; channel < juce::jmin(from_size, to_size); ++channel) {
+            routes.push_back({ channel, channel, 1.f });
+        }
+
+        return routes;
+    }
+
+    // down to one channel: everything but the LFE, at equal gain so it can't clip any more than the loudest input
+    if(to_size == 1) {
+        std::vector<int> sources;
+
+        for(int channel = 0; channel < from_size; ++channel) {
+            if(get_side(from.getTypeOfChannel(channel)) != channel_side::lfe) {
+                sources.push_back(channel);
+            }
+        }
+
+        for(const int channel : sources) {
+            routes.push_back({ channel, 0, 1.f / (float) sources.size() });
+        }
+
+        return routes;
+    }
+
+    const int to_left   = to.getChannelIndexForType(juce::AudioChannelSet::left);
+    const int to_right  = to.getChannelIndexForType(juce::AudioChannelSet::right);
+    const int to_centre = to.getChannelIndexForType(juce::AudioChannelSet::centre);
+
+    // up from one channel: it goes to the centre if there is one, otherwise to the front left and right at full level (so mono -> stereo is a plain copy)
+    if(from_size == 1) {
+        if(to_centre >= 0) {
+            routes.push_back({ 0, to_centre, 1.f });
+        }
+        else {
+            if(to_left  >= 0) routes.push_back({ 0, to_left,  1.f });
+            if(to_right >= 0) routes.push_back({ 0, to_right, 1.f });
+        }
+
+        return routes;
+    }
+
+    // everything both sides have goes straight across. Channels only the destination has stay silent, we don't make up surrounds
+    std::vector<bool> routed((std::size_t) from_size, false);
+
+    for(int channel = 0; channel < to_size; ++channel) {
+        const int source = from.getChannelIndexForType(to.getTypeOfChannel(channel));
+
+        if(source >= 0) {
+            routes.push_back({ source, channel, 1.f });
+            routed[(std::size_t) source] = true;
+        }
+    }
+
+    // channels only the source has get folded into the closest front channel at -3 dB, which is more or less the ITU downmix. The LFE is dropped
+    constexpr float minus_3_db = 0.70710678f;
+
+    for(int channel = 0; channel < from_size; ++channel) {
+        if(routed[(std::size_t) channel]) {
+            continue;
+        }
+
+        switch(get_side(from.getTypeOfChannel(channel))) {
+            case channel_side::left:
+                if(to_left >= 0)        routes.push_back({ channel, to_left,   minus_3_db });
+                else if(to_centre >= 0) routes.push_back({ channel, to_centre, minus_3_db });
+                break;
+
+            case channel_side::right:
+                if(to_right >= 0)       routes.push_back({ channel, to_right,  minus_3_db });
+                else if(to_centre >= 0) routes.push_back({ channel, to_centre, minus_3_db });
+                break;
+
+            case channel_side::centre:
+                if(to_left >= 0 && to_right >= 0) {
+                    routes.push_back({ channel, to_left,  minus_3_db });
+                    routes.push_back({ channel, to_right, minus_3_db });
+                }
+                else if(to_centre >= 0) {
+                    routes.push_back({ channel, to_centre, 1.f });
+                }
+                break;
+
+            case channel_side::lfe:
+            case channel_side::other:
+                break;
+        }
+    }
+
+    return routes;
+}
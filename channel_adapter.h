@@ -0,0 +1,161 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <vector>
+
+#include "halfband_oversampler.h"
+#include "sub_block_fifo.h"
+
+/**
+ * everything that sits between the wrapper's buffer and an inner plugin that doesn't want that buffer as it is
+ *
+ * an inner plugin doesn't have to support the wrapper's bus layout anymore. negotiate() picks the closest layout the plugin does support,
+ * and process() up/downmixes between the two: mono <-> stereo, stereo <-> surround
+ * aux buses are matched up by bus index: the plugin's second input bus gets the wrapper's sidechain, its second output bus goes to the wrapper's first aux output, and so on
+ * (the wrapper's aux buses are all optional, see HostAudioProcessor::maximum_number_of_aux_outputs). A plugin's aux outputs replace whatever was on the wrapper's
+ * aux buses they go to. Aux buses the wrapper doesn't have (or the host didn't enable) get silence in, and their outputs are dropped
+ * it also converts between double and float when the wrapper runs in double precision and the plugin doesn't support that,
+ * and can run the plugin at 2x, 4x or 8x the wrapper's rate (see halfband_oversampler). Oversampled plugins always run in float, because the filters do
+ * it can also feed the plugin fixed size blocks, whatever the host's block size is (see sub_block_fifo). That happens before the oversampling
+ *
+ * when the layouts match and the precision does too, process() just calls the plugin's processBlock on the wrapper's buffer
+ * when the plugin's buses match the wrapper's bus for bus, just not all of them, the plugin's buffer is a table of pointers into the wrapper's buffer and the sidechain, so there's no copy either
+ * otherwise the plugin gets a buffer of its own. All of that memory is allocated in prepare(), the mixing is juce::FloatVectorOperations
+ */
+class channel_adapter {
+public:
+    /// loader thread (or whenever the plugin isn't processing). Applies the closest layout to outer_layout that instance supports,
+    /// and works out how to mix between the two. Returns false (and leaves the plugin's layout alone) if the plugin doesn't support anything we can adapt to
+    bool negotiate(juce::AudioPluginInstance& instance, const juce::AudioProcessor::BusesLayout& outer_layout, juce::String& error);
+
+    /// the wrapper layout the last successful negotiate() was for
+    inline const juce::AudioProcessor::BusesLayout& get_outer_layout() const noexcept { return outer_layout_; }
+
+    /// true if the plugin runs on the wrapper's layout as it is
+    inline bool is_identity() const noexcept { return identity_; }
+
+    /// true if the plugin's buffer is made of the wrapper's channels (see above)
+    inline bool is_direct() const noexcept { return direct_; }
+
+    /// 1 (off), 2, 4 or 8. Before prepare(), and the plugin has to be prepared at the oversampled rate and block size (see inner_plugin_slot::prepare_instance)
+    inline void set_oversampling_factor(int factor) noexcept { oversampling_factor_ = factor; }
+    inline int get_oversampling_factor() const noexcept { return oversampling_factor_; }
+
+    /// 0 (the plugin gets the host's blocks as they are) or the block size the plugin always gets, at the wrapper's rate. Before prepare(), same as the oversampling factor
+    inline void set_sub_block_size(int block_size) noexcept { sub_block_size_ = block_size; }
+    inline int get_sub_block_size() const noexcept { return sub_block_size_; }
+
+    /// the block size the plugin has to be prepared with when the wrapper's is outer_block_size
+    inline int get_inner_block_size(int outer_block_size) const noexcept { return (sub_block_size_ > 0 ? sub_block_size_ : outer_block_size) * oversampling_factor_; }
+
+    /// what the adapter itself adds, in samples at the wrapper's rate. Only valid after prepare()
+    inline int get_latency_samples() const noexcept { return sub_block_size_ + (oversampling_factor_ > 1 ? oversampler_.get_latency_samples() : 0); }
+
+    /// after the plugin's own prepareToPlay (the precision it was prepared with decides whether we need to convert)
+    void prepare(const juce::AudioPluginInstance& instance, int block_size, bool double_precision);
+
+    /// what the last prepare() was for. 0 if it hasn't been prepared yet
+    inline int get_prepared_block_size() const noexcept { return prepared_block_size_; }
+    inline bool is_prepared_for_double() const noexcept { return prepared_double_precision_; }
+
+    /// clears the sub-block fifo and the oversampling filters. Whenever processBlock can't be running
+    void reset() noexcept;
+
+    // audio thread ----------------------------------------------------------------------------------------------------
+    /// audio_buffer has every channel of the wrapper's buffer, aux outputs included. sidechain has the channels of the wrapper's aux inputs, back to back
+    /// a plugin that runs on its buffer directly could write to the sidechain, well behaved ones don't
+    void process(juce::AudioPluginInstance& instance, juce::AudioBuffer<float>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<float>& sidechain);
+    void process(juce::AudioPluginInstance& instance, juce::AudioBuffer<double>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<double>& sidechain);
+
+    /// whether everything the plugin would read this block (the main input if it has one, the sidechain if it has aux inputs) peaks at or below threshold
+    bool is_input_silent(const juce::AudioBuffer<float>& audio_buffer, const juce::AudioBuffer<float>& sidechain, float threshold) const noexcept;
+    bool is_input_silent(const juce::AudioBuffer<double>& audio_buffer, const juce::AudioBuffer<double>& sidechain, float threshold) const noexcept;
+
+    /// the same for what process() wrote (the main outputs and the aux outputs the plugin has). Always true for a plugin without audio outputs, which leaves the audio alone
+    bool is_output_silent(const juce::AudioBuffer<float>& audio_buffer, float threshold) const noexcept;
+    bool is_output_silent(const juce::AudioBuffer<double>& audio_buffer, float threshold) const noexcept;
+
+    /// what process() would leave in audio_buffer if the plugin only put out silence, without calling the plugin
+    void silence(juce::AudioBuffer<float>& audio_buffer) const noexcept;
+    void silence(juce::AudioBuffer<double>& audio_buffer) const noexcept;
+
+private:
+    struct route {
+        int from, to;
+        float gain;
+    };
+
+    /// where a channel of the plugin's buffer points when it runs on the wrapper's channels directly
+    struct direct_channel {
+        bool from_sidechain;
+        int index;            // in the wrapper's buffer or in the sidechain
+    };
+
+    /// how the channels of from end up in the channels of to, by channel type. Indices are within the two sets
+    static std::vector<route> make_routes_(const juce::AudioChannelSet& from, const juce::AudioChannelSet& to);
+
+    /// make_routes_, with the indices moved to where the two sets start in their buffers
+    static void append_routes_(std::vector<route>& routes, const juce::AudioChannelSet& from, int from_offset, const juce::AudioChannelSet& to, int to_offset);
+
+    /// works out direct_channels_ and direct_cleared_. False if the plugin's buses don't line up with the wrapper's closely enough
+    bool make_direct_(const juce::AudioProcessor::BusesLayout& inner_layout);
+
+    template<typename sample_t>
+    void process_adapted_(juce::AudioPluginInstance& instance, juce::AudioBuffer<sample_t>& outer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain);
+
+    /// the plugin's processBlock, in sub-blocks if they're on
+    template<typename sample_t>
+    void process_inner_(juce::AudioPluginInstance& instance, juce::AudioBuffer<sample_t>& buffer, juce::MidiBuffer& midi_buffer);
+
+    /// the plugin's processBlock, through the oversampler if there is one
+    template<typename sample_t>
+    void process_plugin_(juce::AudioPluginInstance& instance, juce::AudioBuffer<sample_t>& buffer, juce::MidiBuffer& midi_buffer);
+    void process_oversampled_(juce::AudioPluginInstance& instance, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi_buffer);
+
+    template<typename sample_t>
+    bool is_input_silent_(const juce::AudioBuffer<sample_t>& outer, const juce::AudioBuffer<sample_t>& sidechain, float threshold) const noexcept;
+
+    template<typename sample_t>
+    bool is_output_silent_(const juce::AudioBuffer<sample_t>& outer, float threshold) const noexcept;
+
+    template<typename sample_t>
+    void silence_(juce::AudioBuffer<sample_t>& outer) const noexcept;
+
+    template<typename sample_t>
+    static void mix_(const std::vector<route>& routes, const juce::AudioBuffer<sample_t>& source, juce::AudioBuffer<sample_t>& destination, int number_of_samples) noexcept;
+
+    juce::AudioProcessor::BusesLayout outer_layout_;
+    bool identity_ = true, direct_ = false;
+    int outer_channels_ = 0, inner_channels_ = 0;          // what each side's processBlock buffer has
+    int outer_main_channels_ = 0, sidechain_channels_ = 0; // the wrapper's main buses, and its aux inputs
+    int main_inputs_read_ = 0;                             // the wrapper's main input channels, 0 if the plugin doesn't have a main input
+    bool reads_sidechain_ = false;
+    int inner_outputs_ = 0;
+    int prepared_block_size_ = 0;
+    bool prepared_double_precision_ = false;
+
+    std::vector<route> input_routes_, output_routes_;         // wrapper -> plugin, plugin -> wrapper
+    std::vector<route> aux_input_routes_, aux_output_routes_; // sidechain -> plugin, plugin -> the wrapper's aux outputs
+    std::vector<int> aux_output_targets_;                     // every channel of the wrapper's aux buses the plugin has outputs for
+
+    std::vector<direct_channel> direct_channels_;             // one per channel of the plugin's buffer
+    std::vector<int> direct_cleared_;                         // the wrapper's channels the plugin only writes to, cleared before it runs
+    std::vector<float*>  direct_pointers_;                    // filled every block from direct_channels_, sized in prepare
+    std::vector<double*> direct_pointers_double_;
+
+    // sized in prepare, only what's actually needed gets memory
+    juce::AudioBuffer<float>  inner_scratch_;
+    juce::AudioBuffer<double> inner_scratch_double_;
+    juce::AudioBuffer<float>  conversion_scratch_;        // the wrapper's double buffer (and the sidechain) as float, for a plugin that only does float
+
+    static constexpr std::size_t midi_scratch_bytes_ = 16384;
+
+    int sub_block_size_ = 0;
+    sub_block_fifo<float>  sub_blocks_;
+    sub_block_fifo<double> sub_blocks_double_;
+
+    int oversampling_factor_ = 1;
+    halfband_oversampler oversampler_;
+    juce::MidiBuffer oversampled_midi_;                   // the block's midi with the timestamps at the plugin's rate
+};
@@ -0,0 +1,67 @@
+#include "epoch_reclaimer.h"
+
+#include <algorithm>
+
+epoch_reclaimer::epoch_reclaimer(std::size_t number_of_pins) : number_of_pins_(number_of_pins),
+                                                                pins_(new std::atomic<const void*>[number_of_pins]) {
+    for(std::size_t i = 0; i < number_of_pins_; ++i) {
+        pins_[i] = nullptr;
+    }
+}
+
+epoch_reclaimer::~epoch_reclaimer() {
+    collect_all();
+}
+
+void epoch_reclaimer::set_reader_active(bool is_active) noexcept {
+    if(! is_active) {
+        for(std::size_t i = 0; i < number_of_pins_; ++i) {
+            pins_[i].store(nullptr, std::memory_order_seq_cst);
+        }
+    }
+    reader_active_.store(is_active, std::memory_order_seq_cst);
+}
+
+std::size_t epoch_reclaimer::collect() {
+    if(retired_.empty()) {
+        return 0;
+    }
+
+    const bool    reader_active = reader_active_.load(std::memory_order_seq_cst);
+    const epoch_t reader_epoch  = reader_epoch_ .load(std::memory_order_seq_cst);
+
+    const auto is_pinned = [this] (const void* object) {
+        for(std::size_t i = 0; i < number_of_pins_; ++i) {
+            if(pins_[i].load(std::memory_order_seq_cst) == object) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    const auto is_safe = [&] (const retired_object& r) {
+        if(! reader_active) {
+            return true;
+        }
+        return reader_epoch >= r.epoch && ! is_pinned(r.object.get());
+    };
+
+    // the safe ones are taken out of the list before anything gets recycled, so a recycler can retire things itself
+    const auto first_safe = std::stable_partition(retired_.begin(), retired_.end(), [&] (const retired_object& r) { return ! is_safe(r); });
+
+    std::vector<retired_object> reclaimed(std::make_move_iterator(first_safe), std::make_move_iterator(retired_.end()));
+    retired_.erase(first_safe, retired_.end());
+
+    // destroying a plugin instance can take a while, but we're on the message thread so that's fine
+    for(auto& r : reclaimed) {
+        if(r.recycle) {
+            r.recycle(r.object.release());
+        }
+    }
+
+    return retired_.size();
+}
+
+void epoch_reclaimer::collect_all() {
+    retired_.clear();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+/**
+ * epoch based reclamation for objects that the audio thread might still be using
+ *
+ * the message thread publishes a replacement (e.g. a new inner plugin instance) with an atomic pointer store and then hands the old object to retire()
+ * instead of destroying it straight away. retire() tags the object with a fresh epoch
+ * the audio thread calls reader_begin_block() at the very start of every processBlock, *before* it loads any published pointer,
+ * which publishes the epoch it observed. Once the reader has observed an epoch at least as new as an object's tag,
+ * every block that could have loaded the old pointer has finished, so collect() can destroy the object
+ *
+ * this replaces the old "only one plugin change per processBlock call" flag: any number of back-to-back retirements are fine,
+ * they just sit in the list until the audio thread moves past them
+ *
+ * the audio thread only ever does a couple of atomic loads and stores here, it never blocks and never frees anything
+ * retire() and collect() must only be called from one thread (the message thread)
+ */
+class epoch_reclaimer {
+public:
+    using epoch_t = std::uint64_t;
+
+    /// number_of_pins is how many objects the audio thread can keep alive through reader_pin() at the same time
+    explicit epoch_reclaimer(std::size_t number_of_pins = 2);
+    ~epoch_reclaimer();
+
+    epoch_reclaimer(const epoch_reclaimer&) = delete;
+    epoch_reclaimer& operator=(const epoch_reclaimer&) = delete;
+
+    /// audio thread. Call this before loading any pointer protected by this reclaimer
+    inline void reader_begin_block() noexcept {
+        reader_epoch_.store(global_epoch_.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+    }
+
+    /// audio thread. Keeps an object that was loaded in an earlier block alive after it's been retired, e.g. so that it can be crossfaded out
+    /// the pin has to be stored before the reader_begin_block() call of the next block, so the usual pattern is to pin
+    /// everything you might still need at the end of a block. nullptr unpins
+    inline void reader_pin(std::size_t pin_index, const void* object) noexcept {
+        pins_[pin_index].store(object, std::memory_order_seq_cst);
+    }
+
+    /// call with false from releaseResources() (or anywhere else where processBlock is guaranteed to not be running),
+    /// and with true from prepareToPlay(). While the reader is inactive, everything retired can be destroyed immediately
+    void set_reader_active(bool is_active) noexcept;
+
+    /// message thread. object must already be unreachable through any published pointer
+    template<typename T>
+    void retire(std::unique_ptr<T> object) {
+        if(object == nullptr) {
+            return;
+        }
+
+        const epoch_t tag = global_epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        retired_.push_back({ {object.release(), [] (void* p) { delete static_cast<T*>(p); }}, tag, {} });
+    }
+
+    /// same, but once the reader is done with the object it's handed to recycle (on the message thread, from collect()) instead of being destroyed
+    /// collect_all() doesn't recycle anything, it destroys everything
+    template<typename T>
+    void retire(std::unique_ptr<T> object, std::function<void(std::unique_ptr<T>)> recycle) {
+        if(object == nullptr) {
+            return;
+        }
+
+        const epoch_t tag = global_epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        retired_.push_back({ {object.release(), [] (void* p) { delete static_cast<T*>(p); }}, tag,
+                             [recycle = std::move(recycle)] (void* p) { recycle(std::unique_ptr<T>(static_cast<T*>(p))); } });
+    }
+
+    /// message thread. Destroys every retired object the reader is guaranteed to be done with
+    /// returns the number of objects that are still pending
+    std::size_t collect();
+
+    /// message thread. Destroys everything regardless of the reader. Only safe when processBlock can't be running
+    void collect_all();
+
+    inline std::size_t pending() const noexcept { return retired_.size(); }
+
+private:
+    struct retired_object {
+        std::unique_ptr<void, void(*)(void*)> object;
+        epoch_t epoch;
+        std::function<void(void*)> recycle; // takes ownership. Empty for plain retire()
+    };
+
+    std::atomic<epoch_t> global_epoch_ = 1;
+    std::atomic<epoch_t> reader_epoch_ = 0;
+    std::size_t number_of_pins_;
+    std::unique_ptr<std::atomic<const void*>[]> pins_;
+    std::atomic<bool> reader_active_ = false;
+
+    std::vector<retired_object> retired_; // only ever touched by the message thread
+};
@@ -3,54 +3,27 @@
 
 /// this file and forwarding_parameter_ptr.cpp were written by me (original-picture), not the juce people
 
-void forwarding_parameter_ptr::parameterValueChanged (int parameterIndex, float newValue) {
-    setValueNotifyingHost(newValue); // we have to do this, otherwise the DAW won't realize that the inner parameter has changed and could potentially allow the user to close their project without prompting them to save!
-}
-
-// this member function is pure virtual in juce::AudioProcessorParameter::Listener, so we have to override it and have it do nothing
-void forwarding_parameter_ptr::parameterGestureChanged(int parameterIndex, bool gestureIsStarting) {}
-
-
-forwarding_parameter_ptr::forwarding_parameter_ptr(const juce::String& placeholder_name) : placeholder_name_(placeholder_name) {}
-
-forwarding_parameter_ptr::forwarding_parameter_ptr(unsigned int parameter_index) : placeholder_name_("Unused parameter " + juce::String(parameter_index)) {}
-
-forwarding_parameter_ptr forwarding_parameter_ptr::create_with_placeholder_name_from_index(unsigned int parameter_index) {
-    return {parameter_index};
-}
-
-void forwarding_parameter_ptr::set_forwarded_parameter(juce::AudioProcessorParameter* parameter_to_forward) {
-    forwarded_parameter_ = parameter_to_forward;
-    if(parameter_to_forward) {
-        parameter_to_forward->addListener(this);
-        setValueNotifyingHost(forwarded_parameter_->getValue());
-    }
-}
+forwarding_parameter_ptr::forwarding_parameter_ptr(parameter_forwarding_table& table, std::size_t parameter_index) : table_(table),
+                                                                                                                    index_(parameter_index),
+                                                                                                                    placeholder_name_("Unused parameter " + juce::String(parameter_index)) {}
 
 
 forwarding_parameter_ptr::operator bool() const {
-    return forwarded_parameter_;
+    return forwarded_parameter_() != nullptr;
 }
 
 
 float forwarding_parameter_ptr::getValue() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getValue();
-    }
-    else {
-        return 0.f;
-    }
+    return table_.get_value(index_); // 0 for an empty entry, see parameter_forwarding_table::unbind_from
 }
 
 void forwarding_parameter_ptr::setValue(float newValue) {
-    if(forwarded_parameter_) {
-        forwarded_parameter_->setValue(newValue);
-    }
+    table_.set_value(index_, newValue);
 }
 
 float forwarding_parameter_ptr::getDefaultValue() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getDefaultValue();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->default_value;
     }
     else {
         return 0.f;
@@ -58,8 +31,8 @@ float forwarding_parameter_ptr::getDefaultValue() const {
 }
 
 juce::String forwarding_parameter_ptr::getName (int maximumStringLength) const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getName(maximumStringLength);
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->name.substring(0, maximumStringLength);
     }
     else {
         return placeholder_name_;
@@ -67,8 +40,8 @@ juce::String forwarding_parameter_ptr::getName (int maximumStringLength) const {
 }
 
 juce::String forwarding_parameter_ptr::getLabel() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getLabel();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->label;
     }
     else {
         return {};
@@ -76,8 +49,8 @@ juce::String forwarding_parameter_ptr::getLabel() const {
 }
 
 int forwarding_parameter_ptr::getNumSteps() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getNumSteps();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->number_of_steps;
     }
     else {
         return 1;
@@ -85,8 +58,8 @@ int forwarding_parameter_ptr::getNumSteps() const {
 }
 
 bool forwarding_parameter_ptr::isDiscrete() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->isDiscrete();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->discrete;
     }
     else {
         return true;
@@ -94,8 +67,8 @@ bool forwarding_parameter_ptr::isDiscrete() const {
 }
 
 bool forwarding_parameter_ptr::isBoolean() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->isDiscrete();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->boolean;
     }
     else {
         return false;
@@ -103,8 +76,15 @@ bool forwarding_parameter_ptr::isBoolean() const {
 }
 
 juce::String forwarding_parameter_ptr::getText (float normalisedValue, int maximumStringLength) const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getText(normalisedValue, maximumStringLength);
+    if(auto metadata = table_.get_metadata(index_)) {
+        if(auto* step_text = metadata->find_step_text(normalisedValue)) {
+            return step_text->substring(0, maximumStringLength);
+        }
+    }
+
+    // continuous parameters' texts depend on the value, so those still have to ask the plugin
+    if(auto* forwarded = forwarded_parameter_()) {
+        return forwarded->getText(normalisedValue, maximumStringLength);
     }
     else {
         return "No value -- parameter not in use";
@@ -112,8 +92,16 @@ juce::String forwarding_parameter_ptr::getText (float normalisedValue, int maxim
 }
 
 float forwarding_parameter_ptr::getValueForText (const juce::String& text) const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getValueForText(text);
+    if(auto metadata = table_.get_metadata(index_)) {
+        const float step_value = metadata->find_step_value(text);
+
+        if(step_value >= 0.f) {
+            return step_value;
+        }
+    }
+
+    if(auto* forwarded = forwarded_parameter_()) {
+        return forwarded->getValueForText(text);
     }
     else {
         return 0.f;
@@ -121,8 +109,8 @@ float forwarding_parameter_ptr::getValueForText (const juce::String& text) const
 }
 
 bool forwarding_parameter_ptr::isOrientationInverted() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->isOrientationInverted();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->orientation_inverted;
     }
     else {
         return false;
@@ -130,8 +118,8 @@ bool forwarding_parameter_ptr::isOrientationInverted() const {
 }
 
 bool forwarding_parameter_ptr::isAutomatable() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->isAutomatable();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->automatable;
     }
     else {
         return true;
@@ -139,8 +127,8 @@ bool forwarding_parameter_ptr::isAutomatable() const {
 }
 
 bool forwarding_parameter_ptr::isMetaParameter() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->isMetaParameter();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->meta;
     }
     else {
         return false;
@@ -148,8 +136,8 @@ bool forwarding_parameter_ptr::isMetaParameter() const {
 }
 
 juce::AudioProcessorParameter::Category forwarding_parameter_ptr::getCategory() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getCategory();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->category;
     }
     else {
         return genericParameter;
@@ -157,8 +145,8 @@ juce::AudioProcessorParameter::Category forwarding_parameter_ptr::getCategory()
 }
 
 juce::String forwarding_parameter_ptr::getCurrentValueAsText() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getCurrentValueAsText();
+    if(forwarded_parameter_() != nullptr) {
+        return getText(getValue(), 1024); // same as what the base class does, but through the cache
     }
     else {
         return "No value -- parameter not in use";
@@ -167,8 +155,8 @@ juce::String forwarding_parameter_ptr::getCurrentValueAsText() const {
 
 
 juce::StringArray forwarding_parameter_ptr::getAllValueStrings() const {
-    if(forwarded_parameter_) {
-        return forwarded_parameter_->getAllValueStrings();
+    if(auto metadata = table_.get_metadata(index_)) {
+        return metadata->all_value_strings;
     }
     else {
         return {"No values -- parameter not in use"};
@@ -3,38 +3,34 @@
 
 #include "juce_audio_processors/juce_audio_processors.h"
 
+#include "parameter_forwarding_table.h"
+
 /**
  * this file and forwarding_parameter_ptr.cpp were written by me (original-picture), not the juce people
  *
  * this is a simple helper class that is used to forward parameters from the inner plugin to the outer plugin
- * It holds a pointer to a AudioProcessorParameter and forwards all its virtual member functions inherited from juce::AudioProcessorParameter
- * to this pointer
- * an object of this type can be empty (the internal pointer can be null). In this case, all of the virtual member functions will return default values
+ * It refers to one entry of a parameter_forwarding_table and forwards all its virtual member functions inherited from juce::AudioProcessorParameter
+ * to the parameter in that entry
+ * an object of this type can be empty (the entry can be null). In this case, all of the virtual member functions will return default values
+ *
+ * the pointers (and a cached value) live in the table, and the processor listens to the inner plugins as a whole, rather than every one of these holding
+ * its own pointer and listener. With a couple thousand parameters that would be a couple thousand listeners and a pointer chase per parameter
  *
  * thanks to eyalamir from the juce forums for giving me this idea https://forum.juce.com/t/forwarding-the-parameters-of-a-hosted-plugin/65751/2?u=original-picture
  */
-class forwarding_parameter_ptr : public juce::AudioProcessorParameter,
-                                 public juce::AudioProcessorParameter::Listener { // so we can get notified and call setValueNotifyingHost when the wrapped parameter changes
-    juce::AudioProcessorParameter* forwarded_parameter_ = nullptr; // I was using HostedAudioProcessorParameter here, but that didn't work with the AudioPluginInstance in the processor,
-    juce::String placeholder_name_;                                // because the getParameters member function of AudioPluginInstance return an array of AudioProcessorParameter, not HostedAudioProcessorParameter
-                                                                   // idk maybe this is a sign that I should be doing something differently
+class forwarding_parameter_ptr : public juce::AudioProcessorParameter {
+    parameter_forwarding_table& table_;
+    std::size_t index_;
+    juce::String placeholder_name_;
 
-    void parameterValueChanged  (int parameterIndex, float newValue) override;
-    void parameterGestureChanged(int parameterIndex, bool gestureIsStarting) override;
+    inline juce::AudioProcessorParameter* forwarded_parameter_() const noexcept { return table_.get_target(index_); }
 
 public:
-    /// placeholder_name is a string to use if this object points to a parameter (is not null)
-    forwarding_parameter_ptr(const juce::String& placeholder_name);
-
-    /// does the same thing as create_with_placeholder_name_from_index
-    forwarding_parameter_ptr(unsigned parameter_index);
-
-    static forwarding_parameter_ptr create_with_placeholder_name_from_index(unsigned parameter_index);
-
-    void set_forwarded_parameter(juce::AudioProcessorParameter* parameter_to_forward);
+    /// refers to entry parameter_index of table. The placeholder name (used while the entry is empty) is made from the index
+    forwarding_parameter_ptr(parameter_forwarding_table& table, std::size_t parameter_index);
 
 
-    // delete all copy/move constructors/assignment operators because everything breaks if the address of an object changes (because this pointer is registered as a listener)
+    // delete all copy/move constructors/assignment operators, the host refers to parameters by address
     // doesn't really change anything in practice, because juce parameters are always dynamically allocated individually
     // just prevents a user from doing something dangerous
     forwarding_parameter_ptr(const forwarding_parameter_ptr&) = delete;
@@ -48,6 +44,7 @@ public:
 
     /// every member function here just forwards the corresponding member function of the parameter that this object points to
     /// if there is no forwarded parameter, they return default values
+    /// except getValue, which comes from the table's cache
     float getValue() const override;
     void setValue (float newValue) override;
     float getDefaultValue() const override;
@@ -0,0 +1,192 @@
+#include "halfband_oversampler.h"
+
+#include "simd_kernels.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // per stage: K (the filter has 4K - 1 taps) and the Kaiser window's beta
+    // K is even, so the FIR branches are a multiple of 4 long and simd_kernels::dot never has a scalar tail
+    // the first stage has to be flat up to ~20 kHz at 44.1/48k and done by the base rate's nyquist, the later ones have a lot more room
+    constexpr int stage_half_lengths[] = { 16, 8, 8 };
+    constexpr float stage_kaiser_betas[] = { 8.f, 8.f, 8.f };
+
+    double bessel_i0(double x) {
+        double sum = 1.0, term = 1.0;
+
+        for(int k = 1; k < 32; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+
+        return sum;
+    }
+}
+
+void halfband_oversampler::prepare(int factor, int number_of_channels, int maximum_block_size) {
+    number_of_stages_ = 0;
+
+    while((1 << number_of_stages_) < factor && number_of_stages_ < maximum_number_of_stages) {
+        ++number_of_stages_;
+    }
+
+    jassert(factor == get_factor()); // 1, 2, 4 or 8
+
+    number_of_channels_ = number_of_channels;
+    maximum_block_size_ = maximum_block_size;
+
+    int round_trip_top_rate_samples = 0;
+
+    for(int stage_i = 0; stage_i < maximum_number_of_stages; ++stage_i) {
+        auto& s = stages_[(std::size_t) stage_i];
+        const bool used = stage_i < number_of_stages_;
+
+        const int half_length = stage_half_lengths[stage_i];
+        const int input_block_size = maximum_block_size << stage_i; // the rate going into this stage is the base rate times 2^stage_i
+
+        make_taps_(s, half_length, stage_kaiser_betas[stage_i]);
+
+        s.up_history       .setSize(used ? number_of_channels : 0, used ? 2 * half_length - 1 + input_block_size : 0);
+        s.down_even_history.setSize(used ? number_of_channels : 0, used ? 2 * half_length - 1 + input_block_size : 0);
+        s.down_odd_history .setSize(used ? number_of_channels : 0, used ? half_length + input_block_size : 0);
+        s.output           .setSize(used ? number_of_channels : 0, used ? 2 * input_block_size : 0);
+
+        if(used) {
+            // the filter is 4K - 1 taps long, so its delay is 2K - 1 samples at the stage's high rate. It's in the signal twice, once going up and once coming down
+            round_trip_top_rate_samples += (2 * (2 * half_length - 1)) << (number_of_stages_ - stage_i - 1);
+        }
+    }
+
+    const int top_factor = get_factor();
+    padding_ = (top_factor - round_trip_top_rate_samples % top_factor) % top_factor;
+    padding_history_.setSize(number_of_stages_ > 0 && padding_ > 0 ? number_of_channels : 0, padding_ + maximum_block_size * top_factor);
+
+    latency_samples_ = (round_trip_top_rate_samples + padding_) / top_factor;
+
+    reset();
+}
+
+void halfband_oversampler::reset() noexcept {
+    for(auto& s : stages_) {
+        s.up_history.clear();
+        s.down_even_history.clear();
+        s.down_odd_history.clear();
+    }
+
+    padding_history_.clear();
+}
+
+void halfband_oversampler::make_taps_(stage& s, int half_length, float kaiser_beta) {
+    // windowed sinc with its cutoff at a quarter of the high rate. Every tap an even distance from the centre is zero, so we only keep the others
+    const int length = 4 * half_length - 1;
+    const int centre = 2 * half_length - 1;
+
+    s.half_length = half_length;
+    s.taps.resize((std::size_t) (2 * half_length));
+
+    double sum = 0.0;
+
+    for(int i = 0; i < 2 * half_length; ++i) {
+        const int n = 2 * i;
+        const double distance = n - centre; // odd, never 0
+        const double window_position = 2.0 * n / (length - 1) - 1.0;
+        const double window = bessel_i0(kaiser_beta * std::sqrt(1.0 - window_position * window_position)) / bessel_i0(kaiser_beta);
+
+        const double tap = std::sin(juce::MathConstants<double>::halfPi * distance) / (juce::MathConstants<double>::pi * distance) * window;
+
+        s.taps[(std::size_t) i] = (float) tap;
+        sum += tap;
+    }
+
+    // together with the 0.5 in the centre, the filter has unity gain at DC
+    for(auto& tap : s.taps) {
+        tap = (float) (tap * 0.5 / sum);
+    }
+}
+
+void halfband_oversampler::upsample_(const juce::AudioBuffer<float>& buffer) noexcept {
+    const int number_of_channels = buffer.getNumChannels();
+    int number_of_samples = buffer.getNumSamples();
+
+    for(int stage_i = 0; stage_i < number_of_stages_; ++stage_i) {
+        auto& s = stages_[(std::size_t) stage_i];
+
+        for(int channel = 0; channel < number_of_channels; ++channel) {
+            const float* input = stage_i == 0 ? buffer.getReadPointer(channel) : stages_[(std::size_t) stage_i - 1].output.getReadPointer(channel);
+            upsample_channel_(s, channel, input, s.output.getWritePointer(channel), number_of_samples);
+        }
+
+        number_of_samples *= 2;
+    }
+
+    if(padding_ == 0) {
+        return;
+    }
+
+    auto& top = stages_[(std::size_t) number_of_stages_ - 1].output;
+
+    for(int channel = 0; channel < number_of_channels; ++channel) {
+        float* history = padding_history_.getWritePointer(channel);
+        float* output = top.getWritePointer(channel);
+
+        std::memcpy(history + padding_, output, sizeof(float) * (std::size_t) number_of_samples);
+        std::memcpy(output, history, sizeof(float) * (std::size_t) number_of_samples);
+        std::memmove(history, history + number_of_samples, sizeof(float) * (std::size_t) padding_);
+    }
+}
+
+void halfband_oversampler::downsample_(juce::AudioBuffer<float>& buffer) noexcept {
+    const int number_of_channels = buffer.getNumChannels();
+
+    // the top stage's output buffer holds what the plugin made. Every stage downsamples into the output buffer of the stage below it, which isn't needed anymore
+    for(int stage_i = number_of_stages_ - 1; stage_i >= 0; --stage_i) {
+        auto& s = stages_[(std::size_t) stage_i];
+        const int number_of_samples = buffer.getNumSamples() << stage_i; // at this stage's low rate
+
+        for(int channel = 0; channel < number_of_channels; ++channel) {
+            float* output = stage_i == 0 ? buffer.getWritePointer(channel) : stages_[(std::size_t) stage_i - 1].output.getWritePointer(channel);
+            downsample_channel_(s, channel, s.output.getReadPointer(channel), output, number_of_samples);
+        }
+    }
+}
+
+void halfband_oversampler::upsample_channel_(stage& s, int channel, const float* input, float* output, int number_of_samples) noexcept {
+    const int k = s.half_length;
+    const int fir_length = 2 * k;
+    const int history_length = fir_length - 1;
+
+    float* history = s.up_history.getWritePointer(channel);
+    std::memcpy(history + history_length, input, sizeof(float) * (std::size_t) number_of_samples);
+
+    // zero stuffing and filtering, one output sample per phase: the even ones are the FIR branch, the odd ones are just the input, delayed
+    // (times 2 to make up for the energy the zeros would have cost)
+    for(int i = 0; i < number_of_samples; ++i) {
+        output[2 * i]     = 2.f * simd_kernels::dot(s.taps.data(), history + i, fir_length);
+        output[2 * i + 1] = history[i + k];
+    }
+
+    std::memmove(history, history + number_of_samples, sizeof(float) * (std::size_t) history_length);
+}
+
+void halfband_oversampler::downsample_channel_(stage& s, int channel, const float* input, float* output, int number_of_samples) noexcept {
+    const int k = s.half_length;
+    const int fir_length = 2 * k;
+    const int even_history_length = fir_length - 1;
+
+    float* even = s.down_even_history.getWritePointer(channel);
+    float* odd  = s.down_odd_history.getWritePointer(channel);
+
+    for(int i = 0; i < number_of_samples; ++i) {
+        even[even_history_length + i] = input[2 * i];
+        odd[k + i]                    = input[2 * i + 1];
+    }
+
+    // filtering and dropping every other sample: only the outputs we keep get computed
+    for(int i = 0; i < number_of_samples; ++i) {
+        output[i] = simd_kernels::dot(s.taps.data(), even + i, fir_length) + 0.5f * odd[i];
+    }
+
+    std::memmove(even, even + number_of_samples, sizeof(float) * (std::size_t) even_history_length);
+    std::memmove(odd,  odd  + number_of_samples, sizeof(float) * (std::size_t) k);
+}
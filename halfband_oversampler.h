@@ -0,0 +1,77 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <array>
+#include <vector>
+
+/**
+ * 2x, 4x or 8x oversampling with a cascade of polyphase halfband FIR filters, one per doubling
+ *
+ * halfband filters have every other tap at zero (except the centre one, which is 0.5), so each stage splits into two branches at the low rate:
+ * a short FIR for one phase and a plain delay for the other. That's half the multiplies of a normal FIR, and the FIR branch is simd_kernels::dot
+ * the first stage does the steep filtering, the later ones run at higher rates but only have to get rid of images further away, so they're shorter
+ *
+ * the round trip latency is padded to a whole number of samples at the base rate, so it can be reported (and compensated) exactly
+ * everything is allocated in prepare(). process() doesn't allocate and can be called on the audio thread
+ */
+class halfband_oversampler {
+public:
+    static constexpr int maximum_number_of_stages = 3; // 8x
+
+    /// factor is 1 (off), 2, 4 or 8. Message thread (or wherever the plugin gets prepared)
+    void prepare(int factor, int number_of_channels, int maximum_block_size);
+
+    /// clears the filters' history
+    void reset() noexcept;
+
+    inline int get_factor() const noexcept { return 1 << number_of_stages_; }
+
+    /// up and back down, in samples at the base rate
+    inline int get_latency_samples() const noexcept { return latency_samples_; }
+
+    /// upsamples buffer, calls process_oversampled with a buffer factor times as long, and downsamples the result back into buffer
+    /// a buffer with more channels or samples than prepare() was told about is left alone (and process_oversampled isn't called), rather than allocating
+    template<typename callback_t>
+    void process(juce::AudioBuffer<float>& buffer, callback_t&& process_oversampled) {
+        const int number_of_channels = buffer.getNumChannels();
+        const int number_of_samples = buffer.getNumSamples();
+
+        if(number_of_stages_ == 0 || number_of_channels > number_of_channels_ || number_of_samples > maximum_block_size_) {
+            jassert(number_of_stages_ == 0);
+            return;
+        }
+
+        upsample_(buffer);
+
+        juce::AudioBuffer<float> oversampled(stages_[(std::size_t) number_of_stages_ - 1].output.getArrayOfWritePointers(), number_of_channels, number_of_samples * get_factor()); // no allocation
+        process_oversampled(oversampled);
+
+        downsample_(buffer);
+    }
+
+private:
+    struct stage {
+        int half_length = 0;          // K. The filter has 4K - 1 taps, 2K of them (plus the centre) aren't zero
+        std::vector<float> taps;      // the 2K non-zero taps next to the centre, h[0], h[2], ... h[4K - 2]. Symmetric, so they're also their own reverse
+
+        // one row per channel: the history the FIR branches need, followed by room for a block
+        juce::AudioBuffer<float> up_history, down_even_history, down_odd_history;
+        juce::AudioBuffer<float> output; // this stage's upsampled signal
+    };
+
+    static void make_taps_(stage& s, int half_length, float kaiser_beta);
+
+    void upsample_(const juce::AudioBuffer<float>& buffer) noexcept;
+    void downsample_(juce::AudioBuffer<float>& buffer) noexcept;
+
+    static void upsample_channel_(stage& s, int channel, const float* input, float* output, int number_of_samples) noexcept;
+    static void downsample_channel_(stage& s, int channel, const float* input, float* output, int number_of_samples) noexcept;
+
+    std::array<stage, maximum_number_of_stages> stages_;
+    int number_of_stages_ = 0, number_of_channels_ = 0, maximum_block_size_ = 0;
+
+    int padding_ = 0;                           // extra delay at the top rate, so the latency comes out whole
+    juce::AudioBuffer<float> padding_history_;
+    int latency_samples_ = 0;
+};
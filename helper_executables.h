@@ -0,0 +1,33 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+/**
+ * the wrapper's helper executables (HostPluginDemo-cmake-scanner and HostPluginDemo-cmake-sandbox) get installed next to the plugin
+ * the build copies them into every format's artefact folder, see the end of CMakeLists.txt
+ * "next to" is a bit vague for plugins, which live inside bundles (e.g. HostPluginDemo-cmake.vst3/Contents/x86_64-linux), so this looks a few levels up too
+ * returns a non-existent file if there's no such executable
+ */
+inline juce::File find_helper_executable(const juce::String& name) {
+    constexpr int maximum_parent_directories = 4;
+
+   #if JUCE_WINDOWS
+    const auto file_name = name + ".exe";
+   #else
+    const auto file_name = name;
+   #endif
+
+    auto directory = juce::File::getSpecialLocation(juce::File::currentExecutableFile).getParentDirectory();
+
+    for(int i = 0; i <= maximum_parent_directories && directory.exists(); ++i) {
+        const auto candidate = directory.getChildFile(file_name);
+
+        if(candidate.existsAsFile()) {
+            return candidate;
+        }
+
+        directory = directory.getParentDirectory();
+    }
+
+    return {};
+}
@@ -0,0 +1,304 @@
+#include "inner_plugin_loader.h"
+
+#include "inner_plugin_slot.h"
+#include "sandboxed_plugin_instance.h"
+
+#include <cstdio>
+#include <string_view>
+
+#if JUCE_LINUX || JUCE_BSD
+ #include <unistd.h>
+#elif JUCE_MAC
+ #include <mach/mach.h>
+#endif
+
+struct inner_plugin_loader::job_state {
+    request req;
+    completion_callback on_finished;
+
+    result res;
+
+    std::atomic<stage> current_stage = stage::instantiating;
+    std::atomic<float> progress = 0.f;
+    std::atomic<bool>  cancelled = false;
+
+    std::size_t resident_before = 0;
+
+    inline void set_stage(stage s, float p) noexcept {
+        current_stage = s;
+        progress = p;
+    }
+};
+
+// everything in here runs on a loader thread. The instance isn't published yet, so nobody else is touching it
+class inner_plugin_loader::prepare_job final : public juce::ThreadPoolJob {
+public:
+    prepare_job(int key, std::shared_ptr<job_state> state, juce::WeakReference<inner_plugin_loader> owner) : ThreadPoolJob("inner plugin loader"),
+                                                                                                              key_(key),
+                                                                                                              state_(std::move(state)),
+                                                                                                              owner_(std::move(owner)) {}
+
+    JobStatus runJob() override {
+        auto& s = *state_;
+
+        if(s.res.instance == nullptr && ! should_stop_()) {
+            // sandboxed. Starting the sandbox (and waiting for it to load the plugin) doesn't need the message thread, so it happens here
+            juce::String error;
+            s.res.instance = sandboxed_plugin_instance::create(s.req.description, error);
+
+            if(s.res.instance == nullptr) {
+                s.res.error = error;
+                s.set_stage(stage::finishing, 1.f);
+                finish_async_();
+                return jobHasFinished;
+            }
+        }
+
+        if(s.res.instance == nullptr) {
+            finish_async_(); // cancelled before the sandbox was started
+            return jobHasFinished;
+        }
+
+        auto& instance = *s.res.instance;
+
+        if(! s.req.state.isEmpty() && ! should_stop_()) {
+            s.set_stage(stage::restoring_state, 0.3f);
+            instance.setStateInformation(s.req.state.getData(), (int) s.req.state.getSize());
+        }
+
+        if(! should_stop_()) {
+            s.set_stage(stage::applying_layout, 0.6f);
+
+            s.res.adapter.set_oversampling_factor(s.req.oversampling_factor);
+            s.res.adapter.set_sub_block_size(s.req.sub_block_size);
+            s.res.adapter.negotiate(instance, s.req.layout, s.res.error); // the closest layout the plugin supports, which doesn't have to be ours anymore
+        }
+
+        if(s.res.error.isEmpty() && s.req.prepare && ! should_stop_()) {
+            s.set_stage(stage::preparing, 0.8f);
+            inner_plugin_slot::prepare_instance(instance, s.req.sample_rate, s.req.block_size, s.req.double_precision, s.res.adapter);
+
+            // prepareToPlay can't fail, but a sandbox can. Better to say so now than to load a plugin that's never going to make a sound
+            if(auto* sandboxed = dynamic_cast<sandboxed_plugin_instance*>(&instance)) {
+                const auto cost = sandboxed->get_cost();
+
+                if(! cost.running) {
+                    s.res.error = cost.error.isNotEmpty() ? cost.error : juce::String("the sandbox couldn't prepare the plugin");
+                }
+            }
+
+            s.res.prepared = true;
+            s.res.double_precision = s.req.double_precision;
+            s.res.sample_rate = s.req.sample_rate;
+            s.res.block_size = s.req.block_size;
+        }
+
+        if(s.res.error.isEmpty() && s.req.hash_state && ! should_stop_()) {
+            juce::MemoryBlock state;
+            instance.getStateInformation(state);
+            s.res.state_hash = hash_state(state);
+        }
+
+        const auto resident_after = get_resident_bytes();
+        s.res.footprint_bytes = resident_after > s.resident_before ? resident_after - s.resident_before : 0;
+
+        s.set_stage(stage::finishing, 1.f);
+        finish_async_();
+
+        return jobHasFinished;
+    }
+
+    inline bool is_owned_by(const inner_plugin_loader& loader) const noexcept { return owner_.get() == &loader; }
+
+private:
+    // the instance always goes back to the message thread, even when we got cancelled, because that's where it has to be destroyed
+    void finish_async_() {
+        juce::MessageManager::callAsync([key = key_, state = state_, owner = owner_] {
+            if(auto* loader = owner.get()) {
+                loader->finish_(key, state);
+            }
+            else {
+                state->res.instance.reset();
+            }
+        });
+    }
+
+    bool should_stop_() const noexcept { return state_->cancelled || shouldExit(); }
+
+    int key_;
+    std::shared_ptr<job_state> state_;
+    juce::WeakReference<inner_plugin_loader> owner_;
+};
+
+
+inner_plugin_loader::inner_plugin_loader(plugin_registry& registry) : registry_(registry) {}
+
+inner_plugin_loader::~inner_plugin_loader() {
+    cancel_all();
+
+    if(threads_ == nullptr) {
+        return;
+    }
+
+    // only ours, the threads are shared with every other wrapper's loader. The weak references in the jobs still point at us until the members are gone
+    struct own_jobs final : juce::ThreadPool::JobSelector {
+        explicit own_jobs(const inner_plugin_loader& l) : loader(l) {}
+
+        bool isJobSuitable(juce::ThreadPoolJob* job) override {
+            auto* prepare = dynamic_cast<prepare_job*>(job);
+            return prepare != nullptr && prepare->is_owned_by(loader);
+        }
+
+        const inner_plugin_loader& loader;
+    } selector (*this);
+
+    threads_->removeAllJobs(true, 10000, &selector); // jobs don't check shouldExit() in the middle of a plugin call, so this can take a moment
+}
+
+void inner_plugin_loader::add_job_(prepare_job* job) {
+    if(threads_ == nullptr) {
+        threads_ = &registry_.get_loader_threads();
+    }
+
+    threads_->addJob(job, true);
+}
+
+void inner_plugin_loader::load(int key, request req, completion_callback on_finished) {
+    cancel(key);
+
+    auto state = std::make_shared<job_state>();
+    state->req = std::move(req);
+    state->on_finished = std::move(on_finished);
+    state->resident_before = get_resident_bytes();
+    pending_[key] = state;
+
+    if(state->req.sandboxed) {
+        state->set_stage(stage::instantiating, 0.1f);
+        add_job_(new prepare_job(key, state, juce::WeakReference<inner_plugin_loader>(this))); // makes the instance itself
+        return;
+    }
+
+    // juce wants plugins to be instantiated on the message thread, so this part can't go to the pool
+    registry_.get_format_manager().createPluginInstanceAsync(state->req.description, state->req.sample_rate, state->req.block_size,
+                                              [this, key, state, owner = juce::WeakReference<inner_plugin_loader>(this)] (std::unique_ptr<juce::AudioPluginInstance> instance, const juce::String& error) {
+                                                  if(owner.get() == nullptr || state->cancelled) {
+                                                      return; // instance gets destroyed right here on the message thread
+                                                  }
+
+                                                  if(error.isNotEmpty() || instance == nullptr) {
+                                                      state->res.error = error.isNotEmpty() ? error : juce::String("the plugin couldn't be instantiated");
+                                                      finish_(key, state);
+                                                      return;
+                                                  }
+
+                                                  state->res.instance = std::move(instance);
+                                                  state->set_stage(stage::restoring_state, 0.2f);
+                                                  add_job_(new prepare_job(key, state, owner));
+                                              });
+}
+
+void inner_plugin_loader::cancel(int key) {
+    const auto it = pending_.find(key);
+
+    if(it != pending_.end()) {
+        it->second->cancelled = true; // if the job is still running, the instance comes back through finish_, which destroys it
+        pending_.erase(it);
+    }
+}
+
+void inner_plugin_loader::cancel_all() {
+    for(auto& [key, state] : pending_) {
+        state->cancelled = true;
+    }
+    pending_.clear();
+}
+
+void inner_plugin_loader::finish_(int key, std::shared_ptr<job_state> state) {
+    if(state->cancelled) {
+        state->res.instance.reset();
+        return;
+    }
+
+    const auto it = pending_.find(key);
+    if(it != pending_.end() && it->second == state) {
+        pending_.erase(it);
+    }
+
+    if(state->res.error.isNotEmpty()) {
+        state->res.instance.reset();
+    }
+
+    juce::NullCheckedInvocation::invoke(state->on_finished, std::move(state->res));
+}
+
+const inner_plugin_loader::job_state* inner_plugin_loader::find_(int key) const {
+    const auto it = pending_.find(key);
+    return it != pending_.end() ? it->second.get() : nullptr;
+}
+
+bool inner_plugin_loader::is_loading(int key) const {
+    return find_(key) != nullptr;
+}
+
+bool inner_plugin_loader::is_loading_anything() const noexcept {
+    return ! pending_.empty();
+}
+
+float inner_plugin_loader::get_progress(int key) const {
+    const auto* state = find_(key);
+    return state != nullptr ? state->progress.load() : 0.f;
+}
+
+inner_plugin_loader::stage inner_plugin_loader::get_stage(int key) const {
+    const auto* state = find_(key);
+    return state != nullptr ? state->current_stage.load() : stage::idle;
+}
+
+juce::String inner_plugin_loader::get_stage_description(int key) const {
+    return get_stage_description(get_stage(key));
+}
+
+juce::String inner_plugin_loader::get_stage_description(stage s) {
+    switch(s) {
+        case stage::idle:            return "Idle";
+        case stage::instantiating:   return "Loading plugin...";
+        case stage::restoring_state: return "Restoring state...";
+        case stage::applying_layout: return "Applying bus layout...";
+        case stage::preparing:       return "Preparing to play...";
+        case stage::finishing:       return "Finishing...";
+    }
+
+    return {};
+}
+
+std::uint64_t inner_plugin_loader::hash_state(const juce::MemoryBlock& state) noexcept {
+    if(state.isEmpty()) {
+        return 0;
+    }
+
+    const auto hash = (std::uint64_t) std::hash<std::string_view>()(std::string_view(static_cast<const char*>(state.getData()), state.getSize()));
+    return hash != 0 ? hash : 1;
+}
+
+std::size_t inner_plugin_loader::get_resident_bytes() noexcept {
+   #if JUCE_LINUX || JUCE_BSD
+    // the second field is the resident set, in pages
+    long size = 0, resident = 0;
+
+    if(auto* statm = std::fopen("/proc/self/statm", "r")) {
+        if(std::fscanf(statm, "%ld %ld", &size, &resident) != 2) {
+            resident = 0;
+        }
+        std::fclose(statm);
+    }
+
+    return (std::size_t) juce::jmax(0L, resident) * (std::size_t) sysconf(_SC_PAGESIZE);
+   #elif JUCE_MAC
+    mach_task_basic_info info {};
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    return task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) == KERN_SUCCESS ? (std::size_t) info.resident_size : 0;
+   #else
+    return 0;
+   #endif
+}
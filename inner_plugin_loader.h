@@ -0,0 +1,101 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+
+#include "channel_adapter.h"
+#include "plugin_registry.h"
+
+/**
+ * builds inner plugin instances without stalling the message thread
+ *
+ * the only part that stays on the message thread is the instantiation itself (createPluginInstanceAsync),
+ * because juce (and the plugin formats) want plugins to be created there. Sandboxed plugins are created in their own process, so those don't even need that
+ * restoring the state, applying the bus layout and prepareToPlay all happen on a loader thread,
+ * and the finished instance is handed back to the message thread so it can be published to the audio thread
+ *
+ * loads are keyed (the processor uses the slot index as the key). There's at most one pending load per key,
+ * starting a new one supersedes (cancels) the previous one with the same key. Loads with different keys run side by side
+ * the loader threads are the registry's, shared with every other wrapper's loader (see plugin_registry::get_loader_threads)
+ * everything here (including the progress getters, which the editor polls with a timer) is meant to be called from the message thread
+ */
+class inner_plugin_loader {
+public:
+    struct request {
+        juce::PluginDescription description;
+        juce::MemoryBlock state;                          // restored with setStateInformation if it isn't empty
+        juce::AudioProcessor::BusesLayout layout;         // the wrapper's. The plugin gets the closest layout it supports (see channel_adapter)
+        double sample_rate = 44100.0;
+        int block_size = 512;
+        bool prepare = false;                             // call prepareToPlay on the loader thread
+        bool double_precision = false;                    // the precision the wrapper runs at. The plugin only gets double if it supports it (see inner_plugin_slot::prepare_instance)
+        int oversampling_factor = 1;                      // 1, 2, 4 or 8. The plugin gets prepared at this many times the sample rate and block size
+        int sub_block_size = 0;                           // 0, or the fixed block size the plugin gets called with (see sub_block_fifo)
+        bool sandboxed = false;                           // run the plugin in its own process (see sandboxed_plugin_instance). Then the instance is made on the loader thread too
+        bool hash_state = false;                          // fill in result.state_hash, for the instance_pool
+    };
+
+    struct result {
+        std::unique_ptr<juce::AudioPluginInstance> instance; // null if the load failed or was cancelled
+        channel_adapter adapter;                             // how the instance's layout maps onto request.layout. Goes into the slot with it
+        juce::String error;
+        bool prepared = false;
+        bool double_precision = false;
+        double sample_rate = 0.0;
+        int block_size = 0;
+        std::uint64_t state_hash = 0;                        // hash_state of the instance's own state once it's loaded, if request.hash_state
+        std::size_t footprint_bytes = 0;                     // how much the process grew while the instance was built. Only an estimate, loads running side by side inflate each other's
+    };
+
+    enum class stage { idle, instantiating, restoring_state, applying_layout, preparing, finishing };
+
+    /// called on the message thread. Not called at all if the load gets cancelled
+    using completion_callback = std::function<void(result&&)>;
+
+    explicit inner_plugin_loader(plugin_registry& registry);
+
+    /// cancels whatever is pending and waits for the loader threads to finish with this loader's jobs. Other loaders' jobs keep going
+    ~inner_plugin_loader();
+
+    void load(int key, request req, completion_callback on_finished);
+
+    /// the partially built instance (if there is one) is destroyed on the message thread
+    void cancel(int key);
+    void cancel_all();
+
+    bool is_loading(int key) const;
+    bool is_loading_anything() const noexcept;
+    float get_progress(int key) const;
+    stage get_stage(int key) const;
+    juce::String get_stage_description(int key) const;
+
+    static juce::String get_stage_description(stage s);
+
+    /// any thread. 0 for an empty state, so a plugin that gets loaded without a state can be looked up by that
+    static std::uint64_t hash_state(const juce::MemoryBlock& state) noexcept;
+
+    /// any thread. The resident size of the whole process, 0 where we don't know how to ask
+    static std::size_t get_resident_bytes() noexcept;
+
+private:
+    struct job_state;
+    class prepare_job;
+
+    void finish_(int key, std::shared_ptr<job_state> state);
+    const job_state* find_(int key) const;
+
+    /// message thread. Starts the registry's loader threads if nobody has yet
+    void add_job_(prepare_job* job);
+
+    plugin_registry& registry_;
+    juce::ThreadPool* threads_ = nullptr; // the registry's, once this loader has given it a job
+
+    std::map<int, std::shared_ptr<job_state>> pending_;
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(inner_plugin_loader)
+    JUCE_DECLARE_NON_COPYABLE(inner_plugin_loader)
+};
@@ -0,0 +1,332 @@
+#include "inner_plugin_slot.h"
+
+#include <cmath>
+
+#include "simd_kernels.h"
+
+inner_plugin_slot::inner_plugin_slot(epoch_reclaimer& reclaimer, std::size_t first_pin_index) : reclaimer_(reclaimer),
+                                                                                                first_pin_index_(first_pin_index) {}
+
+void inner_plugin_slot::publish(std::unique_ptr<juce::AudioPluginInstance> instance, channel_adapter adapter) {
+    std::unique_ptr<hosted_plugin> incoming;
+
+    if(instance != nullptr) {
+        incoming.reset(new hosted_plugin { std::move(instance), std::move(adapter) });
+
+        if(prepared_) {
+            incoming->adapter.prepare(*incoming->instance, block_size_, double_precision_); // the audio thread can't see it yet, so allocating is fine
+        }
+    }
+
+    auto retired = std::move(hosted_);
+    hosted_ = std::move(incoming);
+
+    published_.store(hosted_.get()); // seq_cst, this has to be ordered before the epoch bump in retire() (see epoch_reclaimer.h)
+
+    if(recycler_ != nullptr) {
+        reclaimer_.retire<hosted_plugin>(std::move(retired), [recycle = recycler_] (std::unique_ptr<hosted_plugin> h) {
+            recycle(std::move(h->instance), std::move(h->adapter));
+        });
+    }
+    else {
+        reclaimer_.retire(std::move(retired));
+    }
+}
+
+void inner_plugin_slot::set_midi_settings(const midi_stage::settings& settings) {
+    if(settings == midi_settings_) {
+        return;
+    }
+
+    midi_settings_ = settings;
+
+    auto retired = std::move(midi_stage_);
+    midi_stage_ = settings.is_identity() ? nullptr : std::make_unique<midi_stage>(settings);
+
+    published_midi_stage_.store(midi_stage_.get()); // seq_cst, same as publish()
+    midi_settings_generation_.fetch_add(1);
+
+    reclaimer_.retire(std::move(retired));
+}
+
+void inner_plugin_slot::prepare_instance(juce::AudioPluginInstance& instance, double sample_rate, int block_size, bool double_precision, const channel_adapter& adapter) {
+    const int oversampling_factor = adapter.get_oversampling_factor();
+    const int inner_block_size = adapter.get_inner_block_size(block_size);
+    const bool use_double = double_precision && oversampling_factor == 1 && instance.supportsDoublePrecisionProcessing(); // the oversampling filters only do float
+
+    instance.setProcessingPrecision(use_double ? juce::AudioProcessor::doublePrecision : juce::AudioProcessor::singlePrecision); // has to happen before prepareToPlay
+    instance.setRateAndBufferSizeDetails(sample_rate * oversampling_factor, inner_block_size);
+    instance.prepareToPlay(sample_rate * oversampling_factor, inner_block_size);
+}
+
+void inner_plugin_slot::prepare(double sample_rate, int block_size, const juce::AudioProcessor::BusesLayout& layout, bool double_precision) {
+    // the whole buffer, aux buses included, so the aux outputs get crossfaded along with the main ones
+    const auto count_channels = [] (const juce::Array<juce::AudioChannelSet>& buses) {
+        int number_of_channels = 0;
+
+        for(const auto& bus : buses) {
+            number_of_channels += bus.size();
+        }
+
+        return number_of_channels;
+    };
+
+    const int number_of_channels = juce::jmax(count_channels(layout.inputBuses), count_channels(layout.outputBuses));
+
+    if(hosted_ != nullptr) {
+        auto& instance = *hosted_->instance;
+
+        if(hosted_->adapter.get_outer_layout() != layout) {
+            // the host changed our layout since the plugin was loaded. If the plugin can't follow, it keeps the adapter it had, which only ever routes the channels that exist
+            juce::String error;
+            channel_adapter renegotiated;
+            renegotiated.set_oversampling_factor(hosted_->adapter.get_oversampling_factor());
+            renegotiated.set_sub_block_size(hosted_->adapter.get_sub_block_size());
+
+            if(renegotiated.negotiate(instance, layout, error)) {
+                hosted_->adapter = std::move(renegotiated);
+            }
+        }
+
+        prepare_instance(instance, sample_rate, block_size, double_precision, hosted_->adapter);
+        hosted_->adapter.prepare(instance, block_size, double_precision);
+    }
+
+    prepared_ = true;
+    block_size_ = block_size;
+    sample_rate_ = sample_rate;
+    stats_.prepare(sample_rate);
+    double_precision_ = double_precision;
+
+    // everything the crossfade needs is allocated here so that process never has to
+    crossfade_scratch_       .setSize(double_precision ? 0 : number_of_channels, double_precision ? 0 : block_size, false, true, false);
+    crossfade_scratch_double_.setSize(double_precision ? number_of_channels : 0, double_precision ? block_size : 0, false, true, false);
+    crossfade_midi_scratch_.ensureSize(midi_scratch_bytes_);
+    midi_stage_scratch_.ensureSize(midi_scratch_bytes_);
+
+    audio_thread_instance_ = hosted_.get(); // no fade in when playback starts
+    fading_out_instance_ = nullptr;
+    crossfade_position_ = crossfade_length_ = 0;
+    stay_awake_();
+    held_notes_.reset();
+    midi_settings_seen_ = midi_settings_generation_.load();
+
+    // processBlock isn't running, so we can just overwrite whatever the pins were
+    pinned_[0] = audio_thread_instance_;
+    pinned_[1] = nullptr;
+    reclaimer_.reader_pin(first_pin_index_,     pinned_[0]);
+    reclaimer_.reader_pin(first_pin_index_ + 1, pinned_[1]);
+}
+
+void inner_plugin_slot::release() {
+    prepared_ = false;
+
+    if(hosted_ != nullptr) {
+        hosted_->instance->releaseResources();
+    }
+}
+
+void inner_plugin_slot::reset() {
+    if(hosted_ != nullptr) {
+        hosted_->instance->reset();
+        hosted_->adapter.reset();
+    }
+
+    stay_awake_();
+    held_notes_.reset(); // the plugin has just let go of everything
+}
+
+bool inner_plugin_slot::process(juce::AudioBuffer<float>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<float>& sidechain, int crossfade_length) {
+    return process_(audio_buffer, midi_buffer, sidechain, crossfade_length);
+}
+
+bool inner_plugin_slot::process(juce::AudioBuffer<double>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<double>& sidechain, int crossfade_length) {
+    return process_(audio_buffer, midi_buffer, sidechain, crossfade_length);
+}
+
+template<typename sample_t>
+bool inner_plugin_slot::process_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain, int crossfade_length) {
+    auto* instance = published_.load();
+    const int number_of_channels = audio_buffer.getNumChannels();
+    const int number_of_samples = audio_buffer.getNumSamples();
+
+    auto& crossfade_scratch = [this] () -> auto& {
+        if constexpr (std::is_same_v<sample_t, float>) return crossfade_scratch_;
+        else                                           return crossfade_scratch_double_;
+    }();
+
+    if(is_bypassed()) {
+        skip(); // forget about any fade, and don't keep an old instance pinned for however long the bypass lasts
+        return false;
+    }
+
+    const auto started = process_stats::start();
+
+    // before the crossfade copies the midi, so both plugins get the same events
+    // a generation read before the stage means the worst a change in between does is release notes one block later than it could have
+    const auto midi_settings_generation = midi_settings_generation_.load();
+
+    if(auto* stage = published_midi_stage_.load()) {
+        stage->process(midi_buffer, midi_stage_scratch_);
+    }
+
+    if(midi_settings_generation != midi_settings_seen_) {
+        midi_settings_seen_ = midi_settings_generation;
+        held_notes_.release_all(midi_buffer, midi_stage_scratch_); // the new stage would map their note offs somewhere else, or not at all
+    }
+
+    held_notes_.track(midi_buffer);
+
+    if(instance != audio_thread_instance_) {
+        begin_crossfade_(number_of_samples <= crossfade_scratch.getNumSamples() && number_of_channels <= crossfade_scratch.getNumChannels(), crossfade_length);
+        audio_thread_instance_ = instance;
+        stats_.count_swap();
+        stay_awake_(); // a new plugin starts out awake, whatever the old one was doing
+    }
+
+    const bool overlapping = crossfade_length_ > 0;
+
+    if(overlapping) {
+        // the outgoing plugin gets its own copy of the input, the incoming one works in place on the host's buffer
+        for(int channel = 0; channel < number_of_channels; ++channel) {
+            crossfade_scratch.copyFrom(channel, 0, audio_buffer, channel, 0, number_of_samples);
+        }
+
+        crossfade_midi_scratch_.clear();
+        crossfade_midi_scratch_.addEvents(midi_buffer, 0, number_of_samples, 0);
+
+        juce::AudioBuffer<sample_t> outgoing_audio(crossfade_scratch.getArrayOfWritePointers(), number_of_channels, number_of_samples); // refers to the scratch memory, no allocation
+
+        if(instance != nullptr) {
+            instance->adapter.process(*instance->instance, audio_buffer, midi_buffer, sidechain); // a null plugin on either side just means the dry signal
+        }
+
+        if(fading_out_instance_ != nullptr) {
+            fading_out_instance_->adapter.process(*fading_out_instance_->instance, outgoing_audio, crossfade_midi_scratch_, sidechain); // its midi output is dropped, only the incoming plugin's goes to the host
+        }
+
+        const int fade_samples = juce::jmin(number_of_samples, crossfade_length_ - crossfade_position_);
+        const float increment = 1.f / (float) crossfade_length_;
+
+        for(int channel = 0; channel < number_of_channels; ++channel) {
+            simd_kernels::equal_power_crossfade(audio_buffer.getWritePointer(channel),
+                                                outgoing_audio.getReadPointer(channel),
+                                                fade_samples,
+                                                (float) crossfade_position_ * increment,
+                                                increment);
+        }
+
+        crossfade_position_ += fade_samples;
+
+        if(crossfade_position_ >= crossfade_length_) {
+            fading_out_instance_ = nullptr;
+            crossfade_position_ = crossfade_length_ = 0;
+        }
+    }
+    else if(instance != nullptr) {
+        // sleeping, see set_silence_threshold. Never during a crossfade, both plugins run for those
+        const float threshold = silence_threshold_.load(std::memory_order_relaxed);
+        const bool quiet_input = threshold > 0.f && ! wake_requested_.exchange(false, std::memory_order_relaxed)
+                              && midi_buffer.isEmpty() && instance->adapter.is_input_silent(audio_buffer, sidechain, threshold);
+
+        if(asleep_ && quiet_input) {
+            instance->adapter.silence(audio_buffer);
+            stats_.record_sleep(started);
+            pin_();
+            return false;
+        }
+
+        asleep_ = false;
+        instance->adapter.process(*instance->instance, audio_buffer, midi_buffer, sidechain);
+
+        // a plugin that sends midi isn't done, even if it's silent (an arpeggiator between notes)
+        if(quiet_input && midi_buffer.isEmpty() && instance->adapter.is_output_silent(audio_buffer, threshold)) {
+            silent_samples_ += number_of_samples;
+            asleep_ = silent_samples_ >= sleep_after_samples_.load(std::memory_order_relaxed);
+        }
+        else {
+            silent_samples_ = 0;
+        }
+    }
+
+    if(overlapping || instance != nullptr) {
+        stats_.record(started, number_of_samples); // an empty slot doesn't cost anything worth knowing about
+    }
+
+    pin_();
+
+    return overlapping;
+}
+
+void inner_plugin_slot::refresh_latency_and_tail() {
+    int latency = 0;
+    double tail = 0.0;
+
+    if(hosted_ != nullptr) {
+        // an oversampled plugin reports its latency at its own rate. Rounded up, a sample too late is better than one too early
+        const int factor = hosted_->adapter.get_oversampling_factor();
+        latency = (juce::jmax(0, hosted_->instance->getLatencySamples()) + factor - 1) / factor + hosted_->adapter.get_latency_samples();
+        tail = juce::jmax(0.0, hosted_->instance->getTailLengthSeconds());
+    }
+
+    latency_samples_.store(latency, std::memory_order_relaxed);
+    tail_seconds_.store(tail, std::memory_order_relaxed);
+
+    // an infinite tail (or one we can't count in samples) never sleeps
+    const double sleep_after = (double) latency + juce::jmax(tail, minimum_sleep_seconds) * sample_rate_;
+    const bool can_sleep = sample_rate_ > 0.0 && sleep_after < 1.0e15;
+
+    sleep_after_samples_.store(can_sleep ? (std::int64_t) std::ceil(sleep_after) : std::numeric_limits<std::int64_t>::max(), std::memory_order_relaxed);
+}
+
+int inner_plugin_slot::get_latency_samples() const noexcept {
+    return is_bypassed() ? 0 : latency_samples_.load(std::memory_order_relaxed);
+}
+
+double inner_plugin_slot::get_tail_seconds() const noexcept {
+    return is_bypassed() ? 0.0 : tail_seconds_.load(std::memory_order_relaxed);
+}
+
+bool inner_plugin_slot::has_work() const noexcept {
+    if(is_bypassed()) {
+        return false;
+    }
+
+    return published_.load() != nullptr || audio_thread_instance_ != nullptr || crossfade_length_ > 0;
+}
+
+void inner_plugin_slot::skip() noexcept {
+    audio_thread_instance_ = published_.load();
+    fading_out_instance_ = nullptr;
+    crossfade_position_ = crossfade_length_ = 0;
+    stay_awake_();
+    pin_();
+}
+
+void inner_plugin_slot::begin_crossfade_(bool scratch_fits, int length) {
+    if(length <= 0 || ! scratch_fits) {
+        // hard switch, which is what you get when crossfading is off, or if the host hands us a bigger buffer than it promised in prepareToPlay
+        fading_out_instance_ = nullptr;
+        crossfade_position_ = crossfade_length_ = 0;
+        return;
+    }
+
+    // if we're already in the middle of a fade, the plugin that was fading out gets dropped and the one that was fading in starts fading out
+    fading_out_instance_ = audio_thread_instance_;
+    crossfade_position_ = 0;
+    crossfade_length_ = length;
+}
+
+void inner_plugin_slot::pin_() noexcept {
+    // pin everything we might still need next block, in case it gets retired in the meantime (see epoch_reclaimer.h)
+    // the pins are seq_cst stores, so they're only written when they actually change. Most blocks don't change anything
+    if(pinned_[0] != audio_thread_instance_) {
+        pinned_[0] = audio_thread_instance_;
+        reclaimer_.reader_pin(first_pin_index_, audio_thread_instance_);
+    }
+
+    if(pinned_[1] != fading_out_instance_) {
+        pinned_[1] = fading_out_instance_;
+        reclaimer_.reader_pin(first_pin_index_ + 1, fading_out_instance_);
+    }
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <cstdint>
+#include <limits>
+
+#include "channel_adapter.h"
+#include "epoch_reclaimer.h"
+#include "midi_stage.h"
+#include "process_stats.h"
+
+/**
+ * one position in the wrapper's serial plugin chain
+ *
+ * this is the stuff that used to live directly in HostAudioProcessor when it could only host one plugin:
+ * the message thread owns the instance, the audio thread only ever sees the published pointer, and replaced instances go through the (shared) epoch_reclaimer
+ * every slot can be swapped independently, and can crossfade between its old and new instance (see HostAudioProcessor::set_swap_crossfade_ms)
+ *
+ * slots process in place on whatever buffer they're given. The only copy is the one the outgoing plugin gets while a crossfade is running
+ * a bypassed slot doesn't touch the buffer at all
+ *
+ * every instance comes with the channel_adapter the loader negotiated for it, which takes care of plugins that don't support the wrapper's layout,
+ * and of float-only plugins while the wrapper runs in double precision. A plugin that needs neither gets the host's buffer as it is
+ * the slot's midi_stage (if it does anything) rewrites the block's midi before the plugin sees it
+ * every block the slot processes gets timed into its process_stats, adapter and crossfade included, because that's what the block actually costs
+ * a plugin that has gone silent can be put to sleep, see set_silence_threshold
+ */
+class inner_plugin_slot {
+public:
+    /// pins [first_pin_index, first_pin_index + pins_per_slot) of reclaimer are reserved for this slot
+    static constexpr std::size_t pins_per_slot = 2;
+
+    inner_plugin_slot(epoch_reclaimer& reclaimer, std::size_t first_pin_index);
+
+    inner_plugin_slot(const inner_plugin_slot&) = delete;
+    inner_plugin_slot& operator=(const inner_plugin_slot&) = delete;
+
+    // message thread --------------------------------------------------------------------------------------------------
+    inline juce::AudioPluginInstance* get_instance() const noexcept { return hosted_ != nullptr ? hosted_->instance.get() : nullptr; }
+
+    /// makes instance the one the audio thread uses and retires the old one. Can be null
+    /// adapter is what channel_adapter::negotiate made for instance. If the slot is prepared, the adapter gets prepared here, before the audio thread can see it
+    void publish(std::unique_ptr<juce::AudioPluginInstance> instance, channel_adapter adapter = {});
+
+    /// where replaced instances go once the audio thread is done with them (see instance_pool), instead of being destroyed. Called from epoch_reclaimer::collect
+    /// only affects instances published after this is set
+    using recycler = std::function<void(std::unique_ptr<juce::AudioPluginInstance>, channel_adapter)>;
+    inline void set_recycler(recycler r) { recycler_ = std::move(r); }
+
+    inline void set_bypassed(bool should_be_bypassed) noexcept { bypassed_.store(should_be_bypassed, std::memory_order_relaxed); }
+    inline bool is_bypassed() const noexcept { return bypassed_.load(std::memory_order_relaxed); }
+
+    /// compiles settings into a midi_stage and publishes it, the old one is retired like an instance. Settings that don't change anything publish nothing at all
+    void set_midi_settings(const midi_stage::settings& settings);
+    inline const midi_stage::settings& get_midi_settings() const noexcept { return midi_settings_; }
+
+    /// which parallel branch of the graph this slot belongs to. Slots in the same branch run in series, in slot order
+    inline void set_branch(int branch) noexcept { branch_.store(branch, std::memory_order_relaxed); }
+    inline int get_branch() const noexcept { return branch_.load(std::memory_order_relaxed); }
+
+    /// any thread
+    inline process_stats& get_stats() noexcept { return stats_; }
+    inline const process_stats& get_stats() const noexcept { return stats_; }
+
+    /// asks the plugin for its latency and tail again, for the two getters below and for how long it has to be silent before it can sleep
+    /// whenever something changed (a new plugin, the plugin said so, the slot got prepared), not for every block
+    void refresh_latency_and_tail();
+
+    /// what the slot adds to the signal's delay, at the wrapper's rate: the plugin's own latency, the sub-block fifo and the oversampling filters, and nothing if the slot is bypassed
+    /// as of the last refresh_latency_and_tail()
+    int get_latency_samples() const noexcept;
+
+    /// the plugin's tail, 0 if the slot is bypassed or empty. Can be infinite. Same as above
+    double get_tail_seconds() const noexcept;
+
+    /// any thread. The peak level (as a gain) at or below which the plugin counts as silent, 0 turns sleeping off (the default)
+    /// once the plugin's input (audio and midi) and output have been silent for longer than its tail and latency (but never less than minimum_sleep_seconds),
+    /// it isn't called anymore and its outputs are silent, until midi or input above the threshold comes in again
+    /// it wakes up for the whole block that happens in, so it sees it at exactly the sample it would have anyway
+    static constexpr double minimum_sleep_seconds = 1.0; // plenty of plugins report a tail of 0 whatever they actually do, delays especially
+    inline void set_silence_threshold(float gain) noexcept { silence_threshold_.store(gain, std::memory_order_relaxed); }
+
+    /// any thread. Wakes the plugin for the next block, e.g. because one of its parameters changed
+    inline void wake() noexcept { wake_requested_.store(true, std::memory_order_relaxed); }
+
+    /// tells instance which precision it's going to process in (double only if the wrapper runs in double, the plugin supports it and it isn't oversampled) and prepares it,
+    /// at the rate and block size adapter is going to call it with (oversampled, and in sub-blocks if those are on)
+    /// whatever prepares an instance that's going into a slot has to go through this, otherwise the adapter converts for a plugin that didn't need it (or the other way round)
+    static void prepare_instance(juce::AudioPluginInstance& instance, double sample_rate, int block_size, bool double_precision, const channel_adapter& adapter);
+
+    // prepareToPlay/releaseResources/reset, i.e. whenever processBlock can't be running --------------------------------
+    /// if the wrapper's layout changed since the instance was loaded, its layout gets negotiated again here
+    void prepare(double sample_rate, int block_size, const juce::AudioProcessor::BusesLayout& layout, bool double_precision);
+    void release();
+    void reset();
+
+    // audio thread ----------------------------------------------------------------------------------------------------
+    /// returns true if this block overlapped an old and a new instance
+    /// sidechain is what the wrapper's aux inputs got this block, see channel_adapter::process. Every slot gets the same one
+    bool process(juce::AudioBuffer<float>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<float>& sidechain, int crossfade_length);
+    bool process(juce::AudioBuffer<double>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<double>& sidechain, int crossfade_length);
+
+    /// false if process() wouldn't touch the buffer at all this block (nothing loaded and nothing fading out, or bypassed)
+    bool has_work() const noexcept;
+
+    /// instead of process() for a slot whose branch isn't running this block. Catches up with the published instance without processing anything
+    void skip() noexcept;
+
+private:
+    /// what gets published and retired. The adapter's buffers belong to the instance, so an incoming and an outgoing plugin never share them
+    struct hosted_plugin {
+        std::unique_ptr<juce::AudioPluginInstance> instance;
+        channel_adapter adapter;
+    };
+
+    template<typename sample_t>
+    bool process_(juce::AudioBuffer<sample_t>& audio_buffer, juce::MidiBuffer& midi_buffer, juce::AudioBuffer<sample_t>& sidechain, int crossfade_length);
+
+    void begin_crossfade_(bool scratch_fits, int length);
+    void pin_() noexcept;
+
+    inline void stay_awake_() noexcept { asleep_ = false; silent_samples_ = 0; }
+
+    epoch_reclaimer& reclaimer_;
+    std::size_t first_pin_index_;
+
+    std::unique_ptr<hosted_plugin> hosted_;                            // message thread
+    recycler recycler_;                                                // message thread
+    std::atomic<hosted_plugin*> published_ = nullptr;                  // what the audio thread loads
+    std::atomic<bool> bypassed_ = false;
+    std::atomic<int> branch_ = 0;
+
+    midi_stage::settings midi_settings_;                               // message thread
+    std::unique_ptr<midi_stage> midi_stage_;                           // message thread, null if midi_settings_ don't do anything
+    std::atomic<const midi_stage*> published_midi_stage_ = nullptr;    // only used within a block, so it doesn't need a pin
+    std::atomic<std::uint32_t> midi_settings_generation_ = 0;          // bumped with every new stage. The stage pointer can't tell, a new one can reuse a retired one's address
+
+    // what refresh_latency_and_tail() found out
+    std::atomic<int> latency_samples_ = 0;
+    std::atomic<double> tail_seconds_ = 0.0;
+    std::atomic<std::int64_t> sleep_after_samples_ = std::numeric_limits<std::int64_t>::max();
+
+    std::atomic<float> silence_threshold_ = 0.f;
+    std::atomic<bool> wake_requested_ = false;
+
+    // audio thread
+    hosted_plugin* audio_thread_instance_ = nullptr; // the instance the previous block used
+    hosted_plugin* fading_out_instance_ = nullptr;   // only meaningful while crossfade_length_ > 0. nullptr here means fading out of the dry signal
+    int crossfade_position_ = 0, crossfade_length_ = 0;
+    const hosted_plugin* pinned_[pins_per_slot] = {nullptr, nullptr}; // what we last told the reclaimer
+    std::uint32_t midi_settings_seen_ = 0;    // the midi_settings_generation_ held_notes_ were tracked with
+    midi_stage::note_tracker held_notes_;     // what the plugin got from the stage, for releasing it when the settings change
+    bool asleep_ = false;
+    std::int64_t silent_samples_ = 0; // how long the plugin's input and output have been silent for
+
+    // what prepare was last called with, for instances that get published while we're prepared
+    bool prepared_ = false, double_precision_ = false;
+    int block_size_ = 0;
+    double sample_rate_ = 0.0;
+
+    static constexpr std::size_t midi_scratch_bytes_ = 16384;
+
+    // sized in prepare, only the precision we're going to get gets memory
+    juce::AudioBuffer<float> crossfade_scratch_;
+    juce::AudioBuffer<double> crossfade_scratch_double_;
+    juce::MidiBuffer crossfade_midi_scratch_;
+    juce::MidiBuffer midi_stage_scratch_;
+
+    process_stats stats_;
+};
@@ -0,0 +1,154 @@
+#include "instance_pool.h"
+
+#include <algorithm>
+
+instance_pool::~instance_pool() {
+    clear();
+}
+
+void instance_pool::set_budget_bytes(std::size_t bytes) {
+    budget_bytes_ = bytes;
+    evict_();
+}
+
+void instance_pool::set_pinned(const juce::String& plugin_id, bool should_be_pinned) {
+    if(should_be_pinned) {
+        pinned_.insert(plugin_id);
+    }
+    else {
+        pinned_.erase(plugin_id);
+        evict_(); // it might have been the only thing keeping us over the budget
+    }
+}
+
+bool instance_pool::is_pinned(const juce::String& plugin_id) const {
+    return pinned_.count(plugin_id) > 0;
+}
+
+void instance_pool::track(const juce::AudioPluginInstance& instance, origin o) {
+    tracked_[&instance] = std::move(o);
+}
+
+void instance_pool::recycle(std::unique_ptr<juce::AudioPluginInstance> instance, channel_adapter adapter, bool prepared) {
+    if(instance == nullptr) {
+        return;
+    }
+
+    const auto it = tracked_.find(instance.get());
+
+    if(it == tracked_.end()) {
+        return; // not ours, it's destroyed right here
+    }
+
+    auto from = std::move(it->second);
+    tracked_.erase(it);
+
+    if(! might_keep(from.plugin_id)) {
+        return;
+    }
+
+    juce::MemoryBlock state;
+    instance->getStateInformation(state); // the audio thread is done with it, so nothing else is touching it
+
+    entry e;
+    e.state_hash = inner_plugin_loader::hash_state(state);
+    e.loaded.instance = std::move(instance);
+    e.loaded.adapter = std::move(adapter);
+    e.loaded.prepared = prepared && e.loaded.adapter.get_prepared_block_size() > 0; // the adapter is prepared right after the plugin, with the wrapper's block size and precision
+    e.loaded.double_precision = e.loaded.adapter.is_prepared_for_double();
+    e.loaded.sample_rate = e.loaded.instance->getSampleRate() / e.loaded.adapter.get_oversampling_factor(); // the wrapper's rate, not the plugin's
+    e.loaded.block_size = e.loaded.adapter.get_prepared_block_size();
+    from.footprint_bytes = juce::jmax(from.footprint_bytes, minimum_footprint_bytes);
+    e.from = std::move(from);
+
+    bytes_ += e.from.footprint_bytes;
+    entries_.push_front(std::move(e));
+
+    evict_();
+}
+
+std::optional<inner_plugin_loader::result> instance_pool::take(const inner_plugin_loader::request& req, std::uint64_t state_hash) {
+    const auto plugin_id = req.description.createIdentifierString();
+
+    const auto matches = [&] (const entry& e) {
+        const auto& adapter = e.loaded.adapter;
+
+        return e.from.plugin_id == plugin_id
+            && e.from.sandboxed == req.sandboxed
+            && adapter.get_oversampling_factor() == req.oversampling_factor
+            && adapter.get_sub_block_size() == req.sub_block_size
+            && adapter.get_outer_layout() == req.layout
+            && (e.state_hash == state_hash || (e.state_hash == e.from.loaded_state && e.from.loaded_from == state_hash));
+    };
+
+    const auto it = std::find_if(entries_.begin(), entries_.end(), matches);
+
+    if(it == entries_.end()) {
+        ++misses_;
+        return std::nullopt;
+    }
+
+    ++hits_;
+    bytes_ -= it->from.footprint_bytes;
+
+    auto loaded = std::move(it->loaded);
+    loaded.instance->reset(); // whatever was still ringing when it was swapped out
+    loaded.adapter.reset();
+
+    track(*loaded.instance, { plugin_id, state_hash, it->state_hash, req.sandboxed, it->from.footprint_bytes });
+    entries_.erase(it);
+
+    return loaded;
+}
+
+instance_pool::stats instance_pool::get_stats() const noexcept {
+    stats s;
+    s.hits = hits_;
+    s.misses = misses_;
+    s.evictions = evictions_;
+    s.entries = entries_.size();
+    s.bytes = bytes_;
+    s.budget_bytes = budget_bytes_;
+    return s;
+}
+
+void instance_pool::clear() {
+    entries_.clear();
+    bytes_ = 0;
+}
+
+void instance_pool::evict_() {
+    while(entries_.size() > maximum_entries || bytes_ > budget_bytes_) {
+        // the least recently used entry that isn't protected
+        auto victim = entries_.end();
+
+        for(auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if(! is_protected_(it)) {
+                victim = it;
+            }
+        }
+
+        if(victim == entries_.end()) {
+            return; // only pinned ones left
+        }
+
+        bytes_ -= victim->from.footprint_bytes;
+        entries_.erase(victim);
+        ++evictions_;
+    }
+}
+
+bool instance_pool::is_protected_(std::list<entry>::const_iterator it) const {
+    if(! is_pinned(it->from.plugin_id)) {
+        return false;
+    }
+
+    // only the newest entry of a pinned plugin, otherwise every state it was ever swapped out with would pile up
+    for(auto newer = entries_.cbegin(); newer != it; ++newer) {
+        if(newer->from.plugin_id == it->from.plugin_id) {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+
+#include "inner_plugin_loader.h"
+
+/**
+ * a warm standby pool of inner plugin instances that aren't in any slot right now, so switching back to one of them is a pointer publish instead of a load
+ *
+ * instances get here when a slot replaces (or clears) them: the slot recycles them through the epoch_reclaimer instead of destroying them,
+ * so by the time the pool sees an instance the audio thread is done with it. They stay instantiated, laid out and prepared, they're only reset when they're taken out again
+ *
+ * an entry matches a load if it's the same plugin, loaded the same way (sandboxed or not, same oversampling, sub-block size and layout), and its state is the one the load asks for:
+ * either its current state hashes to the requested one, or it hasn't changed since it was loaded and it was loaded from the requested state
+ * (that's how picking a plugin from the list, which asks for no state at all, finds an instance that was loaded the same way and never touched)
+ *
+ * entries are evicted least recently used first, as soon as there are more than maximum_entries or their footprints add up to more than the budget
+ * a footprint is what the process grew by while the instance was loaded (see inner_plugin_loader::result::footprint_bytes), but never less than minimum_footprint_bytes
+ * the newest entry of every pinned plugin isn't evicted, whatever the budget says. With a budget of 0 (the wrapper's default), pinned plugins are all the pool keeps
+ * keeping an instance costs asking it for its state and hashing that, which can take a while for big states, so plugins the pool isn't going to keep skip all that
+ *
+ * message thread only
+ */
+class instance_pool {
+public:
+    static constexpr std::size_t maximum_entries = 16;
+    static constexpr std::size_t minimum_footprint_bytes = 1 << 20; // for plugins we couldn't measure (sandboxed ones live in another process), and platforms we can't measure on
+
+    /// where an instance came from. Tracked from the moment it goes into a slot until it's recycled
+    struct origin {
+        juce::String plugin_id;         // PluginDescription::createIdentifierString
+        std::uint64_t loaded_from = 0;  // inner_plugin_loader::hash_state of the state it was loaded with
+        std::uint64_t loaded_state = 0; // and of its own state right after that
+        bool sandboxed = false;
+        std::size_t footprint_bytes = 0;
+    };
+
+    struct stats {
+        std::uint64_t hits = 0, misses = 0, evictions = 0;
+        std::size_t entries = 0, bytes = 0, budget_bytes = 0;
+    };
+
+    /// destroys every pooled instance
+    ~instance_pool();
+
+    void set_budget_bytes(std::size_t bytes);
+    inline std::size_t get_budget_bytes() const noexcept { return budget_bytes_; }
+
+    /// false if an instance of this plugin would be destroyed as soon as it's recycled (the budget is 0 and it isn't pinned)
+    /// then there's no point hashing states for it either
+    inline bool might_keep(const juce::String& plugin_id) const { return budget_bytes_ > 0 || is_pinned(plugin_id); }
+
+    void set_pinned(const juce::String& plugin_id, bool should_be_pinned);
+    bool is_pinned(const juce::String& plugin_id) const;
+    inline const std::set<juce::String>& get_pinned() const noexcept { return pinned_; }
+
+    /// remembers where instance came from, for when it's recycled
+    void track(const juce::AudioPluginInstance& instance, origin o);
+
+    /// the slot's recycler. Asks the instance for its state, which can take a moment for big ones, then keeps it if there's room
+    /// prepared is false if the instance might have been released since it was last prepared. Instances that were never tracked are destroyed
+    void recycle(std::unique_ptr<juce::AudioPluginInstance> instance, channel_adapter adapter, bool prepared);
+
+    /// the most recently used entry that matches req (see above), reset and tracked again, or nothing. Counts a hit or a miss either way
+    /// state_hash is hash_state(req.state), which the caller needs for track() anyway if this misses
+    /// the result is what the loader would have produced, prepared at whatever the entry was last prepared at
+    std::optional<inner_plugin_loader::result> take(const inner_plugin_loader::request& req, std::uint64_t state_hash);
+
+    stats get_stats() const noexcept;
+
+    /// destroys every entry, pinned ones included
+    void clear();
+
+private:
+    struct entry {
+        origin from;
+        std::uint64_t state_hash = 0; // when it was recycled
+        inner_plugin_loader::result loaded;
+    };
+
+    void evict_();
+    bool is_protected_(std::list<entry>::const_iterator it) const;
+
+    std::list<entry> entries_; // most recently used first
+    std::map<const juce::AudioPluginInstance*, origin> tracked_;
+    std::set<juce::String> pinned_;
+
+    std::size_t budget_bytes_ = 0, bytes_ = 0;
+    std::uint64_t hits_ = 0, misses_ = 0, evictions_ = 0;
+};
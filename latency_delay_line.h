@@ -0,0 +1,101 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <algorithm>
+
+/**
+ * delays the wrapper's output by however much the chain's latency is short of a constant one,
+ * so the latency the host compensates for doesn't change when a slot swaps to a plugin with a different latency (see HostAudioProcessor::set_constant_latency_ms)
+ * parallel branches use it too, to line up with the slowest branch before they're summed
+ *
+ * a ring buffer per channel. Every block goes in first and comes out delay samples later, so a delay of 0 gives the block back as it is
+ * when the delay changes, the block crossfades linearly from the old tap to the new one instead of jumping
+ * everything is allocated in prepare(). process() doesn't lock or allocate, so it can run on the audio thread
+ */
+template<typename sample_t>
+class latency_delay_line {
+public:
+    /// maximum_delay 0 turns it off (and frees the memory)
+    void prepare(int maximum_delay, int maximum_block_size, int number_of_channels) {
+        maximum_delay_ = maximum_delay;
+        capacity_ = maximum_delay > 0 ? maximum_delay + maximum_block_size : 0;
+        number_of_channels_ = maximum_delay > 0 ? number_of_channels : 0;
+
+        ring_.setSize(number_of_channels_, capacity_, false, true, false);
+        reset();
+    }
+
+    /// starts over with silence
+    void reset() noexcept {
+        ring_.clear();
+        write_position_ = 0;
+        delay_ = target_delay_;
+    }
+
+    /// any value, it's limited to what prepare() made room for. Takes effect in the next process()
+    inline void set_delay(int delay) noexcept { target_delay_ = juce::jlimit(0, maximum_delay_, delay); }
+    inline int get_delay() const noexcept { return delay_; }
+    inline int get_maximum_delay() const noexcept { return maximum_delay_; }
+
+    /// a buffer with more channels or samples than prepare() was told about is left alone, rather than allocating
+    void process(juce::AudioBuffer<sample_t>& buffer) noexcept {
+        const int number_of_channels = buffer.getNumChannels();
+        const int number_of_samples = buffer.getNumSamples();
+
+        if(capacity_ == 0 || number_of_channels > number_of_channels_ || number_of_samples > capacity_ - maximum_delay_) {
+            return;
+        }
+
+        const int old_delay = delay_;
+        const int new_delay = target_delay_;
+
+        for(int channel = 0; channel < number_of_channels; ++channel) {
+            sample_t* samples = buffer.getWritePointer(channel);
+            sample_t* ring = ring_.getWritePointer(channel);
+
+            copy_in_(ring, samples, number_of_samples);
+            copy_out_(ring, samples, number_of_samples, old_delay);
+
+            if(old_delay == new_delay) {
+                continue;
+            }
+
+            const sample_t increment = sample_t(1) / (sample_t) number_of_samples;
+            int read_position = wrap_(write_position_ - new_delay);
+
+            for(int i = 0; i < number_of_samples; ++i) {
+                const sample_t gain = (sample_t) (i + 1) * increment;
+                samples[i] += gain * (ring[read_position] - samples[i]);
+                read_position = read_position + 1 == capacity_ ? 0 : read_position + 1;
+            }
+        }
+
+        delay_ = new_delay;
+        write_position_ = wrap_(write_position_ + number_of_samples);
+    }
+
+private:
+    inline int wrap_(int position) const noexcept { return ((position % capacity_) + capacity_) % capacity_; }
+
+    void copy_in_(sample_t* ring, const sample_t* samples, int number_of_samples) const noexcept {
+        const int first = juce::jmin(number_of_samples, capacity_ - write_position_);
+
+        std::copy(samples, samples + first, ring + write_position_);
+        std::copy(samples + first, samples + number_of_samples, ring);
+    }
+
+    void copy_out_(const sample_t* ring, sample_t* samples, int number_of_samples, int delay) const noexcept {
+        const int read_position = wrap_(write_position_ - delay);
+        const int first = juce::jmin(number_of_samples, capacity_ - read_position);
+
+        std::copy(ring + read_position, ring + read_position + first, samples);
+        std::copy(ring, ring + (number_of_samples - first), samples + first);
+    }
+
+    int maximum_delay_ = 0, capacity_ = 0, number_of_channels_ = 0;
+    int write_position_ = 0;
+    int delay_ = 0, target_delay_ = 0;
+
+    juce::AudioBuffer<sample_t> ring_;
+};
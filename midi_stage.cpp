@@ -0,0 +1,193 @@
+#include "midi_stage.h"
+
+#include <cmath>
+
+template<std::size_t... combinations>
+constexpr std::array<midi_stage::process_function, sizeof...(combinations)> midi_stage::make_process_functions_(std::index_sequence<combinations...>) noexcept {
+    return { &process_rules_<(unsigned) combinations>... };
+}
+
+bool midi_stage::settings::operator==(const settings& other) const noexcept {
+    return channels == other.channels
+        && lowest_note == other.lowest_note
+        && highest_note == other.highest_note
+        && transpose == other.transpose
+        && velocity_curve == other.velocity_curve
+        && controllers == other.controllers;
+}
+
+bool midi_stage::settings::is_identity() const noexcept {
+    return *this == settings {};
+}
+
+midi_stage::midi_stage(const settings& s) : settings_(s) {
+    // exponent 1 is linear, 1/4 at the loud end, 4 at the soft end
+    const double exponent = std::pow(4.0, (double) -juce::jlimit(-1.f, 1.f, s.velocity_curve));
+
+    for(int velocity = 1; velocity < 128; ++velocity) {
+        velocities_[(std::size_t) velocity] = (std::uint8_t) juce::jlimit(1, 127, juce::roundToInt(127.0 * std::pow(velocity / 127.0, exponent))); // a note on with velocity 0 is a note off
+    }
+
+    unsigned rules = 0;
+
+    if(s.channels != 0xffff)                                       rules |= filter_channels;
+    if(s.lowest_note > 0 || s.highest_note < 127)                  rules |= split_notes;
+    if(s.transpose != 0)                                           rules |= transpose_notes;
+    if(s.velocity_curve != 0.f)                                    rules |= shape_velocity;
+    if(s.controllers != settings::make_identity_controllers())     rules |= remap_controllers;
+
+    static constexpr auto process_functions = make_process_functions_(std::make_index_sequence<number_of_combinations>());
+    process_ = process_functions[rules];
+}
+
+template<unsigned rules>
+void midi_stage::process_rules_(const midi_stage& stage, juce::MidiBuffer& midi_buffer, juce::MidiBuffer& scratch) noexcept {
+    if constexpr (rules == 0) {
+        juce::ignoreUnused(stage, midi_buffer, scratch); // nothing to do, only here so the table has an entry for it
+    }
+    else {
+        bool dropped = false;
+
+        for(auto it = midi_buffer.cbegin(); it != midi_buffer.cend(); ++it) {
+            const auto metadata = *it;
+
+            // the iterator points straight into the buffer's storage, and none of the rules change an event's size
+            const bool keep = stage.apply_<rules>(const_cast<std::uint8_t*>(metadata.data), metadata.numBytes);
+
+            if(! keep && ! dropped) {
+                // the first dropped event. Everything before it has already been rewritten, so it goes into the scratch as it is
+                dropped = true;
+                scratch.clear();
+
+                for(auto kept = midi_buffer.cbegin(); kept != it; ++kept) {
+                    const auto kept_metadata = *kept;
+                    scratch.addEvent(kept_metadata.data, kept_metadata.numBytes, kept_metadata.samplePosition);
+                }
+            }
+            else if(keep && dropped) {
+                scratch.addEvent(metadata.data, metadata.numBytes, metadata.samplePosition);
+            }
+        }
+
+        if(dropped) {
+            // not swapWith, the host's buffer keeps its own storage. It only got shorter, so this doesn't allocate either
+            midi_buffer.clear();
+            midi_buffer.addEvents(scratch, 0, -1, 0);
+        }
+    }
+}
+
+template<unsigned rules>
+bool midi_stage::apply_(std::uint8_t* data, int size) const noexcept {
+    if(size < 2 || data[0] < 0x80 || data[0] >= 0xf0) {
+        return true; // system messages (sysex included) and anything that isn't a whole channel message go through as they are
+    }
+
+    const int type = data[0] & 0xf0;
+    [[maybe_unused]] const int channel = data[0] & 0x0f;
+
+    if constexpr ((rules & filter_channels) != 0) {
+        if(((settings_.channels >> channel) & 1) == 0) {
+            return false;
+        }
+    }
+
+    if(type == 0x80 || type == 0x90 || type == 0xa0) { // note off, note on, poly aftertouch
+        int note = data[1];
+
+        if constexpr ((rules & split_notes) != 0) {
+            if(note < settings_.lowest_note || note > settings_.highest_note) {
+                return false;
+            }
+        }
+
+        if constexpr ((rules & transpose_notes) != 0) {
+            note += settings_.transpose;
+
+            if(note < 0 || note > 127) {
+                return false;
+            }
+
+            data[1] = (std::uint8_t) note;
+        }
+
+        if constexpr ((rules & shape_velocity) != 0) {
+            if(type == 0x90 && size >= 3 && data[2] > 0) {
+                data[2] = velocities_[data[2] & 0x7f];
+            }
+        }
+    }
+    else if(type == 0xb0) {
+        if constexpr ((rules & remap_controllers) != 0) {
+            const int controller = settings_.controllers[data[1] & 0x7f];
+
+            if(controller < 0) {
+                return false;
+            }
+
+            data[1] = (std::uint8_t) controller;
+        }
+    }
+
+    return true;
+}
+
+void midi_stage::note_tracker::track(const juce::MidiBuffer& midi_buffer) noexcept {
+    for(const auto metadata : midi_buffer) {
+        if(metadata.numBytes < 3 || metadata.data[0] < 0x80 || metadata.data[0] >= 0xf0) {
+            continue;
+        }
+
+        const int type = metadata.data[0] & 0xf0;
+        const auto channel_bit = (std::uint16_t) (1u << (metadata.data[0] & 0x0f));
+        const int note = metadata.data[1] & 0x7f;
+
+        if(type == 0x90 && metadata.data[2] > 0) {
+            held_[(std::size_t) note] |= channel_bit;
+            might_hold_notes_ = true;
+        }
+        else if(type == 0x80 || type == 0x90) {
+            held_[(std::size_t) note] &= (std::uint16_t) ~channel_bit;
+        }
+        else if(type == 0xb0 && (metadata.data[1] == 120 || metadata.data[1] == 123)) { // all sound off, all notes off
+            for(auto& channels : held_) {
+                channels &= (std::uint16_t) ~channel_bit;
+            }
+        }
+    }
+}
+
+void midi_stage::note_tracker::release_all(juce::MidiBuffer& midi_buffer, juce::MidiBuffer& scratch) noexcept {
+    if(! might_hold_notes_) {
+        return;
+    }
+
+    scratch.clear();
+
+    for(int note = 0; note < 128; ++note) {
+        for(int channel = 0; channel < 16; ++channel) {
+            if(((held_[(std::size_t) note] >> channel) & 1) != 0) {
+                const std::uint8_t note_off[3] { (std::uint8_t) (0x80 | channel), (std::uint8_t) note, 0 };
+                scratch.addEvent(note_off, 3, 0);
+            }
+        }
+    }
+
+    reset();
+
+    if(scratch.isEmpty()) {
+        return;
+    }
+
+    // after the note offs, so a note that's played again at sample 0 comes out as a new note
+    scratch.addEvents(midi_buffer, 0, -1, 0);
+
+    // not swapWith, the host's buffer keeps its own storage (it only grows by the note offs)
+    midi_buffer.clear();
+    midi_buffer.addEvents(scratch, 0, -1, 0);
+}
+
+void midi_stage::note_tracker::reset() noexcept {
+    held_.fill(0);
+    might_hold_notes_ = false;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+/**
+ * the midi filtering/remapping a slot does before its plugin sees the block: channel filter, note range split, transpose, velocity curve and CC remapping
+ *
+ * the settings get compiled into lookup tables on the message thread, and into one specialisation of the processing loop per combination of rules,
+ * so the audio thread makes a single indirect call per block and the per event loop only contains the rules that are actually on
+ * events are rewritten in place in the host's MidiBuffer. Rewriting never changes an event's size, only dropping events needs the scratch buffer,
+ * and even then the host's buffer keeps its storage, so nothing gets allocated (as long as the scratch was big enough)
+ *
+ * a midi_stage is immutable once it's made, so the slot publishes it like an instance and retires it through the epoch_reclaimer
+ * that also means it can't remember which notes it let through. The slot keeps a note_tracker for that, so notes held while the settings change don't get stuck
+ */
+class midi_stage {
+public:
+    struct settings {
+        std::uint16_t channels = 0xffff;        // bit n lets channel n + 1 through
+        int lowest_note = 0, highest_note = 127; // notes (and their poly aftertouch) outside this range are dropped. Before transposing
+        int transpose = 0;                      // semitones. Notes that end up outside 0..127 are dropped
+        float velocity_curve = 0.f;             // -1 (softer) .. 1 (louder), 0 is linear. Note on velocities only, and never down to 0
+        std::array<std::int8_t, 128> controllers = make_identity_controllers(); // where each CC goes, -1 drops it
+
+        static constexpr std::array<std::int8_t, 128> make_identity_controllers() noexcept {
+            std::array<std::int8_t, 128> identity {};
+
+            for(std::size_t cc = 0; cc < identity.size(); ++cc) {
+                identity[cc] = (std::int8_t) cc;
+            }
+
+            return identity;
+        }
+
+        bool operator==(const settings& other) const noexcept;
+        bool operator!=(const settings& other) const noexcept { return ! (*this == other); }
+
+        /// true if a midi_stage made from these wouldn't change anything
+        bool is_identity() const noexcept;
+    };
+
+    /// message thread, allocates nothing but itself
+    explicit midi_stage(const settings& s);
+
+    inline const settings& get_settings() const noexcept { return settings_; }
+
+    /// audio thread. scratch only gets used if something is dropped, it should be ensureSize'd to whatever the block's midi can be
+    inline void process(juce::MidiBuffer& midi_buffer, juce::MidiBuffer& scratch) const noexcept { process_(*this, midi_buffer, scratch); }
+
+    /// the notes a plugin is holding, i.e. that it got a note on for (after the stage) and no note off yet. Audio thread only
+    /// once the stage changes, the note offs that are still to come get mapped differently from their note ons (or dropped), so the slot releases everything first
+    class note_tracker {
+    public:
+        /// call with every block's midi, as the plugin is going to get it
+        void track(const juce::MidiBuffer& midi_buffer) noexcept;
+
+        /// puts a note off for every held note at the start of midi_buffer, and forgets them. scratch as in process()
+        void release_all(juce::MidiBuffer& midi_buffer, juce::MidiBuffer& scratch) noexcept;
+
+        void reset() noexcept;
+
+    private:
+        std::array<std::uint16_t, 128> held_ {}; // per note, bit n is channel n + 1
+        bool might_hold_notes_ = false;          // a note on since the last reset, so release_all knows when there's nothing to do
+    };
+
+private:
+    enum rule : unsigned {
+        filter_channels   = 1u << 0,
+        split_notes       = 1u << 1,
+        transpose_notes   = 1u << 2,
+        shape_velocity    = 1u << 3,
+        remap_controllers = 1u << 4,
+
+        number_of_combinations = 1u << 5
+    };
+
+    using process_function = void (*)(const midi_stage&, juce::MidiBuffer&, juce::MidiBuffer&) noexcept;
+
+    template<unsigned rules>
+    static void process_rules_(const midi_stage& stage, juce::MidiBuffer& midi_buffer, juce::MidiBuffer& scratch) noexcept;
+
+    /// rewrites one event. Returns false if it should be dropped
+    template<unsigned rules>
+    bool apply_(std::uint8_t* data, int size) const noexcept;
+
+    /// one process_rules_ per combination, indexed by the combination
+    template<std::size_t... combinations>
+    static constexpr std::array<process_function, sizeof...(combinations)> make_process_functions_(std::index_sequence<combinations...>) noexcept;
+
+    settings settings_;
+    std::array<std::uint8_t, 128> velocities_ {}; // the curve as a table
+    process_function process_;
+};
@@ -0,0 +1,105 @@
+#include "out_of_process_scanner.h"
+
+#include "helper_executables.h"
+
+namespace {
+    constexpr int child_exit_unknown_format = 2; // has to match plugin_scanner_main.cpp
+    constexpr int poll_interval_ms = 50;
+}
+
+out_of_process_scanner::out_of_process_scanner(std::shared_ptr<plugin_scan_cache> cache, juce::File scanner_executable) : cache_(std::move(cache)),
+                                                                                                                         scanner_executable_(std::move(scanner_executable)) {
+
+}
+
+juce::File out_of_process_scanner::find_scanner_executable() {
+    return find_helper_executable("HostPluginDemo-cmake-scanner");
+}
+
+bool out_of_process_scanner::findPluginTypesFor(juce::AudioPluginFormat& format, juce::OwnedArray<juce::PluginDescription>& result, const juce::String& file_or_identifier) {
+    const auto format_name = format.getName();
+
+    bool ok = true;
+    if(cache_->lookup(format_name, file_or_identifier, result, ok)) {
+        return ok; // false puts it back on the blacklist
+    }
+
+    switch(scan_in_child_(format, result, file_or_identifier)) {
+        case child_result::ok:
+            cache_->store(format_name, file_or_identifier, result, true);
+            return true;
+
+        case child_result::failed:
+            result.clear();
+            cache_->store(format_name, file_or_identifier, result, false);
+            return false;
+
+        case child_result::not_run:
+            break;
+    }
+
+    if(shouldExit()) {
+        return true; // the scan was cancelled, don't blacklist anything because of that (and don't cache it either)
+    }
+
+    // no scanner, so this is what KnownPluginList would've done without a custom scanner
+    result.clear();
+    format.findAllTypesForFile(result, file_or_identifier);
+    cache_->store(format_name, file_or_identifier, result, true);
+
+    return true;
+}
+
+out_of_process_scanner::child_result out_of_process_scanner::scan_in_child_(juce::AudioPluginFormat& format, juce::OwnedArray<juce::PluginDescription>& result, const juce::String& file_or_identifier) {
+    if(! scanner_executable_.existsAsFile()) {
+        return child_result::not_run;
+    }
+
+    // the child writes its findings to a file rather than to stdout, so we never have to drain a pipe while we wait for it
+    juce::TemporaryFile output(".xml");
+
+    juce::ChildProcess child;
+    if(! child.start(juce::StringArray{scanner_executable_.getFullPathName(), "--scan", format.getName(), file_or_identifier, output.getFile().getFullPathName()}, 0)) {
+        return child_result::not_run;
+    }
+
+    for(int waited_ms = 0; child.isRunning(); waited_ms += poll_interval_ms) {
+        if(shouldExit()) {
+            child.kill();
+            return child_result::not_run;
+        }
+
+        if(waited_ms >= scan_timeout_ms) {
+            child.kill(); // hung
+            return child_result::failed;
+        }
+
+        child.waitForProcessToFinish(poll_interval_ms);
+    }
+
+    const auto exit_code = child.getExitCode();
+
+    if(exit_code == (juce::uint32) child_exit_unknown_format) {
+        return child_result::not_run;
+    }
+
+    if(exit_code != 0) {
+        return child_result::failed; // crashed, or the plugin wouldn't load
+    }
+
+    const auto xml = juce::parseXML(output.getFile());
+
+    if(xml == nullptr || ! xml->hasTagName("PLUGINS")) {
+        return child_result::failed;
+    }
+
+    for(auto* description_node : xml->getChildIterator()) {
+        auto description = std::make_unique<juce::PluginDescription>();
+
+        if(description->loadFromXml(*description_node)) {
+            result.add(description.release());
+        }
+    }
+
+    return child_result::ok;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <memory>
+
+#include "plugin_scan_cache.h"
+
+/**
+ * scans plugin binaries in a child process (HostPluginDemo-cmake-scanner, see plugin_scanner_main.cpp), and remembers the results in a plugin_scan_cache
+ *
+ * a plugin that crashes or hangs while it's being scanned takes down the child, not the host. It gets blacklisted and the scan carries on
+ * because every binary gets its own child, findPluginTypesFor can be called from several scanning threads at once (PluginListComponent::setNumberOfThreadsForScanning)
+ *
+ * binaries whose fingerprint matches the cache aren't scanned at all
+ * if the scanner executable can't be found (e.g. it wasn't copied next to the plugin), binaries are scanned in process, like before
+ */
+class out_of_process_scanner final : public juce::KnownPluginList::CustomScanner {
+public:
+    out_of_process_scanner(std::shared_ptr<plugin_scan_cache> cache, juce::File scanner_executable);
+
+    bool findPluginTypesFor(juce::AudioPluginFormat& format, juce::OwnedArray<juce::PluginDescription>& result, const juce::String& file_or_identifier) override;
+
+    /// the scanner executable that lives next to the plugin (see helper_executables.h), or a non-existent file if there's none
+    static juce::File find_scanner_executable();
+
+    static constexpr int scan_timeout_ms = 30000; // a plugin that takes longer than this to scan is treated as hung
+
+private:
+    enum class child_result { ok, failed, not_run };
+
+    child_result scan_in_child_(juce::AudioPluginFormat& format, juce::OwnedArray<juce::PluginDescription>& result, const juce::String& file_or_identifier);
+
+    std::shared_ptr<plugin_scan_cache> cache_;
+    juce::File scanner_executable_;
+};
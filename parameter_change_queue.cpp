@@ -0,0 +1,90 @@
+#include "parameter_change_queue.h"
+
+#include <cassert>
+
+parameter_change_queue::parameter_change_queue(std::size_t number_of_parameters) : number_of_parameters_(number_of_parameters) {
+    std::size_t capacity = 2;
+    while(capacity < number_of_parameters) {
+        capacity *= 2;
+    }
+
+    mask_ = capacity - 1;
+
+    cells_ = std::make_unique<cell[]>(capacity);
+    for(std::size_t cell_i = 0; cell_i < capacity; ++cell_i) {
+        cells_[cell_i].sequence.store(cell_i, std::memory_order_relaxed);
+    }
+
+    values_ = std::make_unique<std::atomic<float>[]>(number_of_parameters);
+    dirty_ = std::make_unique<std::atomic<bool>[]>(number_of_parameters);
+
+    for(std::size_t parameter_i = 0; parameter_i < number_of_parameters; ++parameter_i) {
+        values_[parameter_i].store(0.f, std::memory_order_relaxed);
+        dirty_[parameter_i].store(false, std::memory_order_relaxed);
+    }
+}
+
+void parameter_change_queue::push(std::size_t parameter_index, float value) noexcept {
+    if(parameter_index >= number_of_parameters_) {
+        return;
+    }
+
+    values_[parameter_index].store(value); // seq_cst, see drain()
+
+    if(dirty_[parameter_index].exchange(true)) {
+        return; // already queued, the drain will pick up the value we just stored
+    }
+
+    if(! push_(parameter_index)) {
+        assert(false); // can't happen, every parameter is in the ring at most once
+        dirty_[parameter_index].store(false);
+    }
+}
+
+bool parameter_change_queue::push_(std::size_t parameter_index) noexcept {
+    std::size_t position = enqueue_position_.load(std::memory_order_relaxed);
+
+    for(;;) {
+        cell& c = cells_[position & mask_];
+        const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+        const auto difference = (std::intptr_t) sequence - (std::intptr_t) position;
+
+        if(difference == 0) {
+            if(enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                c.parameter_index = parameter_index;
+                c.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if(difference < 0) {
+            return false; // full
+        }
+        else {
+            position = enqueue_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool parameter_change_queue::pop_(std::size_t& parameter_index) noexcept {
+    std::size_t position = dequeue_position_.load(std::memory_order_relaxed);
+
+    for(;;) {
+        cell& c = cells_[position & mask_];
+        const std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+        const auto difference = (std::intptr_t) sequence - (std::intptr_t) (position + 1);
+
+        if(difference == 0) {
+            if(dequeue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                parameter_index = c.parameter_index;
+                c.sequence.store(position + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if(difference < 0) {
+            return false; // empty (or the producer that claimed this cell hasn't finished writing it yet, then it'll be picked up next drain)
+        }
+        else {
+            position = dequeue_position_.load(std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * lock free queue of "parameter i changed" events, so the wrapper doesn't have to notify the host synchronously
+ * from whatever thread the inner plugin happens to change its parameters on (which is usually the audio thread, during automation)
+ *
+ * push() can be called from any number of threads at once. It only stores the latest value and marks the parameter as dirty,
+ * the index only goes into the ring if the parameter wasn't dirty already. So however many times a parameter changes between two drains,
+ * the host only hears about it once, with the latest value
+ * because every parameter is in the ring at most once, a ring with room for every parameter can never overflow
+ *
+ * drain() can also be called from several threads (the audio thread at the end of every block, and a timer while the host isn't playing),
+ * but only one of them actually drains at a time, the others return straight away instead of waiting
+ * neither push() nor drain() allocates or blocks
+ */
+class parameter_change_queue {
+public:
+    explicit parameter_change_queue(std::size_t number_of_parameters);
+
+    parameter_change_queue(const parameter_change_queue&) = delete;
+    parameter_change_queue& operator=(const parameter_change_queue&) = delete;
+
+    inline std::size_t size() const noexcept { return number_of_parameters_; }
+
+    /// any thread
+    void push(std::size_t parameter_index, float value) noexcept;
+
+    /// any thread. Calls callback(parameter_index, latest_value) once for every parameter that changed since the last drain
+    /// returns how many parameters that was (0 if some other thread is draining right now)
+    template<typename callback_t>
+    std::size_t drain(callback_t&& callback) noexcept {
+        if(draining_.exchange(true, std::memory_order_acquire)) {
+            return 0;
+        }
+
+        std::size_t drained = 0, parameter_index = 0;
+
+        while(pop_(parameter_index)) {
+            dirty_[parameter_index].store(false); // seq_cst, and before reading the value. A push that doesn't see this is guaranteed to have its value read below
+            callback(parameter_index, values_[parameter_index].load());
+            ++drained;
+        }
+
+        draining_.store(false, std::memory_order_release);
+
+        return drained;
+    }
+
+private:
+    // bounded MPMC ring (Vyukov). We only ever have one consumer at a time, but it doesn't hurt
+    struct cell {
+        std::atomic<std::size_t> sequence;
+        std::size_t parameter_index;
+    };
+
+    bool push_(std::size_t parameter_index) noexcept;
+    bool pop_(std::size_t& parameter_index) noexcept;
+
+    std::size_t number_of_parameters_;
+    std::size_t mask_;
+
+    std::unique_ptr<cell[]> cells_;
+    std::unique_ptr<std::atomic<float>[]> values_;
+    std::unique_ptr<std::atomic<bool>[]> dirty_;
+
+    alignas(64) std::atomic<std::size_t> enqueue_position_ = 0;
+    alignas(64) std::atomic<std::size_t> dequeue_position_ = 0;
+    alignas(64) std::atomic<bool> draining_ = false;
+};
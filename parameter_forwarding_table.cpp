@@ -0,0 +1,107 @@
+#include "parameter_forwarding_table.h"
+
+parameter_forwarding_table::parameter_forwarding_table(std::size_t capacity, parameter_change_queue& change_queue) : capacity_(capacity),
+                                                                                                                     change_queue_(change_queue),
+                                                                                                                     targets_(std::make_unique<std::atomic<juce::AudioProcessorParameter*>[]>(capacity)),
+                                                                                                                     values_(std::make_unique<std::atomic<float>[]>(capacity)),
+                                                                                                                     metadata_(std::make_unique<std::shared_ptr<const metadata>[]>(capacity)) {
+    jassert(change_queue.size() >= capacity);
+
+    for(std::size_t i = 0; i < capacity; ++i) {
+        targets_[i].store(nullptr, std::memory_order_relaxed);
+        values_[i].store(0.f, std::memory_order_relaxed);
+    }
+}
+
+std::size_t parameter_forwarding_table::bind(std::size_t first, const juce::Array<juce::AudioProcessorParameter*>& parameters) {
+    if(first >= capacity_) {
+        return 0;
+    }
+
+    const std::size_t count = juce::jmin((std::size_t) parameters.size(), capacity_ - first);
+
+    for(std::size_t i = 0; i < count; ++i) {
+        auto* parameter = parameters.getUnchecked((int) i);
+        auto& target = targets_[first + i];
+
+        if(target.load(std::memory_order_relaxed) == parameter) {
+            continue;
+        }
+
+        std::atomic_store_explicit(&metadata_[first + i], metadata::capture(*parameter), std::memory_order_release);
+        target.store(parameter, std::memory_order_release);
+        inner_parameter_changed(first + i, parameter->getValue()); // the host only finds out about the new value (and name) on the next drain
+    }
+
+    bound_size_ = juce::jmax(bound_size_, first + count);
+
+    return count;
+}
+
+void parameter_forwarding_table::unbind_from(std::size_t first) {
+    for(std::size_t i = first; i < bound_size_; ++i) {
+        if(targets_[i].exchange(nullptr, std::memory_order_acq_rel) != nullptr) {
+            std::atomic_store_explicit(&metadata_[i], std::shared_ptr<const metadata>(), std::memory_order_release);
+            inner_parameter_changed(i, 0.f);
+        }
+    }
+
+    bound_size_ = juce::jmin(bound_size_, first);
+}
+
+void parameter_forwarding_table::refresh_metadata(std::size_t first, const juce::Array<juce::AudioProcessorParameter*>& parameters) {
+    for(std::size_t i = 0; i < (std::size_t) parameters.size() && first + i < capacity_; ++i) {
+        auto* parameter = parameters.getUnchecked((int) i);
+
+        if(targets_[first + i].load(std::memory_order_relaxed) == parameter) {
+            std::atomic_store_explicit(&metadata_[first + i], metadata::capture(*parameter), std::memory_order_release);
+        }
+    }
+}
+
+std::shared_ptr<const parameter_forwarding_table::metadata> parameter_forwarding_table::metadata::capture(const juce::AudioProcessorParameter& parameter) {
+    auto captured = std::make_shared<metadata>();
+
+    captured->name = parameter.getName(1024); // getName gets truncated to whatever length the host asks for later
+    captured->label = parameter.getLabel();
+    captured->number_of_steps = parameter.getNumSteps();
+    captured->discrete = parameter.isDiscrete();
+    captured->boolean = parameter.isBoolean();
+    captured->orientation_inverted = parameter.isOrientationInverted();
+    captured->automatable = parameter.isAutomatable();
+    captured->meta = parameter.isMetaParameter();
+    captured->default_value = parameter.getDefaultValue();
+    captured->category = parameter.getCategory();
+    captured->all_value_strings = parameter.getAllValueStrings();
+
+    if((captured->discrete || captured->boolean) && juce::isPositiveAndNotGreaterThan(captured->number_of_steps, metadata::maximum_cached_steps) && captured->number_of_steps > 1) {
+        captured->step_texts.ensureStorageAllocated(captured->number_of_steps);
+
+        for(int step = 0; step < captured->number_of_steps; ++step) {
+            captured->step_texts.add(parameter.getText((float) step / (float) (captured->number_of_steps - 1), 1024));
+        }
+    }
+
+    return captured;
+}
+
+const juce::String* parameter_forwarding_table::metadata::find_step_text(float normalised_value) const noexcept {
+    const int number_of_step_texts = step_texts.size();
+
+    if(number_of_step_texts == 0) {
+        return nullptr;
+    }
+
+    const int step = juce::jlimit(0, number_of_step_texts - 1, juce::roundToInt(normalised_value * (float) (number_of_step_texts - 1)));
+    return &step_texts.getReference(step);
+}
+
+float parameter_forwarding_table::metadata::find_step_value(const juce::String& text) const noexcept {
+    const int step = step_texts.indexOf(text);
+
+    if(step < 0) {
+        return -1.f;
+    }
+
+    return (float) step / (float) (step_texts.size() - 1);
+}
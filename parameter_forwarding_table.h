@@ -0,0 +1,106 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include "parameter_change_queue.h"
+
+#include <atomic>
+#include <memory>
+
+/**
+ * maps the wrapper's parameters (by index) to the inner plugins' parameters
+ *
+ * hosts want the number of parameters to be fixed for the lifetime of a plugin instance, so the capacity is fixed at construction,
+ * but it's meant to be big (the processor uses a couple thousand), so every parameter of a big synth is reachable from the DAW
+ *
+ * the hot data is kept as two flat arrays (structure of arrays) instead of one object per parameter:
+ * the forwarded parameter pointers, and a cached copy of every parameter's value
+ * the host polls getValue() a lot, and that's answered from the cache without calling into the inner plugin at all
+ *
+ * the inner plugins don't notify the table per parameter. There's one AudioProcessorListener per slot, which knows where the slot's parameters start (see HostAudioProcessor),
+ * and it calls inner_parameter_changed(), which updates the cache and queues the change for the host
+ *
+ * the static metadata (name, label, steps, category, value strings...) of every bound parameter is captured once into an immutable snapshot when it's bound,
+ * so hosts polling names and value texts while drawing automation lanes don't call into the inner plugin (which for VST3/LV2 means across the plugin ABI) at all
+ * the snapshots are only recaptured when the inner plugin says its parameter info changed (see refresh_metadata)
+ *
+ * bind(), unbind_from() and refresh_metadata() are message thread only. Everything else can be called from any thread
+ */
+class parameter_forwarding_table {
+public:
+    /// everything about a parameter that doesn't depend on its value. Never changes once it's been captured
+    struct metadata {
+        juce::String name, label;
+        int number_of_steps = 0;
+        bool discrete = false, boolean = false, orientation_inverted = false, automatable = true, meta = false;
+        float default_value = 0.f;
+        juce::AudioProcessorParameter::Category category = juce::AudioProcessorParameter::genericParameter;
+        juce::StringArray all_value_strings;
+
+        /// getText() for every step of a discrete parameter (if it doesn't have too many steps), so its text doesn't need the plugin either. Empty otherwise
+        juce::StringArray step_texts;
+
+        static constexpr int maximum_cached_steps = 256;
+
+        static std::shared_ptr<const metadata> capture(const juce::AudioProcessorParameter& parameter);
+
+        /// nullptr if there's no cached text for that value
+        const juce::String* find_step_text(float normalised_value) const noexcept;
+        /// -1 if text isn't one of the cached step texts
+        float find_step_value(const juce::String& text) const noexcept;
+    };
+
+    parameter_forwarding_table(std::size_t capacity, parameter_change_queue& change_queue);
+
+    parameter_forwarding_table(const parameter_forwarding_table&) = delete;
+    parameter_forwarding_table& operator=(const parameter_forwarding_table&) = delete;
+
+    inline std::size_t capacity() const noexcept { return capacity_; }
+
+    /// message thread. Forwards [first, first + parameters.size()) to parameters (anything past the capacity is dropped)
+    /// entries that already point at the right parameter aren't touched, so rebinding after a change in one slot is mostly a compare per parameter
+    /// returns how many entries were actually bound
+    std::size_t bind(std::size_t first, const juce::Array<juce::AudioProcessorParameter*>& parameters);
+
+    /// message thread. Makes every entry from first to the end of what was bound before empty
+    void unbind_from(std::size_t first);
+
+    /// message thread. Recaptures the metadata of [first, first + parameters.size()), for when the inner plugin signals a parameter info change
+    void refresh_metadata(std::size_t first, const juce::Array<juce::AudioProcessorParameter*>& parameters);
+
+    /// nullptr for an empty entry
+    inline std::shared_ptr<const metadata> get_metadata(std::size_t index) const noexcept { return std::atomic_load_explicit(&metadata_[index], std::memory_order_acquire); }
+
+    /// number of entries up to (and including) the last bound one
+    inline std::size_t get_bound_size() const noexcept { return bound_size_; }
+
+    inline juce::AudioProcessorParameter* get_target(std::size_t index) const noexcept { return targets_[index].load(std::memory_order_acquire); }
+
+    inline float get_value(std::size_t index) const noexcept { return values_[index].load(std::memory_order_relaxed); }
+
+    /// the host changed the wrapper's parameter
+    inline void set_value(std::size_t index, float value) noexcept {
+        values_[index].store(value, std::memory_order_relaxed);
+
+        if(auto* target = get_target(index)) {
+            target->setValue(value);
+        }
+    }
+
+    /// the inner plugin changed its parameter, the host gets told about it when the change queue is drained
+    inline void inner_parameter_changed(std::size_t index, float value) noexcept {
+        if(index < capacity_) {
+            values_[index].store(value, std::memory_order_relaxed);
+            change_queue_.push(index, value);
+        }
+    }
+
+private:
+    std::size_t capacity_;
+    std::size_t bound_size_ = 0; // message thread
+    parameter_change_queue& change_queue_;
+
+    std::unique_ptr<std::atomic<juce::AudioProcessorParameter*>[]> targets_;
+    std::unique_ptr<std::atomic<float>[]> values_;
+    std::unique_ptr<std::shared_ptr<const metadata>[]> metadata_; // only ever accessed through std::atomic_load/atomic_store
+};
@@ -0,0 +1,326 @@
+#include "plugin_index.h"
+
+#include "out_of_process_scanner.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+    constexpr char index_chunk[5] = "PIDX";
+    constexpr char plugin_chunk[5] = "PLUG";
+    constexpr char blacklist_chunk[5] = "BLCK";
+
+    constexpr std::size_t table_offset = state_chunks::header_size + state_chunks::chunk_header_size + 4; // the PIDX entries start right after its count
+    constexpr std::size_t table_entry_size = 12;
+}
+
+plugin_index::~plugin_index() {
+    if(isTimerRunning()) {
+        timerCallback(); // don't lose a pending rewrite
+    }
+
+    if(list_ != nullptr) {
+        list_->removeChangeListener(this);
+    }
+}
+
+void plugin_index::open(const juce::PropertiesFile::Options& settings) {
+    const juce::ScopedLock sl(lock_);
+
+    if(opened_) {
+        return;
+    }
+
+    opened_ = true;
+    settings_ = settings;
+    index_file_ = settings.getDefaultFile().getSiblingFile("plugin_index.bin");
+}
+
+juce::KnownPluginList& plugin_index::get_list() {
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    const juce::ScopedLock sl(lock_);
+
+    if(list_ != nullptr) {
+        return *list_;
+    }
+
+    auto list = std::make_unique<juce::KnownPluginList>();
+
+    if(! map_()) {
+        build_();
+        map_();
+    }
+
+    if(mapping_ != nullptr) {
+        state_chunks::reader reader(mapping_->getData(), mapping_->getSize());
+
+        while(reader.next_chunk()) {
+            if(reader.chunk_is(plugin_chunk)) {
+                list->addType(read_description_(reader));
+            }
+            else if(reader.chunk_is(blacklist_chunk)) {
+                for(int i = reader.read_int(0); i > 0; --i) {
+                    list->addToBlacklist(reader.read_string());
+                }
+            }
+        }
+    }
+
+    mapping_.reset(); // the list is the index from now on
+
+    list->setCustomScanner(std::make_unique<out_of_process_scanner>(get_cache_(), out_of_process_scanner::find_scanner_executable()));
+    list->addChangeListener(this); // we're on the message thread, so this doesn't need a MessageManagerLock
+
+    list_ = std::move(list);
+    return *list_;
+}
+
+std::optional<juce::PluginDescription> plugin_index::find(const juce::String& format_name, int unique_id) {
+    const juce::ScopedLock sl(lock_);
+
+    if(list_ != nullptr) {
+        for(const auto& description : list_->getTypes()) {
+            if(description.pluginFormatName == format_name && description.uniqueId == unique_id) {
+                return description;
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    if(! map_()) {
+        build_();
+
+        if(! map_()) {
+            return std::nullopt;
+        }
+    }
+
+    const auto* data = static_cast<const char*>(mapping_->getData());
+    const auto hash = hash_(format_name, unique_id);
+
+    const auto hash_at = [data] (std::size_t i) { return juce::ByteOrder::littleEndianInt(data + table_offset + i * table_entry_size); };
+
+    // lower_bound over the table, which is sorted by hash. Nothing but the table entries it lands on and the one chunk it decodes gets paged in
+    std::size_t first = 0, count = number_of_entries_;
+    while(count > 0) {
+        const auto step = count / 2;
+
+        if(hash_at(first + step) < hash) {
+            first += step + 1;
+            count -= step + 1;
+        }
+        else {
+            count = step;
+        }
+    }
+
+    for(auto i = first; i < number_of_entries_ && hash_at(i) == hash; ++i) {
+        const auto offset = (std::size_t) juce::ByteOrder::littleEndianInt64(data + table_offset + i * table_entry_size + 4);
+
+        state_chunks::reader reader(data, mapping_->getSize());
+
+        if(reader.seek_chunk(offset) && reader.chunk_is(plugin_chunk)) {
+            auto description = read_description_(reader);
+
+            if(description.pluginFormatName == format_name && description.uniqueId == unique_id) { // hashes can collide
+                return description;
+            }
+        }
+    }
+
+    return std::nullopt;
+}
+
+juce::uint32 plugin_index::hash_(const juce::String& format_name, int unique_id) {
+    return (juce::uint32) (format_name + ":" + juce::String(unique_id)).hashCode();
+}
+
+bool plugin_index::map_() {
+    if(mapping_ != nullptr) {
+        return true;
+    }
+
+    if(! opened_ || ! index_file_.existsAsFile()) {
+        return false;
+    }
+
+    auto mapping = std::make_unique<juce::MemoryMappedFile>(index_file_, juce::MemoryMappedFile::readOnly);
+
+    if(mapping->getData() == nullptr) {
+        return false;
+    }
+
+    state_chunks::reader reader(mapping->getData(), mapping->getSize());
+
+    if(! reader.next_chunk() || ! reader.chunk_is(index_chunk)) {
+        return false;
+    }
+
+    const auto count = (std::size_t) (juce::uint32) reader.read_int(0);
+
+    if(table_offset + count * table_entry_size > reader.get_next_chunk_offset()) {
+        return false; // not a table we can trust
+    }
+
+    number_of_entries_ = count;
+    mapping_ = std::move(mapping);
+    return true;
+}
+
+void plugin_index::build_() {
+    if(! opened_) {
+        return;
+    }
+
+    // this only happens the first time this version runs (or if the index was deleted), so it's allowed to be slow
+    juce::KnownPluginList list;
+    auto cache = get_cache_();
+
+    if(cache->is_empty()) {
+        juce::PropertiesFile old_settings(settings_);
+
+        if(auto saved_plugin_list = old_settings.getXmlValue("pluginList")) {
+            list.recreateFromXml(*saved_plugin_list);
+            cache->store_all(list); // the old list doesn't know the fingerprints, but the binaries get fingerprinted as they are when they're stored
+
+            old_settings.removeValue("pluginList"); // so the settings file is small again
+            old_settings.saveIfNeeded();
+        }
+    }
+    else {
+        cache->fill_list(list);
+    }
+
+    write_(list);
+}
+
+void plugin_index::write_(const juce::KnownPluginList& list) {
+    const auto types = list.getTypes();
+
+    std::vector<std::pair<juce::uint32, std::size_t>> table; // hash, offset within plugins
+    table.reserve((std::size_t) types.size());
+
+    juce::MemoryBlock plugins;
+
+    {
+        state_chunks::writer writer(plugins, false);
+
+        for(const auto& description : types) {
+            table.emplace_back(hash_(description.pluginFormatName, description.uniqueId), writer.get_position());
+
+            writer.begin_chunk(plugin_chunk);
+            write_description_(writer, description);
+            writer.end_chunk();
+        }
+
+        const auto& blacklist = list.getBlacklistedFiles();
+
+        writer.begin_chunk(blacklist_chunk);
+        writer.write_int(blacklist.size());
+        for(const auto& file_or_identifier : blacklist) {
+            writer.write_string(file_or_identifier);
+        }
+        writer.end_chunk();
+    }
+
+    std::sort(table.begin(), table.end());
+
+    juce::MemoryBlock data;
+
+    {
+        state_chunks::writer writer(data);
+
+        const auto first_plugin_offset = table_offset + table.size() * table_entry_size;
+        writer.reserve(first_plugin_offset + plugins.getSize());
+
+        writer.begin_chunk(index_chunk);
+        writer.write_int((int) table.size());
+        for(const auto& [hash, offset] : table) {
+            writer.write_int((int) hash);
+            writer.write_int64((juce::int64) (first_plugin_offset + offset));
+        }
+        writer.end_chunk();
+    }
+
+    data.append(plugins.getData(), plugins.getSize());
+
+    mapping_.reset(); // windows won't replace a file that's mapped
+
+    index_file_.getParentDirectory().createDirectory();
+
+    juce::TemporaryFile temporary(index_file_);
+
+    if(temporary.getFile().replaceWithData(data.getData(), data.getSize())) {
+        temporary.overwriteTargetFileWithTemporary(); // other processes might be mapping it right now, they keep the old one
+    }
+}
+
+std::shared_ptr<plugin_scan_cache> plugin_index::get_cache_() {
+    if(cache_ == nullptr) {
+        cache_ = std::make_shared<plugin_scan_cache>(index_file_.getSiblingFile("plugin_scan_cache.bin"));
+    }
+
+    return cache_;
+}
+
+void plugin_index::write_description_(state_chunks::writer& writer, const juce::PluginDescription& description) {
+    writer.write_string(description.name);
+    writer.write_string(description.descriptiveName);
+    writer.write_string(description.pluginFormatName);
+    writer.write_string(description.category);
+    writer.write_string(description.manufacturerName);
+    writer.write_string(description.version);
+    writer.write_string(description.fileOrIdentifier);
+    writer.write_int64(description.lastFileModTime.toMilliseconds());
+    writer.write_int64(description.lastInfoUpdateTime.toMilliseconds());
+    writer.write_int(description.deprecatedUid);
+    writer.write_int(description.uniqueId);
+    writer.write_bool(description.isInstrument);
+    writer.write_int(description.numInputChannels);
+    writer.write_int(description.numOutputChannels);
+    writer.write_bool(description.hasSharedContainer);
+    writer.write_bool(description.hasARAExtension);
+}
+
+juce::PluginDescription plugin_index::read_description_(state_chunks::reader& reader) {
+    juce::PluginDescription description;
+
+    description.name = reader.read_string();
+    description.descriptiveName = reader.read_string();
+    description.pluginFormatName = reader.read_string();
+    description.category = reader.read_string();
+    description.manufacturerName = reader.read_string();
+    description.version = reader.read_string();
+    description.fileOrIdentifier = reader.read_string();
+    description.lastFileModTime = juce::Time(reader.read_int64(0));
+    description.lastInfoUpdateTime = juce::Time(reader.read_int64(0));
+    description.deprecatedUid = reader.read_int(0);
+    description.uniqueId = reader.read_int(0);
+    description.isInstrument = reader.read_bool(false);
+    description.numInputChannels = reader.read_int(0);
+    description.numOutputChannels = reader.read_int(0);
+    description.hasSharedContainer = reader.read_bool(false);
+    description.hasARAExtension = reader.read_bool(false);
+
+    return description;
+}
+
+void plugin_index::changeListenerCallback(juce::ChangeBroadcaster*) {
+    startTimer(rewrite_delay_ms_);
+}
+
+void plugin_index::timerCallback() {
+    stopTimer();
+
+    const juce::ScopedLock sl(lock_);
+
+    if(list_ == nullptr) {
+        return;
+    }
+
+    // scan results were already written to the cache as they came in (see out_of_process_scanner), so all the cache needs is to forget what the user removed
+    get_cache_()->sync_with(*list_);
+    write_(*list_);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <memory>
+#include <optional>
+
+#include "plugin_scan_cache.h"
+#include "state_chunks.h"
+
+/**
+ * the list of known plugins, shared by every instance of the wrapper in the process (the plugin_registry owns the only one)
+ *
+ * every wrapper used to parse the whole plugin list xml when it was constructed, so a session with a hundred wrappers parsed it a hundred times and kept a hundred copies
+ * now the list lives in a compact binary index file (state_chunks, next to the settings file) that's memory mapped the first time something needs it
+ * and decoded lazily:
+ *     find() decodes just the one entry it's after (the index is sorted by a hash of format name + uid)
+ *     get_list() decodes everything into a KnownPluginList, once per process, when the first plugin list component is shown
+ * so constructing a wrapper only costs remembering where the files are
+ *
+ * layout of the index file:
+ *     "PIDX"  u32 count, then count * (u32 hash, u64 offset of the "PLUG" chunk), sorted by hash
+ *     "PLUG"  one PluginDescription per chunk
+ *     "BLCK"  the blacklist
+ *
+ * the index is derived from the list. Whenever the list changes (a scan, or the user removing plugins), it's rewritten a little later, from the message thread
+ * where it's missing, it's built from the plugin_scan_cache, or from the "pluginList" xml that older versions kept in the settings file
+ */
+class plugin_index final : private juce::ChangeListener,
+                           private juce::Timer {
+public:
+    plugin_index() = default;
+    ~plugin_index() override;
+
+    /// any thread. Only remembers where the files are. Only the first call does anything
+    void open(const juce::PropertiesFile::Options& settings);
+
+    /// message thread. Decodes the whole index the first time it's called, after that it's the same list for every wrapper
+    juce::KnownPluginList& get_list();
+
+    /// any thread. The known plugin with this format and uid, e.g. to find out where a plugin moved since a state that refers to it was saved
+    std::optional<juce::PluginDescription> find(const juce::String& format_name, int unique_id);
+
+private:
+    static constexpr int rewrite_delay_ms_ = 2000; // a scan changes the list once per plugin, this batches those into one rewrite
+
+    static juce::uint32 hash_(const juce::String& format_name, int unique_id);
+
+    static void write_description_(state_chunks::writer& writer, const juce::PluginDescription& description);
+    static juce::PluginDescription read_description_(state_chunks::reader& reader);
+
+    // all of these expect lock_ to be held
+    bool map_();
+    void build_();
+    void write_(const juce::KnownPluginList& list);
+    std::shared_ptr<plugin_scan_cache> get_cache_();
+
+    void changeListenerCallback(juce::ChangeBroadcaster* source) override;
+    void timerCallback() override; // rewrites the index
+
+    juce::CriticalSection lock_;
+    bool opened_ = false;
+    juce::PropertiesFile::Options settings_;
+    juce::File index_file_;
+
+    std::unique_ptr<juce::MemoryMappedFile> mapping_; // released once the list has been decoded, from then on the list is the index
+    std::size_t number_of_entries_ = 0;
+
+    std::shared_ptr<plugin_scan_cache> cache_;        // shared with the list's out_of_process_scanner
+    std::unique_ptr<juce::KnownPluginList> list_;
+};
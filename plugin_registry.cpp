@@ -0,0 +1,42 @@
+#include "plugin_registry.h"
+
+plugin_registry::plugin_registry() {
+    const auto settings = make_settings();
+
+    properties_.setStorageParameters(settings); // nothing gets read until someone asks for the settings
+    format_manager_.addDefaultFormats();
+    index_.open(settings);                      // same here, until the plugin list is needed
+}
+
+realtime_worker_pool& plugin_registry::get_workers(int maximum_useful_workers) {
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    if(workers_ == nullptr) {
+        workers_ = std::make_unique<realtime_worker_pool>(realtime_worker_pool::default_number_of_workers(maximum_useful_workers));
+    }
+
+    return *workers_;
+}
+
+juce::ThreadPool& plugin_registry::get_loader_threads() {
+    JUCE_ASSERT_MESSAGE_THREAD
+
+    // loads of different wrappers run side by side up to this many, e.g. while a session opens. Mostly they wait on the plugin, not on the cpu
+    if(loader_threads_ == nullptr) {
+        loader_threads_ = std::make_unique<juce::ThreadPool>(juce::jmax(2, juce::SystemStats::getNumCpus() / 2));
+    }
+
+    return *loader_threads_;
+}
+
+juce::PropertiesFile::Options plugin_registry::make_settings() {
+    juce::PropertiesFile::Options opt;
+    opt.applicationName = "HostPluginDemo-cmake";
+    opt.commonToAllUsers = false;
+    opt.doNotSave = false;
+    opt.filenameSuffix = ".props";
+    opt.ignoreCaseOfKeyNames = false;
+    opt.storageFormat = juce::PropertiesFile::StorageFormat::storeAsXML;
+    opt.osxLibrarySubFolder = "Application Support";
+    return opt;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <memory>
+
+#include "plugin_index.h"
+#include "realtime_worker_pool.h"
+
+/**
+ * everything about plugins that doesn't depend on which wrapper is asking, shared by every wrapper in the process (hold it with a juce::SharedResourcePointer,
+ * which counts the wrappers holding it and destroys it with the last one)
+ *
+ * every wrapper used to make its own AudioPluginFormatManager and ApplicationProperties. Making the formats isn't free: the LV2 format loads every bundle
+ * on the LV2 path into its world, and each format keeps its own caches, e.g. the VST3 modules it has opened. So a session with 200 wrappers did all of that 200 times,
+ * and kept 200 copies of it. Now the first wrapper sets everything up and the others just take a reference
+ *
+ * all of it is set up in the constructor, which juce::SharedResourcePointer runs under its lock, and none of it is replaced afterwards,
+ * so readers don't need a lock of their own. The formats themselves are only meant to be used from the message thread, like always
+ * the plugin list is the plugin_index, which decodes itself lazily
+ *
+ * the exceptions are the threads: the real time ones for parallel branches and the ones inner_plugin_loader builds instances on,
+ * which only get started once some wrapper needs them (see get_workers and get_loader_threads)
+ * a set of those per wrapper would be hundreds (or, for the workers, a thousand) threads in a big session, mostly idle or competing with the host's own
+ */
+class plugin_registry {
+public:
+    plugin_registry();
+
+    inline juce::AudioPluginFormatManager& get_format_manager() noexcept { return format_manager_; }
+    inline juce::ApplicationProperties& get_properties() noexcept { return properties_; }
+    inline plugin_index& get_index() noexcept { return index_; }
+
+    /// message thread. The pool every wrapper runs its parallel branches on, started the first time anyone asks (with however many workers that one asked for)
+    /// it's never replaced or destroyed before the registry is, so the audio thread can keep a plain pointer to it
+    realtime_worker_pool& get_workers(int maximum_useful_workers);
+
+    /// message thread. The threads every wrapper's inner_plugin_loader restores and prepares instances on, started the first time any wrapper loads a plugin
+    /// like the workers, it's never replaced or destroyed before the registry is
+    juce::ThreadPool& get_loader_threads();
+
+    /// where the wrapper keeps its settings. The index and the scan cache live next to that file
+    static juce::PropertiesFile::Options make_settings();
+
+private:
+    juce::ApplicationProperties properties_;
+    juce::AudioPluginFormatManager format_manager_;
+    plugin_index index_;
+
+    std::unique_ptr<realtime_worker_pool> workers_;
+    std::unique_ptr<juce::ThreadPool> loader_threads_; // after the formats, so it's stopped before the formats that made the instances it's working on go away
+
+    JUCE_DECLARE_NON_COPYABLE(plugin_registry)
+};
@@ -0,0 +1,474 @@
+/**
+ * HostPluginDemo-cmake-sandbox
+ *
+ * runs one inner plugin in its own process, for sandboxed_plugin_instance. The wrapper starts it through a ChildProcessCoordinator,
+ * sends it control messages (see sandbox_protocol.h) over that connection, and exchanges audio and midi with it through a shared_audio_channel
+ * control messages are handled on this process' message thread, blocks are processed on a real time thread that sleeps on the channel
+ *
+ * run by hand, it tries the whole thing out without any plugins installed:
+ *     HostPluginDemo-cmake-sandbox --self-test
+ * starts a copy of itself as a sandbox with the dummy plugin in it, pushes a few thousand blocks through it, prints the round trip times,
+ * then crashes the sandbox and checks that it gets restarted
+ */
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "sandbox_protocol.h"
+#include "sandboxed_plugin_instance.h"
+#include "shared_audio_channel.h"
+#include "state_chunks.h"
+
+namespace {
+    constexpr int exit_ok = 0, exit_failed = 1;
+
+    // the plugin behind sandbox_protocol::dummy_format_name
+    class dummy_plugin final : public juce::AudioProcessor {
+    public:
+        dummy_plugin() : AudioProcessor(BusesProperties().withInput ("Input",  juce::AudioChannelSet::stereo(), true)
+                                                         .withOutput("Output", juce::AudioChannelSet::stereo(), true)) {}
+
+        static constexpr float gain = 0.5f;
+
+        const juce::String getName() const override { return sandbox_protocol::dummy_plugin_name; }
+        void prepareToPlay(double, int) override {}
+        void releaseResources() override {}
+        void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override { buffer.applyGain(gain); } // midi passes through
+
+        double getTailLengthSeconds() const override { return 0.0; }
+        bool acceptsMidi() const override { return true; }
+        bool producesMidi() const override { return true; }
+        bool hasEditor() const override { return false; }
+        juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+        int getNumPrograms() override { return 1; }
+        int getCurrentProgram() override { return 0; }
+        void setCurrentProgram(int) override {}
+        const juce::String getProgramName(int) override { return {}; }
+        void changeProgramName(int, const juce::String&) override {}
+
+        void getStateInformation(juce::MemoryBlock& destination) override { destination.append(&state_, sizeof(state_)); }
+        void setStateInformation(const void* data, int size) override {
+            if(size == (int) sizeof(state_)) {
+                std::memcpy(&state_, data, sizeof(state_));
+            }
+        }
+
+    private:
+        juce::int32 state_ = 0; // just something that makes the round trip
+    };
+
+    //==============================================================================
+    class sandbox final : public juce::ChildProcessWorker {
+    public:
+        ~sandbox() override {
+            stop_audio_();
+        }
+
+        void handleMessageFromCoordinator(const juce::MemoryBlock& message) override {
+            // this is the connection's thread. Plugins want to be created (and mostly talked to) on the message thread
+            juce::MessageManager::callAsync([this, message] { handle_(message); });
+        }
+
+        void handleConnectionLost() override {
+            // the wrapper's gone (or killed us on purpose), there's no reason to stay
+            juce::MessageManager::callAsync([] { juce::MessageManager::getInstance()->stopDispatchLoop(); });
+        }
+
+    private:
+        class audio_thread final : public juce::Thread {
+        public:
+            explicit audio_thread(sandbox& owner) : Thread("sandbox audio"),
+                                                    owner_(owner) {}
+
+            void run() override {
+                auto& channel = *owner_.channel_;
+                auto& shared = channel.get();
+
+                // whatever was in flight when the previous sandbox died gets answered (with its own input), so the wrapper doesn't wait for it forever
+                juce::uint32 last_seen = shared.request.load(std::memory_order_acquire);
+                channel.respond(last_seen);
+
+                float* channels[shared_audio_channel::maximum_number_of_channels];
+                for(int c = 0; c < shared_audio_channel::maximum_number_of_channels; ++c) {
+                    channels[c] = shared.audio[c];
+                }
+
+                while(! threadShouldExit()) {
+                    if(! channel.wait_for_request(last_seen, 100)) {
+                        continue;
+                    }
+
+                    const int number_of_inputs = juce::jlimit(0, shared_audio_channel::maximum_number_of_channels, shared.number_of_input_channels);
+                    const int number_of_outputs = juce::jlimit(0, shared_audio_channel::maximum_number_of_channels, shared.number_of_output_channels);
+                    const int number_of_samples = juce::jlimit(0, shared_audio_channel::maximum_block_size, shared.number_of_samples);
+                    const int number_of_channels = juce::jmax(number_of_inputs, number_of_outputs);
+
+                    buffer_.setDataToReferTo(channels, number_of_channels, number_of_samples); // straight into the shared memory, no copy
+
+                    for(int c = number_of_inputs; c < number_of_channels; ++c) {
+                        buffer_.clear(c, 0, number_of_samples);
+                    }
+
+                    midi_.clear();
+                    shared_audio_channel::read_midi(shared.midi, juce::jlimit(0, shared_audio_channel::midi_capacity, shared.midi_bytes), midi_);
+
+                    {
+                        const juce::ScopedLock sl(owner_.processor_->getCallbackLock());
+                        owner_.processor_->processBlock(buffer_, midi_);
+                    }
+
+                    shared.midi_bytes = shared_audio_channel::write_midi(midi_, 0, number_of_samples, shared.midi, shared_audio_channel::midi_capacity);
+                    channel.respond(last_seen);
+                }
+            }
+
+            juce::AudioBuffer<float> buffer_;
+            juce::MidiBuffer midi_;
+
+        private:
+            sandbox& owner_;
+        };
+
+        void handle_(const juce::MemoryBlock& message) {
+            state_chunks::reader reader(message.getData(), message.getSize());
+
+            if(! reader.next_chunk()) {
+                return;
+            }
+
+            const int number = reader.read_int(0);
+
+            if(reader.chunk_is(sandbox_protocol::open_command)) {
+                channel_ = shared_audio_channel::open(reader.read_string());
+
+                if(channel_ != nullptr) {
+                    reply_(number, sandbox_protocol::ok_reply, [] (state_chunks::writer&) {});
+                }
+                else {
+                    reply_(number, sandbox_protocol::failed_reply, [] (state_chunks::writer& writer) { writer.write_string("the sandbox couldn't open the shared memory"); });
+                }
+            }
+            else if(reader.chunk_is(sandbox_protocol::load_command)) {
+                load_(number, reader);
+            }
+            else if(reader.chunk_is(sandbox_protocol::prepare_command)) {
+                prepare_(number, reader);
+            }
+            else if(reader.chunk_is(sandbox_protocol::release_command)) {
+                stop_audio_();
+
+                if(processor_ != nullptr) {
+                    processor_->releaseResources();
+                }
+
+                reply_(number, sandbox_protocol::ok_reply, [] (state_chunks::writer&) {});
+            }
+            else if(reader.chunk_is(sandbox_protocol::get_state_command)) {
+                juce::MemoryBlock state;
+
+                if(processor_ != nullptr) {
+                    processor_->getStateInformation(state);
+                }
+
+                reply_(number, sandbox_protocol::state_reply, [&state] (state_chunks::writer& writer) { writer.write_bytes(state.getData(), state.getSize()); });
+            }
+            else if(reader.chunk_is(sandbox_protocol::set_state_command)) {
+                const void* state = nullptr;
+                std::size_t state_size = 0;
+
+                if(processor_ != nullptr && reader.read_bytes(state, state_size)) {
+                    processor_->setStateInformation(state, (int) state_size);
+                }
+
+                reply_(number, sandbox_protocol::ok_reply, [] (state_chunks::writer&) {});
+            }
+            else if(reader.chunk_is(sandbox_protocol::crash_command)) {
+                if(dynamic_cast<dummy_plugin*>(processor_.get()) != nullptr) {
+                    std::abort();
+                }
+            }
+        }
+
+        void load_(int number, state_chunks::reader& reader) {
+            stop_audio_();
+            processor_.reset();
+
+            const auto xml = juce::parseXML(reader.read_string());
+
+            juce::PluginDescription description;
+
+            if(xml == nullptr || ! description.loadFromXml(*xml)) {
+                reply_(number, sandbox_protocol::failed_reply, [] (state_chunks::writer& writer) { writer.write_string("the sandbox got a broken plugin description"); });
+                return;
+            }
+
+            juce::String error;
+
+            if(description.pluginFormatName == sandbox_protocol::dummy_format_name) {
+                processor_ = std::make_unique<dummy_plugin>();
+            }
+            else {
+                if(format_manager_.getNumFormats() == 0) {
+                    format_manager_.addDefaultFormats();
+                }
+
+                processor_ = format_manager_.createPluginInstance(description, 44100.0, 512, error);
+            }
+
+            if(processor_ == nullptr) {
+                reply_(number, sandbox_protocol::failed_reply, [&error] (state_chunks::writer& writer) { writer.write_string(error.isNotEmpty() ? error : juce::String("the plugin couldn't be instantiated")); });
+                return;
+            }
+
+            const void* state = nullptr;
+            std::size_t state_size = 0;
+
+            if(reader.read_bytes(state, state_size) && state_size > 0) {
+                processor_->setStateInformation(state, (int) state_size);
+            }
+
+            const auto layouts = get_supported_layouts_();
+
+            reply_(number, sandbox_protocol::ok_reply, [this, &layouts] (state_chunks::writer& writer) {
+                writer.write_string(processor_->getName());
+                writer.write_int(processor_->getLatencySamples());
+                writer.write_float((float) processor_->getTailLengthSeconds());
+
+                writer.write_int((int) layouts.size());
+
+                for(const auto& [input, output] : layouts) {
+                    sandbox_protocol::write_channel_set(writer, input);
+                    sandbox_protocol::write_channel_set(writer, output);
+                }
+            });
+        }
+
+        /// the plugin's layout with input and output on its main buses, and its aux buses off if it lets us (sidechains and aux outputs don't go through the sandbox)
+        /// a side the plugin has no bus on ignores its set
+        std::optional<juce::AudioProcessor::BusesLayout> find_layout_(const juce::AudioChannelSet& input, const juce::AudioChannelSet& output) const {
+            auto layout = processor_->getBusesLayout();
+
+            if(! layout.inputBuses.isEmpty())  layout.inputBuses.getReference(0)  = input;
+            if(! layout.outputBuses.isEmpty()) layout.outputBuses.getReference(0) = output;
+
+            auto without_aux = layout;
+
+            for(int bus_i = 1; bus_i < without_aux.inputBuses.size(); ++bus_i) {
+                without_aux.inputBuses.getReference(bus_i) = juce::AudioChannelSet::disabled();
+            }
+
+            for(int bus_i = 1; bus_i < without_aux.outputBuses.size(); ++bus_i) {
+                without_aux.outputBuses.getReference(bus_i) = juce::AudioChannelSet::disabled();
+            }
+
+            for(const auto* candidate : { &without_aux, &layout }) {
+                if(processor_->checkBusesLayoutSupported(*candidate)) {
+                    return *candidate;
+                }
+            }
+
+            return {};
+        }
+
+        /// what the LOAD reply tells the wrapper, see sandbox_protocol.h
+        std::vector<std::pair<juce::AudioChannelSet, juce::AudioChannelSet>> get_supported_layouts_() const {
+            const auto plugin_default = processor_->getBusesLayout();
+            const auto default_input = plugin_default.getMainInputChannelSet();
+            const auto default_output = plugin_default.getMainOutputChannelSet();
+
+            auto inputs = sandbox_protocol::get_layout_candidates(true);
+            auto outputs = sandbox_protocol::get_layout_candidates(false);
+
+            inputs.insert(0, default_input);
+            outputs.insert(0, default_output);
+
+            std::vector<std::pair<juce::AudioChannelSet, juce::AudioChannelSet>> layouts;
+
+            for(const auto& output : outputs) {
+                for(const auto& input : inputs) {
+                    const std::pair<juce::AudioChannelSet, juce::AudioChannelSet> candidate { input, output };
+
+                    if(output.isDisabled() || std::find(layouts.begin(), layouts.end(), candidate) != layouts.end()) {
+                        continue;
+                    }
+
+                    if(find_layout_(input, output).has_value()) {
+                        layouts.push_back(candidate);
+                    }
+                }
+            }
+
+            return layouts;
+        }
+
+        void prepare_(int number, state_chunks::reader& reader) {
+            stop_audio_();
+
+            const auto sample_rate = (double) reader.read_float(44100.f);
+            const int block_size = reader.read_int(512);
+            const auto input = sandbox_protocol::read_channel_set(reader);
+            const auto output = sandbox_protocol::read_channel_set(reader);
+
+            if(processor_ == nullptr || channel_ == nullptr) {
+                reply_(number, sandbox_protocol::failed_reply, [] (state_chunks::writer& writer) { writer.write_string("nothing's loaded"); });
+                return;
+            }
+
+            // one of the layouts the LOAD reply said the plugin supports, which channel_adapter::negotiate picked on the wrapper's side
+            const auto layout = find_layout_(input, output);
+
+            if(! layout.has_value() || ! processor_->setBusesLayout(*layout)) {
+                reply_(number, sandbox_protocol::failed_reply, [&] (state_chunks::writer& writer) {
+                    writer.write_string("the sandboxed plugin doesn't support " + input.getDescription() + " in, " + output.getDescription() + " out!");
+                });
+                return;
+            }
+
+            processor_->setRateAndBufferSizeDetails(sample_rate, block_size);
+            processor_->prepareToPlay(sample_rate, block_size);
+
+            audio_thread_ = std::make_unique<audio_thread>(*this);
+            audio_thread_->midi_.ensureSize(shared_audio_channel::midi_capacity);
+
+            if(! audio_thread_->startRealtimeThread(juce::Thread::RealtimeOptions{})) {
+                audio_thread_->startThread(juce::Thread::Priority::highest);
+            }
+
+            reply_(number, sandbox_protocol::ok_reply, [this] (state_chunks::writer& writer) { writer.write_int(processor_->getLatencySamples()); });
+        }
+
+        void stop_audio_() {
+            if(audio_thread_ != nullptr) {
+                audio_thread_->stopThread(1000);
+                audio_thread_.reset();
+            }
+        }
+
+        template<typename write_fields_t>
+        void reply_(int number, const char (&reply)[5], write_fields_t&& write_fields) {
+            juce::MemoryBlock message;
+
+            {
+                state_chunks::writer writer(message);
+                writer.begin_chunk(reply);
+                writer.write_int(number);
+                write_fields(writer);
+                writer.end_chunk();
+            }
+
+            sendMessageToCoordinator(message);
+        }
+
+        juce::AudioPluginFormatManager format_manager_;
+        std::unique_ptr<juce::AudioProcessor> processor_;
+        std::unique_ptr<shared_audio_channel> channel_;
+        std::unique_ptr<audio_thread> audio_thread_;
+    };
+
+    //==============================================================================
+    // processes blocks through a sandboxed dummy plugin and checks that they come back with the dummy's gain applied
+    bool process_and_check(sandboxed_plugin_instance& instance, juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) {
+        for(int c = 0; c < buffer.getNumChannels(); ++c) {
+            for(int i = 0; i < buffer.getNumSamples(); ++i) {
+                buffer.setSample(c, i, (float) (i + 1) / (float) buffer.getNumSamples() * (c == 0 ? 1.f : -1.f));
+            }
+        }
+
+        midi.clear();
+        midi.addEvent(juce::MidiMessage::noteOn(1, 60, (juce::uint8) 100), 10);
+
+        instance.processBlock(buffer, midi);
+
+        for(int c = 0; c < buffer.getNumChannels(); ++c) {
+            for(int i = 0; i < buffer.getNumSamples(); ++i) {
+                const float expected = (float) (i + 1) / (float) buffer.getNumSamples() * (c == 0 ? 1.f : -1.f) * dummy_plugin::gain;
+
+                if(std::abs(buffer.getSample(c, i) - expected) > 1.0e-6f) {
+                    return false;
+                }
+            }
+        }
+
+        return midi.getNumEvents() == 1 && midi.getFirstEventTime() == 10;
+    }
+
+    int self_test() {
+        constexpr double sample_rate = 48000.0;
+        constexpr int block_size = 256, number_of_blocks = 5000;
+
+        juce::String error;
+        auto instance = sandboxed_plugin_instance::create(sandboxed_plugin_instance::make_dummy_description(), error);
+
+        if(instance == nullptr) {
+            std::cerr << "couldn't start the sandbox: " << error << std::endl;
+            return exit_failed;
+        }
+
+        instance->setRateAndBufferSizeDetails(sample_rate, block_size);
+        instance->prepareToPlay(sample_rate, block_size);
+
+        juce::AudioBuffer<float> buffer(2, block_size);
+        juce::MidiBuffer midi;
+        midi.ensureSize(1024);
+
+        int wrong_blocks = 0;
+
+        for(int block = 0; block < number_of_blocks; ++block) {
+            if(! process_and_check(*instance, buffer, midi)) {
+                ++wrong_blocks;
+            }
+        }
+
+        const auto cost = instance->get_cost();
+        const auto block_seconds = block_size / sample_rate;
+
+        std::cout << number_of_blocks << " blocks of " << block_size << " samples at " << sample_rate << " Hz (" << block_seconds * 1.0e6 << " us per block)\n"
+                  << "    round trip: " << cost.average_round_trip_seconds * 1.0e6 << " us average, " << cost.peak_round_trip_seconds * 1.0e6 << " us peak\n"
+                  << "    late blocks: " << cost.late_blocks << ", wrong blocks: " << wrong_blocks << std::endl;
+
+        // now crash it, and keep processing (in real time, more or less) until the watchdog has brought it back
+        instance->crash_dummy();
+
+        bool recovered = false;
+
+        for(int waited_ms = 0; waited_ms < 20000 && ! recovered; waited_ms += 5) {
+            recovered = process_and_check(*instance, buffer, midi) && instance->get_cost().restarts > 0;
+            juce::Thread::sleep(5);
+        }
+
+        std::cout << "    after crashing the sandbox: " << (recovered ? "restarted" : "NOT restarted") << " (" << instance->get_cost().restarts << " restarts)" << std::endl;
+
+        instance->releaseResources();
+
+        return wrong_blocks == 0 && cost.peak_round_trip_seconds < block_seconds && recovered ? exit_ok : exit_failed;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    juce::ScopedJuceInitialiser_GUI juce_initialiser; // the sandbox needs a message thread for the plugin, this thread is it
+
+    juce::StringArray arguments;
+    for(int i = 1; i < argc; ++i) {
+        arguments.add(juce::String::fromUTF8(argv[i]));
+    }
+
+    {
+        sandbox worker;
+
+        if(worker.initialiseFromCommandLine(arguments.joinIntoString(" "), sandbox_protocol::command_line_id)) {
+            juce::MessageManager::getInstance()->runDispatchLoop(); // until the wrapper goes away
+            return exit_ok;
+        }
+    }
+
+    if(arguments.contains("--self-test")) {
+        return self_test();
+    }
+
+    std::cerr << "this is started by HostPluginDemo-cmake for plugins that run sandboxed. Run it with --self-test to try it out" << std::endl;
+    return exit_failed;
+}
@@ -0,0 +1,333 @@
+#include "plugin_scan_cache.h"
+
+#include "state_chunks.h"
+
+#include <set>
+
+namespace {
+    constexpr char scan_record[5] = "SCAN";
+    constexpr char gone_record[5] = "GONE";
+
+    constexpr int maximum_fingerprint_files = 256; // bundles are directories, this caps how many of the files in one we look at
+}
+
+plugin_scan_cache::plugin_scan_cache(const juce::File& file) : file_(file),
+                                                               file_lock_("HostPluginDemo-cmake_plugin_scan_cache") {
+    load_();
+}
+
+juce::String plugin_scan_cache::key_(const juce::String& format_name, const juce::String& file_or_identifier) {
+    return format_name + "\n" + file_or_identifier;
+}
+
+void plugin_scan_cache::fingerprint_(const juce::String& file_or_identifier, juce::int64& modification_time, juce::int64& size) {
+    modification_time = size = 0;
+
+    if(! juce::File::isAbsolutePath(file_or_identifier)) {
+        return;
+    }
+
+    const juce::File file(file_or_identifier);
+
+    if(file.existsAsFile()) {
+        modification_time = file.getLastModificationTime().toMilliseconds();
+        size = file.getSize();
+    }
+    else if(file.isDirectory()) {
+        // a bundle. Updating a plugin doesn't necessarily touch the bundle directory itself, so look at what's inside
+        modification_time = file.getLastModificationTime().toMilliseconds();
+
+        int number_of_files = 0;
+
+        for(const auto& child : juce::RangedDirectoryIterator(file, true, "*", juce::File::findFiles)) {
+            modification_time = juce::jmax(modification_time, child.getModificationTime().toMilliseconds());
+            size += child.getFileSize();
+
+            if(++number_of_files >= maximum_fingerprint_files) {
+                break;
+            }
+        }
+    }
+}
+
+bool plugin_scan_cache::lookup(const juce::String& format_name, const juce::String& file_or_identifier, juce::OwnedArray<juce::PluginDescription>& descriptions, bool& ok) const {
+    juce::String descriptions_xml;
+    juce::int64 cached_modification_time = 0, cached_size = 0;
+
+    {
+        const juce::ScopedLock sl(lock_);
+
+        const auto found = entries_.find(key_(format_name, file_or_identifier));
+
+        if(found == entries_.end()) {
+            return false;
+        }
+
+        descriptions_xml = found->second.descriptions_xml;
+        cached_modification_time = found->second.modification_time;
+        cached_size = found->second.size;
+        ok = found->second.ok;
+    }
+
+    juce::int64 modification_time, size;
+    fingerprint_(file_or_identifier, modification_time, size);
+
+    if(modification_time != cached_modification_time || size != cached_size) {
+        return false;
+    }
+
+    if(auto xml = juce::parseXML(descriptions_xml)) {
+        for(auto* description_node : xml->getChildIterator()) {
+            auto description = std::make_unique<juce::PluginDescription>();
+
+            if(description->loadFromXml(*description_node)) {
+                descriptions.add(description.release());
+            }
+        }
+    }
+
+    return true;
+}
+
+void plugin_scan_cache::store(const juce::String& format_name, const juce::String& file_or_identifier, const juce::OwnedArray<juce::PluginDescription>& descriptions, bool ok) {
+    entry e;
+    e.format_name = format_name;
+    e.file_or_identifier = file_or_identifier;
+    e.ok = ok;
+    fingerprint_(file_or_identifier, e.modification_time, e.size);
+
+    juce::XmlElement xml("PLUGINS");
+    for(auto* description : descriptions) {
+        xml.addChildElement(description->createXml().release());
+    }
+
+    e.descriptions_xml = xml.toString(juce::XmlElement::TextFormat().singleLine().withoutHeader());
+
+    juce::MemoryBlock record;
+    write_scan_record_(record, e);
+
+    const juce::ScopedLock sl(lock_);
+
+    entries_[key_(format_name, file_or_identifier)] = std::move(e);
+    append_(record);
+}
+
+void plugin_scan_cache::forget(const juce::String& format_name, const juce::String& file_or_identifier) {
+    const juce::ScopedLock sl(lock_);
+
+    if(entries_.erase(key_(format_name, file_or_identifier)) == 0) {
+        return;
+    }
+
+    juce::MemoryBlock record;
+    write_gone_record_(record, format_name, file_or_identifier);
+    append_(record);
+}
+
+void plugin_scan_cache::clear() {
+    const juce::ScopedLock sl(lock_);
+
+    entries_.clear();
+
+    const juce::InterProcessLock::ScopedLockType file_sl(file_lock_);
+    write_file_(); // everyone's entries, that's what clearing is for
+}
+
+void plugin_scan_cache::fill_list(juce::KnownPluginList& list) const {
+    const juce::ScopedLock sl(lock_);
+
+    for(const auto& [key, e] : entries_) {
+        if(! e.ok) {
+            list.addToBlacklist(e.file_or_identifier);
+            continue;
+        }
+
+        if(auto xml = juce::parseXML(e.descriptions_xml)) {
+            for(auto* description_node : xml->getChildIterator()) {
+                juce::PluginDescription description;
+
+                if(description.loadFromXml(*description_node)) {
+                    list.addType(description);
+                }
+            }
+        }
+    }
+}
+
+void plugin_scan_cache::sync_with(const juce::KnownPluginList& list) {
+    std::set<juce::String> listed; // everything that's still in the list or its blacklist
+    for(const auto& description : list.getTypes()) {
+        listed.insert(key_(description.pluginFormatName, description.fileOrIdentifier));
+    }
+
+    const auto& blacklist = list.getBlacklistedFiles();
+
+    const juce::ScopedLock sl(lock_);
+
+    juce::MemoryBlock records;
+    std::size_t number_of_records = 0;
+
+    for(auto it = entries_.begin(); it != entries_.end();) {
+        const auto& e = it->second;
+        const bool still_there = e.ok ? listed.count(it->first) > 0 : blacklist.contains(e.file_or_identifier);
+
+        // entries that were ok but had no plugins in them (e.g. a shell that's currently empty) can't show up in the list at all, so leave those alone
+        if(still_there || (e.ok && e.descriptions_xml.contains("<PLUGINS/>"))) {
+            ++it;
+            continue;
+        }
+
+        write_gone_record_(records, e.format_name, e.file_or_identifier);
+        ++number_of_records;
+        it = entries_.erase(it);
+    }
+
+    if(records.getSize() > 0) {
+        append_(records, number_of_records);
+    }
+}
+
+void plugin_scan_cache::store_all(const juce::KnownPluginList& list) {
+    std::map<juce::String, juce::OwnedArray<juce::PluginDescription>> by_binary;
+
+    for(const auto& description : list.getTypes()) {
+        by_binary[key_(description.pluginFormatName, description.fileOrIdentifier)].add(new juce::PluginDescription(description));
+    }
+
+    for(const auto& [key, descriptions] : by_binary) {
+        store(descriptions.getFirst()->pluginFormatName, descriptions.getFirst()->fileOrIdentifier, descriptions, true);
+    }
+
+    for(const auto& file_or_identifier : list.getBlacklistedFiles()) {
+        store({}, file_or_identifier, {}, false);
+    }
+}
+
+void plugin_scan_cache::load_() {
+    const juce::ScopedLock sl(lock_);
+    const juce::InterProcessLock::ScopedLockType file_sl(file_lock_);
+
+    entries_.clear();
+    records_in_file_ = 0;
+
+    if(read_file_()) {
+        write_file_();
+    }
+}
+
+void plugin_scan_cache::append_(const juce::MemoryBlock& records, std::size_t number_of_records) {
+    const juce::InterProcessLock::ScopedLockType file_sl(file_lock_);
+
+    if(! file_.existsAsFile()) {
+        write_file_(); // there's nothing on disk to lose. Writes the header along with everything we know, which includes these records
+        return;
+    }
+
+    {
+        juce::FileOutputStream stream(file_); // appends
+
+        if(! stream.openedOk()) {
+            return;
+        }
+
+        stream.write(records.getData(), records.getSize());
+        records_in_file_ += number_of_records;
+    }
+
+    // records_in_file_ doesn't count what other processes appended since we last read the file, so this can only be late. read_file_ counts them all before we compact
+    if(is_mostly_superseded_() && read_file_()) {
+        write_file_();
+    }
+}
+
+bool plugin_scan_cache::read_file_() {
+    juce::MemoryBlock data;
+
+    if(! file_.loadFileAsData(data) || ! state_chunks::is_binary(data.getData(), data.getSize())) {
+        return false;
+    }
+
+    entries_.clear();
+    records_in_file_ = 0;
+
+    state_chunks::reader reader(data.getData(), data.getSize());
+
+    while(reader.next_chunk()) {
+        ++records_in_file_;
+
+        if(reader.chunk_is(scan_record)) {
+            entry e;
+            e.format_name = reader.read_string();
+            e.file_or_identifier = reader.read_string();
+            e.modification_time = reader.read_int64(0);
+            e.size = reader.read_int64(0);
+            e.ok = reader.read_bool(false);
+            e.descriptions_xml = reader.read_string();
+
+            entries_[key_(e.format_name, e.file_or_identifier)] = std::move(e);
+        }
+        else if(reader.chunk_is(gone_record)) {
+            const auto format_name = reader.read_string();
+            entries_.erase(key_(format_name, reader.read_string()));
+        }
+    }
+
+    // a torn record at the end (e.g. the host crashed halfway through an append), or lots of superseded records. Either way, write what we've got from scratch
+    return reader.get_next_chunk_offset() != data.getSize() || is_mostly_superseded_();
+}
+
+void plugin_scan_cache::write_file_() {
+    juce::MemoryBlock data;
+
+    {
+        state_chunks::writer writer(data); // just the header
+    }
+
+    for(const auto& [key, e] : entries_) {
+        write_scan_record_(data, e);
+    }
+
+    file_.getParentDirectory().createDirectory();
+
+    juce::TemporaryFile temporary(file_);
+
+    if(temporary.getFile().replaceWithData(data.getData(), data.getSize())) {
+        temporary.overwriteTargetFileWithTemporary(); // so a crash in the middle never leaves a half written cache
+    }
+
+    records_in_file_ = entries_.size();
+}
+
+void plugin_scan_cache::write_scan_record_(juce::MemoryBlock& destination, const entry& e) {
+    juce::MemoryBlock record;
+
+    {
+        state_chunks::writer writer(record, false);
+
+        writer.begin_chunk(scan_record);
+        writer.write_string(e.format_name);
+        writer.write_string(e.file_or_identifier);
+        writer.write_int64(e.modification_time);
+        writer.write_int64(e.size);
+        writer.write_bool(e.ok);
+        writer.write_string(e.descriptions_xml);
+        writer.end_chunk();
+    }
+
+    destination.append(record.getData(), record.getSize());
+}
+
+void plugin_scan_cache::write_gone_record_(juce::MemoryBlock& destination, const juce::String& format_name, const juce::String& file_or_identifier) {
+    juce::MemoryBlock record;
+
+    {
+        state_chunks::writer writer(record, false);
+
+        writer.begin_chunk(gone_record);
+        writer.write_string(format_name);
+        writer.write_string(file_or_identifier);
+        writer.end_chunk();
+    }
+
+    destination.append(record.getData(), record.getSize());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <map>
+
+/**
+ * remembers what scanning each plugin binary found, so a rescan only has to load the binaries that actually changed
+ *
+ * entries are keyed by format name + file (or identifier), and carry the binary's modification time and size
+ * if either of those changed since the entry was written, the entry is stale and the binary gets scanned again
+ * (identifiers that aren't files, e.g. AudioUnit component ids, have no fingerprint, so they stay cached until they're forgotten or the cache is cleared)
+ *
+ * on disk it's an append only log of state_chunks records ("SCAN" for a result, "GONE" when an entry is forgotten), behind the usual HPDS header
+ * writing a result appends one small record instead of rewriting the whole plugin list. The log is read into an in memory index when the cache is opened,
+ * and compacted when more than half of it is superseded records, then or later on
+ * appends and compaction are guarded by an InterProcessLock, because every instance of the wrapper (in every host) shares the same file
+ * compaction reads the whole log again under that lock first, so it never drops what other processes appended since this one read it
+ *
+ * every member function can be called from any thread, the scanner calls lookup/store from its scanning threads
+ */
+class plugin_scan_cache {
+public:
+    explicit plugin_scan_cache(const juce::File& file);
+
+    plugin_scan_cache(const plugin_scan_cache&) = delete;
+    plugin_scan_cache& operator=(const plugin_scan_cache&) = delete;
+
+    /// true if there's an entry for this binary and the binary hasn't changed since. ok is false if scanning it failed last time (e.g. it crashed the scanner)
+    bool lookup(const juce::String& format_name, const juce::String& file_or_identifier, juce::OwnedArray<juce::PluginDescription>& descriptions, bool& ok) const;
+
+    void store(const juce::String& format_name, const juce::String& file_or_identifier, const juce::OwnedArray<juce::PluginDescription>& descriptions, bool ok);
+
+    void forget(const juce::String& format_name, const juce::String& file_or_identifier);
+
+    /// forgets everything, so the next scan loads every binary again
+    void clear();
+
+    inline bool is_empty() const { const juce::ScopedLock sl (lock_); return entries_.empty(); }
+
+    /// adds every cached plugin to list, and every binary that failed to its blacklist
+    void fill_list(juce::KnownPluginList& list) const;
+
+    /// forgets the entries of everything that's been removed from list (or its blacklist), e.g. by the user in the PluginListComponent
+    void sync_with(const juce::KnownPluginList& list);
+
+    /// writes every plugin in list, for when there's an old plugin list to migrate but no cache yet
+    void store_all(const juce::KnownPluginList& list);
+
+private:
+    struct entry {
+        juce::String format_name, file_or_identifier;
+        juce::int64 modification_time = 0, size = 0;
+        bool ok = true;
+        juce::String descriptions_xml; // <PLUGINS>, parsed when it's needed
+    };
+
+    static void fingerprint_(const juce::String& file_or_identifier, juce::int64& modification_time, juce::int64& size);
+    static juce::String key_(const juce::String& format_name, const juce::String& file_or_identifier);
+
+    void load_();
+    void append_(const juce::MemoryBlock& records, std::size_t number_of_records = 1);
+
+    // the caller holds file_lock_ for both of these
+    /// replaces entries_ with what's in the file, if there is one. Returns true if the file should be compacted (a torn record at the end, or lots of superseded ones)
+    bool read_file_();
+    /// writes entries_ from scratch
+    void write_file_();
+    inline bool is_mostly_superseded_() const noexcept { return records_in_file_ > 2 * entries_.size() + 64; }
+
+    static void write_scan_record_(juce::MemoryBlock& destination, const entry& e);
+    static void write_gone_record_(juce::MemoryBlock& destination, const juce::String& format_name, const juce::String& file_or_identifier);
+
+    juce::CriticalSection lock_;
+    juce::File file_;
+    juce::InterProcessLock file_lock_;
+    std::map<juce::String, entry> entries_;
+    std::size_t records_in_file_ = 0;
+};
@@ -0,0 +1,58 @@
+/**
+ * HostPluginDemo-cmake-scanner
+ *
+ * scans one plugin binary and exits, so that a plugin that crashes (or hangs) while it's being scanned can't take the host down with it
+ * started by out_of_process_scanner as
+ *     HostPluginDemo-cmake-scanner --scan <format name> <file or identifier> <output file>
+ * and writes a <PLUGINS> element with a <PLUGIN> for every type it found to the output file
+ *
+ * exit codes: 0 if the binary was scanned (even if it contained no plugins), 1 if it couldn't be, 2 if this build doesn't know the format
+ */
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <iostream>
+
+namespace {
+    constexpr int exit_ok = 0, exit_failed = 1, exit_unknown_format = 2; // out_of_process_scanner.cpp relies on these
+}
+
+int main(int argc, char* argv[]) {
+    juce::ArgumentList arguments(argc, argv);
+
+    if(arguments.size() != 4 || arguments[0].text != "--scan") {
+        std::cerr << "usage: HostPluginDemo-cmake-scanner --scan <format name> <file or identifier> <output file>" << std::endl;
+        return exit_failed;
+    }
+
+    const auto format_name = arguments[1].text;
+    const auto file_or_identifier = arguments[2].text;
+    const juce::File output_file(arguments[3].text);
+
+    juce::ScopedJuceInitialiser_GUI juce_initialiser; // some formats need a message manager to create instances, this thread is its message thread
+
+    juce::AudioPluginFormatManager format_manager;
+    format_manager.addDefaultFormats();
+
+    juce::AudioPluginFormat* format = nullptr;
+
+    for(auto* candidate : format_manager.getFormats()) {
+        if(candidate->getName() == format_name) {
+            format = candidate;
+        }
+    }
+
+    if(format == nullptr) {
+        return exit_unknown_format;
+    }
+
+    juce::OwnedArray<juce::PluginDescription> found;
+    format->findAllTypesForFile(found, file_or_identifier);
+
+    juce::XmlElement xml("PLUGINS");
+    for(auto* description : found) {
+        xml.addChildElement(description->createXml().release());
+    }
+
+    return xml.writeTo(output_file) ? exit_ok : exit_failed;
+}
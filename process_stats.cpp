@@ -0,0 +1,155 @@
+#include "process_stats.h"
+
+#include <cmath>
+
+double process_stats::snapshot::get_percentile_us(double p) const noexcept {
+    if(blocks == 0) {
+        return 0.0;
+    }
+
+    const auto target = (std::uint64_t) std::ceil(juce::jlimit(0.0, 1.0, p) * (double) blocks);
+    std::uint64_t count = 0;
+
+    for(int bucket = 0; bucket < number_of_buckets; ++bucket) {
+        count += histogram[(std::size_t) bucket];
+
+        if(count >= target && count > 0) {
+            const double middle_ns = 0.5 * (get_bucket_start_ns(bucket) + get_bucket_end_ns(bucket));
+            return juce::jmin(middle_ns * 0.001, worst_us);
+        }
+    }
+
+    return worst_us; // the snapshot's counts were a little behind blocks
+}
+
+juce::var process_stats::snapshot::to_var() const {
+    auto* object = new juce::DynamicObject();
+
+    object->setProperty("blocks", (juce::int64) blocks);
+    object->setProperty("overruns", (juce::int64) overruns);
+    object->setProperty("swaps", (juce::int64) swaps);
+    object->setProperty("mean_us", mean_us);
+    object->setProperty("p50_us", get_percentile_us(0.5));
+    object->setProperty("p90_us", get_percentile_us(0.9));
+    object->setProperty("p99_us", get_percentile_us(0.99));
+    object->setProperty("p999_us", get_percentile_us(0.999));
+    object->setProperty("worst_us", worst_us);
+    object->setProperty("mean_budget", mean_budget);
+    object->setProperty("worst_budget", worst_budget);
+    object->setProperty("slept_blocks", (juce::int64) slept_blocks);
+    object->setProperty("saved_us", saved_us);
+
+    // only the buckets that have something in them, as [start_us, end_us, count]
+    juce::Array<juce::var> histogram_var;
+
+    for(int bucket = 0; bucket < number_of_buckets; ++bucket) {
+        if(histogram[(std::size_t) bucket] > 0) {
+            histogram_var.add(juce::Array<juce::var> { get_bucket_start_ns(bucket) * 0.001, get_bucket_end_ns(bucket) * 0.001, (juce::int64) histogram[(std::size_t) bucket] });
+        }
+    }
+
+    object->setProperty("histogram", histogram_var);
+
+    return juce::var(object);
+}
+
+void process_stats::prepare(double sample_rate) noexcept {
+    ns_per_tick_ = 1.0e9 / (double) juce::Time::getHighResolutionTicksPerSecond();
+    ns_per_sample_ = sample_rate > 0.0 ? 1.0e9 / sample_rate : 0.0;
+}
+
+void process_stats::reset() noexcept {
+    for(auto& bucket : histogram_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    for(auto* counter : { &blocks_, &overruns_, &swaps_, &total_ns_, &worst_ns_, &total_budget_ppm_, &worst_budget_ppm_, &slept_blocks_, &slept_ns_ }) {
+        counter->store(0, std::memory_order_relaxed);
+    }
+}
+
+process_stats::snapshot process_stats::get_snapshot() const noexcept {
+    snapshot s;
+
+    for(std::size_t bucket = 0; bucket < histogram_.size(); ++bucket) {
+        s.histogram[bucket] = histogram_[bucket].load(std::memory_order_relaxed);
+    }
+
+    s.blocks = blocks_.load(std::memory_order_relaxed);
+    s.overruns = overruns_.load(std::memory_order_relaxed);
+    s.swaps = swaps_.load(std::memory_order_relaxed);
+    s.worst_us = (double) worst_ns_.load(std::memory_order_relaxed) * 0.001;
+    s.worst_budget = (double) worst_budget_ppm_.load(std::memory_order_relaxed) * 1.0e-6;
+
+    if(s.blocks > 0) {
+        s.mean_us = (double) total_ns_.load(std::memory_order_relaxed) * 0.001 / (double) s.blocks;
+        s.mean_budget = (double) total_budget_ppm_.load(std::memory_order_relaxed) * 1.0e-6 / (double) s.blocks;
+    }
+
+    s.slept_blocks = slept_blocks_.load(std::memory_order_relaxed);
+    s.saved_us = juce::jmax(0.0, (double) s.slept_blocks * s.mean_us - (double) slept_ns_.load(std::memory_order_relaxed) * 0.001);
+
+    return s;
+}
+
+double process_stats::get_bucket_start_ns(int bucket) noexcept {
+    if(bucket < 4) {
+        return (double) bucket;
+    }
+
+    const int msb = bucket / 4 + 1;
+    return (double) ((std::uint64_t) (4 + bucket % 4) << (msb - 2));
+}
+
+double process_stats::get_bucket_end_ns(int bucket) noexcept {
+    if(bucket < 4) {
+        return (double) bucket + 1.0;
+    }
+
+    const int msb = bucket / 4 + 1;
+    return (double) ((std::uint64_t) (5 + bucket % 4) << (msb - 2));
+}
+
+int process_stats::get_bucket_(std::uint64_t ns) noexcept {
+    if(ns < 4) {
+        return (int) ns;
+    }
+
+    const auto high = (juce::uint32) (ns >> 32);
+    const int msb = high != 0 ? 32 + juce::findHighestSetBit(high) : juce::findHighestSetBit((juce::uint32) ns);
+
+    // the octave, and the two bits below the top one for where in the octave
+    return juce::jmin(number_of_buckets - 1, 4 * (msb - 1) + (int) ((ns >> (msb - 2)) & 3));
+}
+
+void process_stats::record(std::int64_t started, int number_of_samples) noexcept {
+    const auto elapsed_ticks = juce::jmax((std::int64_t) 0, juce::Time::getHighResolutionTicks() - started);
+    const auto ns = (std::uint64_t) ((double) elapsed_ticks * ns_per_tick_);
+    const double budget_ns = (double) number_of_samples * ns_per_sample_;
+    const auto budget_ppm = budget_ns > 0.0 ? (std::uint64_t) ((double) ns * 1.0e6 / budget_ns) : 0;
+
+    histogram_[(std::size_t) get_bucket_(ns)].fetch_add(1, std::memory_order_relaxed);
+    blocks_.fetch_add(1, std::memory_order_relaxed);
+    total_ns_.fetch_add(ns, std::memory_order_relaxed);
+    total_budget_ppm_.fetch_add(budget_ppm, std::memory_order_relaxed);
+
+    // there's only one writer, so a plain load and store is enough for the maximums
+    if(ns > worst_ns_.load(std::memory_order_relaxed)) {
+        worst_ns_.store(ns, std::memory_order_relaxed);
+    }
+
+    if(budget_ppm > worst_budget_ppm_.load(std::memory_order_relaxed)) {
+        worst_budget_ppm_.store(budget_ppm, std::memory_order_relaxed);
+    }
+
+    if(budget_ppm > 1000000) {
+        overruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void process_stats::record_sleep(std::int64_t started) noexcept {
+    const auto elapsed_ticks = juce::jmax((std::int64_t) 0, juce::Time::getHighResolutionTicks() - started);
+
+    slept_blocks_.fetch_add(1, std::memory_order_relaxed);
+    slept_ns_.fetch_add((std::uint64_t) ((double) elapsed_ticks * ns_per_tick_), std::memory_order_relaxed);
+}
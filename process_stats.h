@@ -0,0 +1,72 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * what a slot costs the audio thread, block by block: a histogram of how long the slot took, the worst block,
+ * how much of the block's real time budget (the time the block lasts) that was, overruns (blocks the slot alone took longer than that) and plugin swaps
+ * blocks the slot's plugin slept through (see inner_plugin_slot::set_silence_threshold) are counted on their own, they'd only drag the histogram down
+ *
+ * the histogram is log spaced, 4 buckets per octave of nanoseconds, so any percentile comes out within about 12% and recording is a couple of shifts
+ * the audio thread records with relaxed atomic adds, it never locks or allocates. There's one writer per slot (whichever thread runs the slot's branch)
+ * readers take a snapshot, which can be a block or two out of step between fields. That doesn't matter for statistics
+ *
+ * the clock is juce::Time::getHighResolutionTicks(), i.e. clock_gettime/QueryPerformanceCounter/mach_absolute_time, which read the cpu's cycle counter without a syscall
+ */
+class process_stats {
+public:
+    static constexpr int number_of_buckets = 4 * 34; // up to ~30 seconds, everything above that goes into the last one
+
+    struct snapshot {
+        std::uint64_t blocks = 0, overruns = 0, swaps = 0;
+        double mean_us = 0.0, worst_us = 0.0;
+        double mean_budget = 0.0, worst_budget = 0.0;   // fractions of the block's duration, so 1 is an overrun
+        std::array<std::uint64_t, number_of_buckets> histogram {};
+
+        std::uint64_t slept_blocks = 0;
+        double saved_us = 0.0; // what the slept blocks would have cost at mean_us, minus what finding out they were silent cost. An estimate
+
+        /// p between 0 and 1. The middle of the bucket the percentile falls into (never more than the worst block)
+        double get_percentile_us(double p) const noexcept;
+
+        juce::var to_var() const; // for JSON
+    };
+
+    /// wherever the slot gets prepared. Nothing else may be recording at the same time
+    void prepare(double sample_rate) noexcept;
+
+    /// any thread. Clears everything, swaps included
+    void reset() noexcept;
+
+    snapshot get_snapshot() const noexcept;
+
+    /// bucket boundaries in nanoseconds
+    static double get_bucket_start_ns(int bucket) noexcept;
+    static double get_bucket_end_ns(int bucket) noexcept;
+
+    // audio thread ----------------------------------------------------------------------------------------------------
+    inline static std::int64_t start() noexcept { return juce::Time::getHighResolutionTicks(); }
+
+    /// started is what start() returned before the work
+    void record(std::int64_t started, int number_of_samples) noexcept;
+
+    inline void count_swap() noexcept { swaps_.fetch_add(1, std::memory_order_relaxed); }
+
+    /// instead of record() for a block the plugin slept through
+    void record_sleep(std::int64_t started) noexcept;
+
+private:
+    static int get_bucket_(std::uint64_t ns) noexcept;
+
+    double ns_per_tick_ = 1.0, ns_per_sample_ = 0.0;
+
+    std::array<std::atomic<std::uint64_t>, number_of_buckets> histogram_ {};
+    std::atomic<std::uint64_t> blocks_ = 0, overruns_ = 0, swaps_ = 0;
+    std::atomic<std::uint64_t> total_ns_ = 0, worst_ns_ = 0;
+    std::atomic<std::uint64_t> total_budget_ppm_ = 0, worst_budget_ppm_ = 0; // parts per million of the block's duration
+    std::atomic<std::uint64_t> slept_blocks_ = 0, slept_ns_ = 0;
+};
@@ -0,0 +1,216 @@
+#include "realtime_worker_pool.h"
+
+#include <thread>
+
+#if JUCE_INTEL
+    #include <emmintrin.h>
+#endif
+
+namespace {
+    inline void cpu_relax() noexcept {
+    #if JUCE_INTEL
+        _mm_pause();
+    #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        __asm__ __volatile__ ("yield");
+    #else
+        std::this_thread::yield();
+    #endif
+    }
+
+    // roughly how long a worker keeps spinning after a run before it goes to sleep
+    // a few tens of microseconds, which covers back to back runs within one block without burning a core between blocks
+    constexpr int spin_iterations = 4096;
+
+    inline std::uint64_t tag(std::uint32_t generation) noexcept { return (std::uint64_t) generation << 32; }
+}
+
+//==============================================================================
+class realtime_worker_pool::worker final : public juce::Thread {
+public:
+    worker(realtime_worker_pool& pool, int queue_index) : juce::Thread("realtime_worker_" + juce::String(queue_index)),
+                                                           pool_(pool),
+                                                           queue_index_(queue_index) {}
+
+    void run() override {
+        std::uint32_t seen = pool_.generation_.load(std::memory_order_acquire);
+        int spins = 0;
+
+        while(! threadShouldExit()) {
+            const std::uint32_t generation = pool_.generation_.load(std::memory_order_acquire);
+
+            if(generation != seen) {
+                seen = generation;
+                pool_.worker_run_(queue_index_, generation);
+                spins = 0;
+                continue;
+            }
+
+            if(++spins < spin_iterations) {
+                cpu_relax();
+                continue;
+            }
+
+            // seq_cst on both sides, so either run() sees us sleeping and signals, or we see its new generation here
+            sleeping_.store(true, std::memory_order_seq_cst);
+
+            if(pool_.generation_.load(std::memory_order_seq_cst) == seen && ! threadShouldExit()) {
+                wake_.wait();
+            }
+
+            sleeping_.store(false, std::memory_order_relaxed);
+            spins = 0;
+        }
+    }
+
+    /// returns true if the worker was asleep
+    inline bool wake() noexcept {
+        if(sleeping_.exchange(false, std::memory_order_seq_cst)) {
+            wake_.signal();
+            return true;
+        }
+
+        return false;
+    }
+
+    void stop() {
+        signalThreadShouldExit();
+        wake_.signal();
+        stopThread(1000);
+    }
+
+private:
+    realtime_worker_pool& pool_;
+    const int queue_index_;
+
+    std::atomic<bool> sleeping_ = false;
+    juce::WaitableEvent wake_; // auto reset. A spurious signal just makes the worker go round the loop one more time
+};
+
+//==============================================================================
+realtime_worker_pool::realtime_worker_pool(int number_of_workers) {
+    number_of_workers = juce::jmax(0, number_of_workers);
+
+    queues_ = std::make_unique<task_queue[]>((std::size_t) number_of_workers + 1);
+
+    for(int worker_i = 0; worker_i < number_of_workers; ++worker_i) {
+        workers_.push_back(std::make_unique<worker>(*this, worker_i + 1)); // queue 0 is the caller's
+    }
+
+    for(auto& w : workers_) {
+        if(! w->startRealtimeThread(juce::Thread::RealtimeOptions{})) {
+            w->startThread(juce::Thread::Priority::highest); // e.g. no permission to go real time, still better than nothing
+        }
+    }
+}
+
+realtime_worker_pool::~realtime_worker_pool() {
+    for(auto& w : workers_) {
+        w->stop();
+    }
+}
+
+int realtime_worker_pool::default_number_of_workers(int maximum_useful_workers) {
+    return juce::jlimit(0, juce::jmax(0, maximum_useful_workers), juce::SystemStats::getNumCpus() - 1);
+}
+
+void realtime_worker_pool::run(int number_of_tasks, task_function task, void* context) noexcept {
+    number_of_tasks = juce::jmin(number_of_tasks, maximum_number_of_tasks);
+
+    if(number_of_tasks <= 0) {
+        return;
+    }
+
+    const int participants = number_of_participants_();
+
+    if(participants == 1 || number_of_tasks == 1) {
+        for(int task_i = 0; task_i < number_of_tasks; ++task_i) {
+            task(context, task_i);
+        }
+
+        return;
+    }
+
+    const std::uint32_t generation = generation_.load(std::memory_order_relaxed) + 1;
+
+    for(int queue_i = 0; queue_i < participants; ++queue_i) {
+        queues_[(std::size_t) queue_i].next.store(tag(generation), std::memory_order_relaxed);
+    }
+
+    number_of_tasks_.store(number_of_tasks, std::memory_order_relaxed);
+    task_.store(task, std::memory_order_relaxed);
+    context_.store(context, std::memory_order_relaxed);
+    remaining_.store(number_of_tasks, std::memory_order_relaxed);
+
+    generation_.store(generation, std::memory_order_seq_cst); // publishes everything above
+
+    // only the workers whose own queue got something need waking, the spinning ones will steal anyway
+    const int workers_with_tasks = juce::jmin(number_of_tasks, participants) - 1;
+
+    for(int worker_i = 0; worker_i < workers_with_tasks; ++worker_i) {
+        workers_[(std::size_t) worker_i]->wake();
+    }
+
+    participate_(0, generation, number_of_tasks, task, context);
+
+    // everything is claimed by now, but a worker might still be running the last branch
+    while(remaining_.load(std::memory_order_acquire) > 0) {
+        cpu_relax();
+    }
+}
+
+bool realtime_worker_pool::try_run(int number_of_tasks, task_function task, void* context) noexcept {
+    if(busy_.exchange(true, std::memory_order_acquire)) {
+        return false;
+    }
+
+    run(number_of_tasks, task, context);
+    busy_.store(false, std::memory_order_release);
+
+    return true;
+}
+
+void realtime_worker_pool::worker_run_(int own_queue, std::uint32_t generation) noexcept {
+    // these might already belong to a newer generation if we're late, but then every claim below fails because of the generation tag
+    const int number_of_tasks = number_of_tasks_.load(std::memory_order_relaxed);
+    auto* task = task_.load(std::memory_order_relaxed);
+    auto* context = context_.load(std::memory_order_relaxed);
+
+    if(task != nullptr) {
+        participate_(own_queue, generation, number_of_tasks, task, context);
+    }
+}
+
+void realtime_worker_pool::participate_(int own_queue, std::uint32_t generation, int number_of_tasks, task_function task, void* context) noexcept {
+    const int participants = number_of_participants_();
+    int task_index = 0;
+
+    for(int offset = 0; offset < participants; ++offset) {
+        const int queue_index = (own_queue + offset) % participants; // offset 0 is our own queue, everything after that is stealing
+
+        while(try_claim_(queue_index, generation, number_of_tasks, task_index)) {
+            task(context, task_index);
+            remaining_.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
+
+bool realtime_worker_pool::try_claim_(int queue_index, std::uint32_t generation, int number_of_tasks, int& task_index) noexcept {
+    const int participants = number_of_participants_();
+    const int tasks_in_queue = queue_index < number_of_tasks ? (number_of_tasks - queue_index + participants - 1) / participants : 0;
+
+    auto& next = queues_[(std::size_t) queue_index].next;
+    std::uint64_t current = next.load(std::memory_order_acquire);
+
+    for(;;) {
+        const auto claimed = (int) (current & 0xffffffffu);
+
+        if((std::uint32_t) (current >> 32) != generation || claimed >= tasks_in_queue) {
+            return false;
+        }
+
+        if(next.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_acquire)) {
+            task_index = queue_index + claimed * participants;
+            return true;
+        }
+    }
+}
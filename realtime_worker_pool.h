@@ -0,0 +1,82 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * a small pool of real time threads that the audio thread can fan work out to, e.g. the parallel branches of the plugin graph
+ *
+ * run() hands out task indices round robin to one queue per participant (every worker, plus the calling thread),
+ * everybody drains their own queue first and then steals from the others, so a branch that's much heavier than the rest doesn't leave the other cores idle
+ * the calling thread always participates, so run() completes even if none of the workers wake up in time (or there are no workers at all)
+ *
+ * run() doesn't allocate or lock. Workers spin for a little while after each run and then go to sleep on an event,
+ * waking a sleeping worker is the only thing that can cost the audio thread a syscall
+ *
+ * every claim is tagged with the run's generation, so a worker that's late to the party can never pick up a task from the next run
+ *
+ * one pool is shared by every wrapper in the process (see plugin_registry::get_workers). Wrappers call try_run, and whoever finds it busy runs its tasks itself
+ */
+class realtime_worker_pool {
+public:
+    using task_function = void (*)(void* context, int task_index);
+
+    static constexpr int maximum_number_of_tasks = 64;
+
+    /// number_of_workers doesn't include the thread calling run(), so 0 is valid and just runs everything on the caller
+    explicit realtime_worker_pool(int number_of_workers);
+
+    /// stops and joins the workers. run() must not be running
+    ~realtime_worker_pool();
+
+    realtime_worker_pool(const realtime_worker_pool&) = delete;
+    realtime_worker_pool& operator=(const realtime_worker_pool&) = delete;
+
+    inline int get_number_of_workers() const noexcept { return (int) workers_.size(); }
+
+    /// audio thread. Calls task(context, i) for every i in [0, number_of_tasks) and returns once they've all finished
+    /// only one thread may be inside run() at a time
+    void run(int number_of_tasks, task_function task, void* context) noexcept;
+
+    /// like run(), but if another thread is inside try_run() already, it returns false straight away without running anything
+    /// for pools that several audio threads share, which then don't have to wait for each other
+    bool try_run(int number_of_tasks, task_function task, void* context) noexcept;
+
+    /// a sensible worker count for this machine: one less than the number of cores (the caller is the last one), capped at maximum_useful_workers
+    static int default_number_of_workers(int maximum_useful_workers);
+
+private:
+    class worker;
+
+    // one per participant. Holds task indices queue_index, queue_index + number_of_participants, ...
+    // the high 32 bits of next are the generation the claim belongs to, the low 32 bits are how many tasks have been claimed from this queue
+    struct alignas(64) task_queue {
+        std::atomic<std::uint64_t> next = 0;
+    };
+
+    /// any thread. Claims and runs tasks (own queue first, then everybody else's) until there's nothing left to claim in this generation
+    void participate_(int own_queue, std::uint32_t generation, int number_of_tasks, task_function task, void* context) noexcept;
+    bool try_claim_(int queue_index, std::uint32_t generation, int number_of_tasks, int& task_index) noexcept;
+
+    /// what a worker does once it's seen a new generation
+    void worker_run_(int own_queue, std::uint32_t generation) noexcept;
+
+    inline int number_of_participants_() const noexcept { return (int) workers_.size() + 1; }
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::unique_ptr<task_queue[]> queues_;                  // workers_.size() + 1 of them, the last one belongs to the caller
+
+    alignas(64) std::atomic<std::uint32_t> generation_ = 0;
+    std::atomic<int> number_of_tasks_ = 0;
+    std::atomic<task_function> task_ = nullptr;
+    std::atomic<void*> context_ = nullptr;
+
+    alignas(64) std::atomic<int> remaining_ = 0;            // tasks of the current generation that haven't finished yet
+    std::atomic<bool> busy_ = false;                        // someone's inside try_run
+
+    JUCE_LEAK_DETECTOR (realtime_worker_pool)
+};
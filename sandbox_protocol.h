@@ -0,0 +1,85 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include "state_chunks.h"
+
+/**
+ * the control messages between the wrapper (sandboxed_plugin_instance) and a sandbox process (plugin_sandbox_main.cpp)
+ *
+ * audio and midi go through a shared_audio_channel, everything else goes through the ChildProcessCoordinator/ChildProcessWorker connection
+ * every message is a state_chunks container with a single chunk, whose id is the command. Its first field is a request number, which the reply echoes,
+ * so a reply that comes in after its request already timed out can't be mistaken for the reply to the next one
+ *
+ *     wrapper -> sandbox                                         sandbox -> wrapper
+ *     OPEN  shared memory name                                   OKAY  (LOAD: name, latency, tail seconds, supported layouts. PREP: latency)
+ *     LOAD  description xml, state bytes                         FAIL  error
+ *     PREP  sample rate, block size, input set, output set       STAT  state bytes
+ *     RELS
+ *     GETS
+ *     SETS  state bytes
+ *     CRSH  (only the dummy plugin does this, to test restarts)
+ *
+ * supported layouts are the main input/output pairs the plugin takes (with its aux buses off, or as they are if it won't), out of the ones in get_layout_candidates,
+ * plugin's default first: a count, then an input set and an output set for each. A channel set is its number of channels, then every channel's ChannelType
+ */
+namespace sandbox_protocol {
+
+constexpr char open_command[5] = "OPEN";
+constexpr char load_command[5] = "LOAD";
+constexpr char prepare_command[5] = "PREP";
+constexpr char release_command[5] = "RELS";
+constexpr char get_state_command[5] = "GETS";
+constexpr char set_state_command[5] = "SETS";
+constexpr char crash_command[5] = "CRSH";
+
+constexpr char ok_reply[5] = "OKAY";
+constexpr char failed_reply[5] = "FAIL";
+constexpr char state_reply[5] = "STAT";
+
+/// passed to ChildProcessCoordinator::launchWorkerProcess / ChildProcessWorker::initialiseFromCommandLine
+constexpr const char* command_line_id = "hpd-sandbox";
+
+/// a plugin built into the sandbox executable, which needs no plugin to be installed. Gain of 0.5, midi passes through
+constexpr const char* dummy_format_name = "HostPluginDemo-cmake sandbox";
+constexpr const char* dummy_plugin_name = "Sandbox Dummy";
+
+inline void write_channel_set(state_chunks::writer& writer, const juce::AudioChannelSet& set) {
+    const auto types = set.getChannelTypes();
+
+    writer.write_int(types.size());
+
+    for(const auto type : types) {
+        writer.write_int((int) type);
+    }
+}
+
+inline juce::AudioChannelSet read_channel_set(state_chunks::reader& reader) {
+    const int number_of_channels = juce::jlimit(0, 64, reader.read_int(0));
+
+    juce::Array<juce::AudioChannelSet::ChannelType> types;
+
+    for(int channel = 0; channel < number_of_channels; ++channel) {
+        types.add((juce::AudioChannelSet::ChannelType) reader.read_int((int) juce::AudioChannelSet::unknown));
+    }
+
+    return juce::AudioChannelSet::channelSetWithChannels(types);
+}
+
+/// the main bus layouts the sandbox asks its plugin about: off (inputs only) and the canonical sets up to 7.1
+/// that's everything channel_adapter::negotiate tries first, apart from the wrapper's own layout when that's an unusual one. It falls back to these then
+inline juce::Array<juce::AudioChannelSet> get_layout_candidates(bool allow_disabled) {
+    juce::Array<juce::AudioChannelSet> candidates;
+
+    if(allow_disabled) {
+        candidates.add(juce::AudioChannelSet::disabled());
+    }
+
+    for(int number_of_channels = 1; number_of_channels <= 8; ++number_of_channels) {
+        candidates.add(juce::AudioChannelSet::canonicalChannelSet(number_of_channels));
+    }
+
+    return candidates;
+}
+
+} // namespace sandbox_protocol
@@ -0,0 +1,486 @@
+#include "sandboxed_plugin_instance.h"
+
+#include "helper_executables.h"
+#include "sandbox_protocol.h"
+
+#include <algorithm>
+
+// juce calls these on the connection's own thread, not the message thread
+class sandboxed_plugin_instance::coordinator final : public juce::ChildProcessCoordinator {
+public:
+    explicit coordinator(sandboxed_plugin_instance& owner) : owner_(owner) {}
+
+    ~coordinator() override {
+        expected_exit_ = true; // we're the ones killing it, that's not a crash
+        killWorkerProcess();
+    }
+
+    void handleMessageFromWorker(const juce::MemoryBlock& message) override {
+        owner_.reply_received_(message);
+    }
+
+    void handleConnectionLost() override {
+        if(! expected_exit_) {
+            owner_.connection_lost_(*this);
+        }
+    }
+
+private:
+    sandboxed_plugin_instance& owner_;
+    std::atomic<bool> expected_exit_ { false };
+};
+
+class sandboxed_plugin_instance::watchdog final : public juce::Thread {
+public:
+    explicit watchdog(sandboxed_plugin_instance& owner) : Thread("sandbox watchdog"),
+                                                          owner_(owner) {}
+
+    void run() override {
+        while(! threadShouldExit()) {
+            wait(100);
+
+            if(owner_.needs_restart_.exchange(false) && ! threadShouldExit()) {
+                owner_.restart_();
+            }
+        }
+    }
+
+private:
+    sandboxed_plugin_instance& owner_;
+};
+
+//==============================================================================
+sandboxed_plugin_instance::sandboxed_plugin_instance(const juce::PluginDescription& description) : AudioPluginInstance(BusesProperties().withInput ("Input",  juce::AudioChannelSet::stereo(), true)
+                                                                                                                                        .withOutput("Output", juce::AudioChannelSet::stereo(), true)),
+                                                                                                   description_(description),
+                                                                                                   watchdog_(std::make_unique<watchdog>(*this)) {
+
+}
+
+sandboxed_plugin_instance::~sandboxed_plugin_instance() {
+    watchdog_->stopThread(load_timeout_ms_); // might be in the middle of a restart
+
+    const juce::ScopedLock sl(control_lock_);
+
+    running_ = false;
+    coordinator_.reset(); // kills the sandbox
+    channel_.reset();
+}
+
+std::unique_ptr<sandboxed_plugin_instance> sandboxed_plugin_instance::create(const juce::PluginDescription& description, juce::String& error) {
+    const auto executable = find_sandbox_executable();
+
+    if(! executable.existsAsFile()) {
+        error = "the sandbox (HostPluginDemo-cmake-sandbox) isn't installed next to the host plugin!";
+        return nullptr;
+    }
+
+    std::unique_ptr<sandboxed_plugin_instance> instance(new sandboxed_plugin_instance(description));
+    instance->executable_ = executable;
+    instance->channel_ = shared_audio_channel::create();
+
+    if(instance->channel_ == nullptr) {
+        error = "sandboxed plugins aren't supported on this platform";
+        return nullptr;
+    }
+
+    {
+        const juce::ScopedLock sl(instance->control_lock_);
+
+        if(! instance->launch_(error)) {
+            return nullptr;
+        }
+    }
+
+    if(instance->supported_layouts_.empty()) {
+        error = "the plugin you're trying to load doesn't support any bus layout the sandbox can pass through!";
+        return nullptr;
+    }
+
+    // the plugin's default, so channel_adapter::negotiate starts from the same layout it would have for the plugin itself
+    BusesLayout plugin_default;
+    plugin_default.inputBuses.add(instance->supported_layouts_.front().first);
+    plugin_default.outputBuses.add(instance->supported_layouts_.front().second);
+    instance->setBusesLayout(plugin_default);
+
+    instance->watchdog_->startThread();
+    return instance;
+}
+
+juce::File sandboxed_plugin_instance::find_sandbox_executable() {
+    return find_helper_executable("HostPluginDemo-cmake-sandbox");
+}
+
+juce::PluginDescription sandboxed_plugin_instance::make_dummy_description() {
+    juce::PluginDescription description;
+
+    description.name = description.descriptiveName = description.fileOrIdentifier = sandbox_protocol::dummy_plugin_name;
+    description.pluginFormatName = sandbox_protocol::dummy_format_name;
+    description.category = "Effect";
+    description.manufacturerName = "HostPluginDemo-cmake";
+    description.version = "1.0";
+    description.uniqueId = description.deprecatedUid = 0x48706453; // 'HpdS'
+    description.numInputChannels = description.numOutputChannels = 2;
+
+    return description;
+}
+
+sandboxed_plugin_instance::cost sandboxed_plugin_instance::get_cost() const {
+    cost c;
+
+    c.blocks = blocks_.load();
+    c.late_blocks = late_blocks_.load();
+    c.restarts = restarts_.load();
+    c.running = running_.load();
+
+    if(c.blocks > 0) {
+        c.average_round_trip_seconds = juce::Time::highResolutionTicksToSeconds(round_trip_ticks_.load()) / (double) c.blocks;
+    }
+
+    c.peak_round_trip_seconds = juce::Time::highResolutionTicksToSeconds(peak_round_trip_ticks_.load());
+
+    const juce::ScopedLock sl(error_lock_);
+    c.error = error_;
+
+    return c;
+}
+
+void sandboxed_plugin_instance::crash_dummy() {
+    if(description_.pluginFormatName != sandbox_protocol::dummy_format_name) {
+        return;
+    }
+
+    const juce::ScopedLock sl(control_lock_);
+
+    juce::MemoryBlock reply;
+    request_(sandbox_protocol::crash_command, [] (state_chunks::writer&) {}, reply, 100); // there won't be a reply
+}
+
+//==============================================================================
+bool sandboxed_plugin_instance::launch_(juce::String& error) {
+    coordinator_.reset();
+
+    auto new_coordinator = std::make_unique<coordinator>(*this);
+
+    if(! new_coordinator->launchWorkerProcess(executable_, sandbox_protocol::command_line_id, ping_timeout_ms_, 0)) {
+        error = "couldn't start the sandbox (" + executable_.getFullPathName() + ")";
+        return false;
+    }
+
+    coordinator_ = std::move(new_coordinator);
+
+    juce::MemoryBlock reply;
+
+    if(! request_(sandbox_protocol::open_command, [this] (state_chunks::writer& writer) { writer.write_string(channel_->get_name()); }, reply, control_timeout_ms_)
+       || ! read_reply_(reply).chunk_is(sandbox_protocol::ok_reply)) {
+        error = "the sandbox couldn't open the shared memory";
+        return false;
+    }
+
+    const auto description = description_.createXml()->toString(juce::XmlElement::TextFormat().singleLine().withoutHeader());
+
+    if(! request_(sandbox_protocol::load_command, [this, &description] (state_chunks::writer& writer) {
+                      writer.write_string(description);
+                      writer.write_bytes(last_state_.getData(), last_state_.getSize());
+                  }, reply, load_timeout_ms_)) {
+        error = "the sandbox crashed (or stopped answering) while it was loading the plugin";
+        return false;
+    }
+
+    auto reader = read_reply_(reply);
+
+    if(! reader.chunk_is(sandbox_protocol::ok_reply)) {
+        error = reader.read_string();
+        return false;
+    }
+
+    reader.read_string(); // the plugin's name, we already know it from the description
+    setLatencySamples(reader.read_int(0));
+    tail_seconds_ = (double) reader.read_float(0.f);
+
+    if(supported_layouts_.empty()) {
+        const int number_of_layouts = juce::jmax(0, reader.read_int(0));
+
+        for(int layout_i = 0; layout_i < number_of_layouts; ++layout_i) {
+            auto input = sandbox_protocol::read_channel_set(reader);
+            auto output = sandbox_protocol::read_channel_set(reader);
+
+            if(input.size() <= shared_audio_channel::maximum_number_of_channels && output.size() <= shared_audio_channel::maximum_number_of_channels) {
+                supported_layouts_.emplace_back(std::move(input), std::move(output));
+            }
+        }
+    }
+
+    return true;
+}
+
+bool sandboxed_plugin_instance::prepare_sandbox_(juce::String& error) {
+    juce::MemoryBlock reply;
+
+    if(! request_(sandbox_protocol::prepare_command, [this] (state_chunks::writer& writer) {
+                      writer.write_float((float) sample_rate_); // every sample rate there is fits in a float exactly
+                      writer.write_int(juce::jmin(block_size_, shared_audio_channel::maximum_block_size));
+                      sandbox_protocol::write_channel_set(writer, getChannelLayoutOfBus(true, 0));
+                      sandbox_protocol::write_channel_set(writer, getChannelLayoutOfBus(false, 0));
+                  }, reply, control_timeout_ms_)) {
+        error = "the sandbox crashed (or stopped answering) while it was preparing the plugin";
+        return false;
+    }
+
+    auto reader = read_reply_(reply);
+
+    if(! reader.chunk_is(sandbox_protocol::ok_reply)) {
+        error = reader.read_string();
+        return false;
+    }
+
+    setLatencySamples(reader.read_int(getLatencySamples()));
+    return true;
+}
+
+bool sandboxed_plugin_instance::request_(const char (&command)[5], const std::function<void(state_chunks::writer&)>& write_fields, juce::MemoryBlock& reply, int timeout_ms) {
+    if(coordinator_ == nullptr) {
+        return false;
+    }
+
+    juce::MemoryBlock message;
+
+    {
+        const juce::ScopedLock sl(reply_lock_);
+
+        ++request_number_;
+        reply_arrived_ = false;
+        reply_event_.reset();
+
+        state_chunks::writer writer(message);
+        writer.begin_chunk(command);
+        writer.write_int((int) request_number_);
+        write_fields(writer);
+        writer.end_chunk();
+    }
+
+    if(! coordinator_->sendMessageToWorker(message)) {
+        return false;
+    }
+
+    reply_event_.wait(timeout_ms); // a lost connection wakes this up too
+
+    const juce::ScopedLock sl(reply_lock_);
+
+    if(! reply_arrived_) {
+        return false;
+    }
+
+    reply = std::move(reply_);
+    return true;
+}
+
+state_chunks::reader sandboxed_plugin_instance::read_reply_(const juce::MemoryBlock& reply) {
+    state_chunks::reader reader(reply.getData(), reply.getSize());
+    reader.next_chunk();
+    reader.read_int(0);
+    return reader;
+}
+
+void sandboxed_plugin_instance::restart_() {
+    const juce::ScopedLock sl(control_lock_);
+
+    running_ = false;
+    ++restarts_;
+
+    juce::String error;
+
+    if(launch_(error) && (! prepared_ || prepare_sandbox_(error))) {
+        running_ = prepared_;
+    }
+
+    // if it didn't work, the slot stays silent. Nothing's going to notice that it's not running, so it won't be restarted again
+    // (a plugin that crashes every time it's loaded would have us restarting it forever otherwise). get_cost tells the editor
+    set_error_(error);
+}
+
+void sandboxed_plugin_instance::reply_received_(const juce::MemoryBlock& reply) {
+    state_chunks::reader reader(reply.getData(), reply.getSize());
+
+    if(! reader.next_chunk()) {
+        return;
+    }
+
+    const auto number = (juce::uint32) reader.read_int(0);
+
+    const juce::ScopedLock sl(reply_lock_);
+
+    if(number != request_number_ || reply_arrived_) {
+        return; // the reply to a request that already timed out
+    }
+
+    reply_ = reply;
+    reply_arrived_ = true;
+    reply_event_.signal();
+}
+
+void sandboxed_plugin_instance::connection_lost_(const coordinator&) {
+    running_ = false;
+    needs_restart_ = true;
+    reply_event_.signal();
+}
+
+void sandboxed_plugin_instance::set_error_(const juce::String& error) {
+    const juce::ScopedLock sl(error_lock_);
+    error_ = error;
+}
+
+//==============================================================================
+void sandboxed_plugin_instance::fillInPluginDescription(juce::PluginDescription& description) const {
+    description = description_; // the description of the plugin in the sandbox, so a saved state refers to that
+}
+
+const juce::String sandboxed_plugin_instance::getName() const {
+    return description_.name;
+}
+
+void sandboxed_plugin_instance::prepareToPlay(double sample_rate, int block_size) {
+    const juce::ScopedLock sl(control_lock_);
+
+    running_ = false;
+    sample_rate_ = sample_rate;
+    block_size_ = block_size;
+    prepared_ = true;
+    missed_blocks_ = 0;
+    midi_out_.ensureSize(shared_audio_channel::midi_capacity);
+
+    juce::String error;
+    running_ = prepare_sandbox_(error);
+    set_error_(error);
+}
+
+void sandboxed_plugin_instance::releaseResources() {
+    const juce::ScopedLock sl(control_lock_);
+
+    running_ = false;
+    prepared_ = false;
+
+    juce::MemoryBlock reply;
+    request_(sandbox_protocol::release_command, [] (state_chunks::writer&) {}, reply, control_timeout_ms_);
+}
+
+void sandboxed_plugin_instance::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) {
+    const int number_of_samples = buffer.getNumSamples();
+
+    if(! running_.load(std::memory_order_acquire)) {
+        missed_blocks_ = 0; // (re)starting, the watchdog already knows
+        buffer.clear();
+        midi.clear();
+        return;
+    }
+
+    const auto block_seconds = (double) number_of_samples / sample_rate_;
+
+    const auto miss = [&] {
+        ++late_blocks_;
+
+        if(++missed_blocks_ * block_seconds > hang_seconds_) {
+            needs_restart_ = true;
+            missed_blocks_ = 0;
+        }
+
+        buffer.clear();
+        midi.clear();
+    };
+
+    if(! channel_->is_idle()) {
+        miss(); // the last block still hasn't come back
+        return;
+    }
+
+    auto& shared = channel_->get();
+
+    const int number_of_inputs = juce::jmin(getTotalNumInputChannels(), buffer.getNumChannels(), shared_audio_channel::maximum_number_of_channels);
+    const int number_of_outputs = juce::jmin(getTotalNumOutputChannels(), buffer.getNumChannels(), shared_audio_channel::maximum_number_of_channels);
+
+    midi_out_.clear();
+
+    for(int start = 0; start < number_of_samples; start += shared_audio_channel::maximum_block_size) {
+        const int length = juce::jmin(shared_audio_channel::maximum_block_size, number_of_samples - start);
+
+        for(int channel = 0; channel < number_of_inputs; ++channel) {
+            std::memcpy(shared.audio[channel], buffer.getReadPointer(channel, start), sizeof(float) * (std::size_t) length);
+        }
+
+        shared.number_of_input_channels = number_of_inputs;
+        shared.number_of_output_channels = number_of_outputs;
+        shared.number_of_samples = length;
+        shared.midi_bytes = shared_audio_channel::write_midi(midi, start, length, shared.midi, shared_audio_channel::midi_capacity);
+
+        const auto started = juce::Time::getHighResolutionTicks();
+
+        if(! channel_->exchange(round_trip_budget * (double) length / sample_rate_)) {
+            miss();
+            return;
+        }
+
+        const auto ticks = juce::Time::getHighResolutionTicks() - started;
+        round_trip_ticks_ += ticks;
+
+        for(auto peak = peak_round_trip_ticks_.load(); ticks > peak && ! peak_round_trip_ticks_.compare_exchange_weak(peak, ticks);) {}
+
+        for(int channel = 0; channel < number_of_outputs; ++channel) {
+            std::memcpy(buffer.getWritePointer(channel, start), shared.audio[channel], sizeof(float) * (std::size_t) length);
+        }
+
+        for(int channel = number_of_outputs; channel < buffer.getNumChannels(); ++channel) {
+            buffer.clear(channel, start, length);
+        }
+
+        shared_audio_channel::read_midi(shared.midi, juce::jlimit(0, shared_audio_channel::midi_capacity, shared.midi_bytes), midi_out_, start);
+    }
+
+    ++blocks_;
+    missed_blocks_ = 0;
+
+    // not swapWith, the host's buffer keeps its own storage, and midi_out_ keeps the room prepareToPlay made in it
+    midi.clear();
+    midi.addEvents(midi_out_, 0, -1, 0);
+}
+
+bool sandboxed_plugin_instance::isBusesLayoutSupported(const BusesLayout& layout) const {
+    // what the plugin in the sandbox said it supports when it was loaded. Before that (i.e. in the constructor), anything goes
+    if(supported_layouts_.empty()) {
+        return true;
+    }
+
+    const std::pair<juce::AudioChannelSet, juce::AudioChannelSet> main { layout.getMainInputChannelSet(), layout.getMainOutputChannelSet() };
+    return std::find(supported_layouts_.begin(), supported_layouts_.end(), main) != supported_layouts_.end();
+}
+
+double sandboxed_plugin_instance::getTailLengthSeconds() const {
+    return tail_seconds_;
+}
+
+void sandboxed_plugin_instance::getStateInformation(juce::MemoryBlock& destination) {
+    const juce::ScopedLock sl(control_lock_);
+
+    juce::MemoryBlock reply;
+
+    if(request_(sandbox_protocol::get_state_command, [] (state_chunks::writer&) {}, reply, control_timeout_ms_)) {
+        auto reader = read_reply_(reply);
+
+        const void* state = nullptr;
+        std::size_t state_size = 0;
+
+        if(reader.chunk_is(sandbox_protocol::state_reply) && reader.read_bytes(state, state_size)) {
+            last_state_.replaceAll(state, state_size);
+        }
+    }
+
+    destination.append(last_state_.getData(), last_state_.getSize()); // if the sandbox is down, the last state we know of is still better than nothing
+}
+
+void sandboxed_plugin_instance::setStateInformation(const void* data, int size) {
+    const juce::ScopedLock sl(control_lock_);
+
+    last_state_.replaceAll(data, (std::size_t) size);
+
+    juce::MemoryBlock reply;
+    request_(sandbox_protocol::set_state_command, [this] (state_chunks::writer& writer) { writer.write_bytes(last_state_.getData(), last_state_.getSize()); }, reply, control_timeout_ms_);
+}
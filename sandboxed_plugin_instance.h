@@ -0,0 +1,148 @@
+#pragma once
+
+#include <juce_audio_processors/juce_audio_processors.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "shared_audio_channel.h"
+#include "state_chunks.h"
+
+/**
+ * an inner plugin that runs in its own process (HostPluginDemo-cmake-sandbox, see plugin_sandbox_main.cpp), so when it crashes it doesn't take the DAW down with it
+ *
+ * to the rest of the wrapper it's just another AudioPluginInstance, so it goes into a slot like any other plugin
+ * processBlock hands every block to the sandbox through a shared_audio_channel and waits for it to come back, in the same block,
+ * so the sandbox adds no latency. It waits for round_trip_budget of the block's duration at most, a block that doesn't come back by then is output as silence
+ * (so a slow sandbox makes the block late by that much at worst, and leaves the rest of it to the plugins after this one)
+ * the control calls (loading, state, prepare/release) go through a ChildProcessCoordinator connection and block until the sandbox answers
+ *
+ * which layouts it supports is up to the plugin in the sandbox, which tells us when it's loaded (see sandbox_protocol.h). Its default layout is the plugin's
+ * if the sandbox can't be prepared (or restarted), it stays silent, and get_cost says why
+ *
+ * if the sandbox crashes, or stops answering for a couple of seconds, a watchdog thread restarts it and reloads the plugin with the last state it knew about
+ * (the state from the last get/setStateInformation), then prepares it again. The slot is silent until that's done
+ *
+ * what doesn't go through (yet): the plugin's editor and its parameters. A sandboxed plugin has neither, as far as the host is concerned
+ */
+class sandboxed_plugin_instance final : public juce::AudioPluginInstance {
+public:
+    /// how the round trips have been going. Times are wall clock, from handing the block over to getting it back
+    struct cost {
+        juce::int64 blocks = 0, late_blocks = 0; // late blocks didn't come back in time, and were output as silence
+        int restarts = 0;
+        double average_round_trip_seconds = 0.0, peak_round_trip_seconds = 0.0;
+        bool running = false;                    // false while the sandbox is (re)starting, or if it couldn't be started at all
+        juce::String error;                      // why it couldn't, if it couldn't
+    };
+
+    /// how much of a block's duration processBlock waits for the sandbox
+    static constexpr double round_trip_budget = 0.5;
+
+    /// launches a sandbox and loads description into it. Blocks until that's done, so the loader calls it from one of its threads. Null (with error set) if it didn't work
+    static std::unique_ptr<sandboxed_plugin_instance> create(const juce::PluginDescription& description, juce::String& error);
+
+    /// the sandbox executable that lives next to the executable this is running in (or a few levels up, see out_of_process_scanner::find_scanner_executable)
+    static juce::File find_sandbox_executable();
+
+    /// the plugin that's built into the sandbox executable (see sandbox_protocol::dummy_format_name), for trying all this out without any plugins installed
+    static juce::PluginDescription make_dummy_description();
+
+    ~sandboxed_plugin_instance() override;
+
+    cost get_cost() const;
+
+    /// makes the sandbox crash, if the dummy plugin is what's loaded in it. For testing the restart
+    void crash_dummy();
+
+    //==============================================================================
+    void fillInPluginDescription(juce::PluginDescription& description) const override;
+    const juce::String getName() const override;
+
+    void prepareToPlay(double sample_rate, int block_size) override;
+    void releaseResources() override;
+    void processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midi) override;
+    using juce::AudioPluginInstance::processBlock;
+
+    bool isBusesLayoutSupported(const BusesLayout& layout) const override;
+
+    double getTailLengthSeconds() const override;
+    bool acceptsMidi() const override { return true; }
+    bool producesMidi() const override { return true; }
+
+    bool hasEditor() const override { return false; }
+    juce::AudioProcessorEditor* createEditor() override { return nullptr; }
+
+    int getNumPrograms() override { return 1; }
+    int getCurrentProgram() override { return 0; }
+    void setCurrentProgram(int) override {}
+    const juce::String getProgramName(int) override { return {}; }
+    void changeProgramName(int, const juce::String&) override {}
+
+    void getStateInformation(juce::MemoryBlock& destination) override;
+    void setStateInformation(const void* data, int size) override;
+
+private:
+    class coordinator;
+    class watchdog;
+
+    static constexpr int ping_timeout_ms_ = 5000;
+    static constexpr int control_timeout_ms_ = 10000;
+    static constexpr int load_timeout_ms_ = 60000;       // big sample libraries take a while
+    static constexpr double hang_seconds_ = 2.0;         // this long without a block coming back means the sandbox is hung
+
+    explicit sandboxed_plugin_instance(const juce::PluginDescription& description);
+
+    // all of these expect control_lock_ to be held
+    bool launch_(juce::String& error);
+    bool prepare_sandbox_(juce::String& error);
+    bool request_(const char (&command)[5], const std::function<void(state_chunks::writer&)>& write_fields, juce::MemoryBlock& reply, int timeout_ms);
+
+    /// a reader positioned after the reply's request number
+    static state_chunks::reader read_reply_(const juce::MemoryBlock& reply);
+
+    void restart_();                                    // watchdog thread
+    void reply_received_(const juce::MemoryBlock& reply); // connection thread
+    void connection_lost_(const coordinator& lost);     // connection thread
+    void set_error_(const juce::String& error);
+
+    juce::PluginDescription description_;
+    juce::File executable_;
+
+    juce::CriticalSection control_lock_;
+    std::unique_ptr<coordinator> coordinator_;
+    std::unique_ptr<shared_audio_channel> channel_;
+    std::unique_ptr<watchdog> watchdog_;
+
+    // the request that's waiting for a reply
+    juce::CriticalSection reply_lock_;
+    juce::uint32 request_number_ = 0;
+    juce::MemoryBlock reply_;
+    bool reply_arrived_ = false;
+    juce::WaitableEvent reply_event_;
+
+    // the plugin's main input/output pairs, plugin's default first. The first launch fills this in, before anyone else can see the instance, restarts load the same plugin
+    std::vector<std::pair<juce::AudioChannelSet, juce::AudioChannelSet>> supported_layouts_;
+
+    juce::CriticalSection error_lock_;
+    juce::String error_;                                // see cost::error
+
+    juce::MemoryBlock last_state_;                      // what a restarted sandbox gets
+    double sample_rate_ = 44100.0;
+    int block_size_ = 512;
+    bool prepared_ = false;
+    double tail_seconds_ = 0.0;
+
+    std::atomic<bool> running_ { false };               // the audio thread only touches the channel while this is true
+    std::atomic<bool> needs_restart_ { false };
+    int missed_blocks_ = 0;                             // audio thread
+    juce::MidiBuffer midi_out_;                         // audio thread, preallocated in prepareToPlay
+
+    std::atomic<juce::int64> blocks_ { 0 }, late_blocks_ { 0 }, round_trip_ticks_ { 0 }, peak_round_trip_ticks_ { 0 };
+    std::atomic<int> restarts_ { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(sandboxed_plugin_instance)
+};
@@ -0,0 +1,226 @@
+#include "shared_audio_channel.h"
+
+#include <chrono>
+#include <new>
+#include <thread>
+
+#if ! JUCE_WINDOWS
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <unistd.h>
+#endif
+
+#if JUCE_LINUX
+ #include <linux/futex.h>
+ #include <sys/syscall.h>
+#endif
+
+namespace {
+    constexpr int spin_iterations = 4096; // a round trip usually comes back in a few microseconds, which is less than it takes to go to sleep and wake up again
+
+    double now_seconds() noexcept {
+        return juce::Time::getMillisecondCounterHiRes() * 0.001;
+    }
+}
+
+shared_audio_channel::~shared_audio_channel() {
+   #if ! JUCE_WINDOWS
+    if(block_ != nullptr) {
+        munmap(block_, sizeof(block));
+    }
+
+    if(owner_) {
+        shm_unlink(name_.toRawUTF8());
+    }
+   #endif
+}
+
+std::unique_ptr<shared_audio_channel> shared_audio_channel::create() {
+   #if JUCE_WINDOWS
+    return nullptr;
+   #else
+    std::unique_ptr<shared_audio_channel> channel(new shared_audio_channel());
+
+    // macOS allows at most 31 characters here
+    channel->name_ = "/hpd-" + juce::String::toHexString(juce::Random::getSystemRandom().nextInt64());
+
+    const int fd = shm_open(channel->name_.toRawUTF8(), O_CREAT | O_EXCL | O_RDWR, 0600);
+
+    if(fd < 0) {
+        return nullptr;
+    }
+
+    channel->owner_ = true; // from here on the destructor unlinks the name
+
+    const bool sized = ftruncate(fd, (off_t) sizeof(block)) == 0;
+    void* memory = sized ? mmap(nullptr, sizeof(block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd); // the mapping keeps the memory alive
+
+    if(memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    channel->block_ = new (memory) block;
+    channel->block_->request.store(0);
+    channel->block_->response.store(0);
+
+    return channel;
+   #endif
+}
+
+std::unique_ptr<shared_audio_channel> shared_audio_channel::open(const juce::String& name) {
+   #if JUCE_WINDOWS
+    juce::ignoreUnused(name);
+    return nullptr;
+   #else
+    const int fd = shm_open(name.toRawUTF8(), O_RDWR, 0600);
+
+    if(fd < 0) {
+        return nullptr;
+    }
+
+    void* memory = mmap(nullptr, sizeof(block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(memory == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::unique_ptr<shared_audio_channel> channel(new shared_audio_channel());
+    channel->name_ = name;
+    channel->block_ = static_cast<block*>(memory); // the wrapper constructed it
+    return channel;
+   #endif
+}
+
+bool shared_audio_channel::is_idle() const noexcept {
+    return block_->response.load(std::memory_order_acquire) == block_->request.load(std::memory_order_relaxed);
+}
+
+bool shared_audio_channel::exchange(double timeout_seconds) noexcept {
+    auto& b = *block_;
+
+    const auto sequence = b.request.load(std::memory_order_relaxed) + 1;
+    b.request.store(sequence, std::memory_order_release); // publishes everything written into the block
+    wake_(b.request);
+
+    const auto deadline = now_seconds() + timeout_seconds;
+
+    for(;;) {
+        const auto response = b.response.load(std::memory_order_acquire);
+
+        if(response == sequence) {
+            return true;
+        }
+
+        const auto remaining = deadline - now_seconds();
+
+        if(remaining <= 0.0) {
+            return false;
+        }
+
+        wait_(b.response, response, remaining);
+    }
+}
+
+bool shared_audio_channel::wait_for_request(juce::uint32& last_seen, int timeout_ms) noexcept {
+    auto& b = *block_;
+    const auto deadline = now_seconds() + timeout_ms * 0.001;
+
+    for(;;) {
+        const auto request = b.request.load(std::memory_order_acquire);
+
+        if(request != last_seen) {
+            last_seen = request;
+            return true;
+        }
+
+        const auto remaining = deadline - now_seconds();
+
+        if(remaining <= 0.0) {
+            return false;
+        }
+
+        wait_(b.request, request, remaining);
+    }
+}
+
+void shared_audio_channel::respond(juce::uint32 sequence) noexcept {
+    block_->response.store(sequence, std::memory_order_release);
+    wake_(block_->response);
+}
+
+void shared_audio_channel::wait_(std::atomic<juce::uint32>& word, juce::uint32 while_equal_to, double timeout_seconds) noexcept {
+    for(int i = 0; i < spin_iterations; ++i) {
+        if(word.load(std::memory_order_acquire) != while_equal_to) {
+            return;
+        }
+    }
+
+   #if JUCE_LINUX
+    timespec timeout;
+    timeout.tv_sec = (time_t) timeout_seconds;
+    timeout.tv_nsec = (long) ((timeout_seconds - (double) timeout.tv_sec) * 1.0e9);
+
+    // returns straight away if the word isn't while_equal_to anymore, so a wake between the load above and this can't get lost
+    syscall(SYS_futex, reinterpret_cast<juce::uint32*>(&word), FUTEX_WAIT, while_equal_to, &timeout, nullptr, 0);
+   #else
+    juce::ignoreUnused(timeout_seconds);
+    std::this_thread::sleep_for(std::chrono::microseconds(50)); // the caller checks again and comes back here until its deadline
+   #endif
+}
+
+void shared_audio_channel::wake_(std::atomic<juce::uint32>& word) noexcept {
+   #if JUCE_LINUX
+    syscall(SYS_futex, reinterpret_cast<juce::uint32*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+   #else
+    juce::ignoreUnused(word);
+   #endif
+}
+
+int shared_audio_channel::write_midi(const juce::MidiBuffer& source, int start, int length, juce::uint8* destination, int capacity) noexcept {
+    int size = 0;
+
+    // both sides are on the same machine, so everything is in native byte order
+    for(auto it = source.findNextSamplePosition(start); it != source.cend(); ++it) {
+        const auto metadata = *it;
+
+        if(metadata.samplePosition >= start + length) {
+            break;
+        }
+
+        const int event_size = 4 + 2 + metadata.numBytes;
+
+        if(metadata.numBytes > 0xffff || size + event_size > capacity) {
+            continue; // doesn't fit
+        }
+
+        const juce::int32 sample_position = metadata.samplePosition - start;
+        const auto number_of_bytes = (juce::uint16) metadata.numBytes;
+
+        std::memcpy(destination + size, &sample_position, 4);
+        std::memcpy(destination + size + 4, &number_of_bytes, 2);
+        std::memcpy(destination + size + 6, metadata.data, (std::size_t) metadata.numBytes);
+
+        size += event_size;
+    }
+
+    return size;
+}
+
+void shared_audio_channel::read_midi(const juce::uint8* source, int size, juce::MidiBuffer& destination, int offset) noexcept {
+    for(int position = 0; position + 6 <= size;) {
+        juce::int32 sample_position;
+        juce::uint16 number_of_bytes;
+
+        std::memcpy(&sample_position, source + position, 4);
+        std::memcpy(&number_of_bytes, source + position + 4, 2);
+
+        if(position + 6 + number_of_bytes > size) {
+            return; // can't happen unless the other side is broken
+        }
+
+        destination.addEvent(source + position + 6, number_of_bytes, sample_position + offset);
+        position += 6 + number_of_bytes;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+#include <atomic>
+#include <memory>
+
+/**
+ * a block of shared memory that the wrapper and a sandbox process (see sandboxed_plugin_instance) exchange audio and midi through
+ *
+ * the exchange is in lockstep, one block at a time: the wrapper writes a block into the shared memory and bumps request,
+ * the sandbox processes it in place (its AudioBuffer points straight into the shared memory, so there's no copy on that side at all) and bumps response
+ * so there's never more than one block in flight, and the only copies are the wrapper's host buffer into the shared memory and back out
+ * the sequence numbers are also what the two sides sleep on. On linux that's a futex on the number itself (shared, not FUTEX_PRIVATE, because it's two processes),
+ * elsewhere a short spin followed by sleeping in small steps
+ *
+ * POSIX shared memory (shm_open), so it isn't available on windows, create() returns null there
+ */
+class shared_audio_channel {
+public:
+    static constexpr int maximum_number_of_channels = 32;
+    static constexpr int maximum_block_size = 8192;        // bigger host blocks are exchanged in several pieces
+    static constexpr int midi_capacity = 64 * 1024;        // bytes. Events that don't fit are dropped
+
+    /// what's in the shared memory. Everything but the sequence numbers belongs to whichever side's turn it is
+    struct block {
+        std::atomic<juce::uint32> request;                 // bumped by the wrapper when a block is ready
+        std::atomic<juce::uint32> response;                // set to request by the sandbox when it's done with it
+
+        juce::int32 number_of_input_channels, number_of_output_channels, number_of_samples;
+        juce::int32 midi_bytes;                            // of midi, in whichever direction the block is going
+
+        float audio[maximum_number_of_channels][maximum_block_size];
+        juce::uint8 midi[midi_capacity];                   // events, each one [i32 sample position][u16 size][bytes]
+    };
+
+    static_assert(std::atomic<juce::uint32>::is_always_lock_free, "the sequence numbers have to work across processes");
+
+    ~shared_audio_channel();
+
+    /// the wrapper's side. Creates the shared memory (with a random name), and removes the name again when it's destroyed
+    static std::unique_ptr<shared_audio_channel> create();
+
+    /// the sandbox's side
+    static std::unique_ptr<shared_audio_channel> open(const juce::String& name);
+
+    inline const juce::String& get_name() const noexcept { return name_; }
+    inline block& get() noexcept { return *block_; }
+
+    /// wrapper. True if the sandbox is done with the last request (or there never was one)
+    bool is_idle() const noexcept;
+
+    /// wrapper. Hands the block to the sandbox and waits until it hands it back. False if that didn't happen in time,
+    /// the block then still belongs to the sandbox, check is_idle() before touching it again
+    bool exchange(double timeout_seconds) noexcept;
+
+    /// sandbox. Waits for a request that's newer than last_seen (and updates last_seen). False on timeout
+    bool wait_for_request(juce::uint32& last_seen, int timeout_ms) noexcept;
+
+    /// sandbox. Hands the block back
+    void respond(juce::uint32 sequence) noexcept;
+
+    /// midi in the block's format. write_midi takes the events in [start, start + length) and makes their positions relative to start, and drops whatever doesn't fit
+    /// read_midi adds the events to destination, at their position + offset
+    static int write_midi(const juce::MidiBuffer& source, int start, int length, juce::uint8* destination, int capacity) noexcept;
+    static void read_midi(const juce::uint8* source, int size, juce::MidiBuffer& destination, int offset = 0) noexcept;
+
+private:
+    shared_audio_channel() = default;
+
+    static void wait_(std::atomic<juce::uint32>& word, juce::uint32 while_equal_to, double timeout_seconds) noexcept;
+    static void wake_(std::atomic<juce::uint32>& word) noexcept;
+
+    juce::String name_;
+    block* block_ = nullptr;
+    bool owner_ = false;
+};
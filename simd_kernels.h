@@ -0,0 +1,249 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * small hand vectorised kernels for the bits of the audio path that the wrapper itself does (as opposed to the inner plugin)
+ *
+ * juce::FloatVectorOperations covers the simple stuff (copies, gains, adds) and should be used for that
+ * this is for everything it doesn't have, like per-sample gain curves
+ * everything here is header only, doesn't allocate and is safe to call on the audio thread
+ * there's an SSE2 path, a NEON path and a scalar fallback, all behind the same float4 type
+ * (the float <-> double conversions use the intrinsics directly, and only vectorise on 64 bit ARM, because 32 bit NEON has no doubles)
+ */
+
+#if defined(SIMD_KERNELS_SCALAR_ONLY) // handy for checking what the vectorised paths actually buy us
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SIMD_KERNELS_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define SIMD_KERNELS_NEON 1
+#endif
+
+namespace simd_kernels {
+
+/// four floats in a register (or in an array if there's no supported instruction set)
+struct float4 {
+#if SIMD_KERNELS_SSE2
+    __m128 v;
+    inline float4(__m128 r) noexcept : v(r) {}
+    inline float4(float f) noexcept : v(_mm_set1_ps(f)) {}
+    inline float4(float a, float b, float c, float d) noexcept : v(_mm_setr_ps(a, b, c, d)) {}
+    static inline float4 load (const float* p) noexcept { return _mm_loadu_ps(p); }
+    inline void store(float* p) const noexcept { _mm_storeu_ps(p, v); }
+    friend inline float4 operator+(float4 a, float4 b) noexcept { return _mm_add_ps(a.v, b.v); }
+    friend inline float4 operator-(float4 a, float4 b) noexcept { return _mm_sub_ps(a.v, b.v); }
+    friend inline float4 operator*(float4 a, float4 b) noexcept { return _mm_mul_ps(a.v, b.v); }
+    friend inline float4 max(float4 a, float4 b) noexcept { return _mm_max_ps(a.v, b.v); }
+    friend inline float4 abs(float4 a) noexcept { return _mm_and_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff))); }
+    inline float horizontal_max() const noexcept {
+        __m128 m = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        m = _mm_max_ps(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(m);
+    }
+    inline float horizontal_sum() const noexcept {
+        __m128 s = _mm_add_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1)));
+        s = _mm_add_ps(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 0, 3, 2)));
+        return _mm_cvtss_f32(s);
+    }
+#elif SIMD_KERNELS_NEON
+    float32x4_t v;
+    inline float4(float32x4_t r) noexcept : v(r) {}
+    inline float4(float f) noexcept : v(vdupq_n_f32(f)) {}
+    inline float4(float a, float b, float c, float d) noexcept { const float tmp[4] = {a, b, c, d}; v = vld1q_f32(tmp); }
+    static inline float4 load (const float* p) noexcept { return vld1q_f32(p); }
+    inline void store(float* p) const noexcept { vst1q_f32(p, v); }
+    friend inline float4 operator+(float4 a, float4 b) noexcept { return vaddq_f32(a.v, b.v); }
+    friend inline float4 operator-(float4 a, float4 b) noexcept { return vsubq_f32(a.v, b.v); }
+    friend inline float4 operator*(float4 a, float4 b) noexcept { return vmulq_f32(a.v, b.v); }
+    friend inline float4 max(float4 a, float4 b) noexcept { return vmaxq_f32(a.v, b.v); }
+    friend inline float4 abs(float4 a) noexcept { return vabsq_f32(a.v); }
+    inline float horizontal_max() const noexcept {
+        float32x2_t m = vpmax_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpmax_f32(m, m), 0);
+    }
+    inline float horizontal_sum() const noexcept {
+        float32x2_t s = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+        return vget_lane_f32(vpadd_f32(s, s), 0);
+    }
+#else
+    float v[4];
+    inline float4(float f) noexcept : v{f, f, f, f} {}
+    inline float4(float a, float b, float c, float d) noexcept : v{a, b, c, d} {}
+    static inline float4 load (const float* p) noexcept { return {p[0], p[1], p[2], p[3]}; }
+    inline void store(float* p) const noexcept { for(int i = 0; i < 4; ++i) p[i] = v[i]; }
+    friend inline float4 operator+(float4 a, float4 b) noexcept { return {a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}; }
+    friend inline float4 operator-(float4 a, float4 b) noexcept { return {a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}; }
+    friend inline float4 operator*(float4 a, float4 b) noexcept { return {a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}; }
+    friend inline float4 max(float4 a, float4 b) noexcept { return {a.v[0] > b.v[0] ? a.v[0] : b.v[0], a.v[1] > b.v[1] ? a.v[1] : b.v[1], a.v[2] > b.v[2] ? a.v[2] : b.v[2], a.v[3] > b.v[3] ? a.v[3] : b.v[3]}; }
+    friend inline float4 abs(float4 a) noexcept { return {a.v[0] < 0 ? -a.v[0] : a.v[0], a.v[1] < 0 ? -a.v[1] : a.v[1], a.v[2] < 0 ? -a.v[2] : a.v[2], a.v[3] < 0 ? -a.v[3] : a.v[3]}; }
+    inline float horizontal_max() const noexcept { return max(max(v[0], v[1]), max(v[2], v[3])); }
+    inline float horizontal_sum() const noexcept { return v[0] + v[1] + v[2] + v[3]; }
+private:
+    static inline float max(float a, float b) noexcept { return a > b ? a : b; }
+public:
+#endif
+};
+
+/// sin(x) for x in [0, pi/2], which is all the gain curves need. Odd polynomial, the error is below 4e-6 over that range
+/// works for both float and float4
+template<typename T>
+inline T quarter_sine(T x) noexcept {
+    const T x2 = x * x;
+    return x * (T(1.f) + x2 * (T(-1.f / 6.f) + x2 * (T(1.f / 120.f) + x2 * (T(-1.f / 5040.f) + x2 * T(1.f / 362880.f)))));
+}
+
+/**
+ * equal power crossfade between two signals, done in place on the incoming one
+ *
+ * incoming[i] = incoming[i] * sin(t * pi/2) + outgoing[i] * cos(t * pi/2), where t = start + i * increment
+ * t should stay within [0, 1]. start = 0 is all outgoing, 1 is all incoming
+ */
+inline void equal_power_crossfade(float* incoming, const float* outgoing, int number_of_samples, float start, float increment) noexcept {
+    constexpr float half_pi = 1.57079632679489661923f;
+
+    int i = 0;
+
+    const float4 quarter_step = increment * 4.f * half_pi;
+    float4 theta = float4(start, start + increment, start + 2.f * increment, start + 3.f * increment) * float4(half_pi);
+
+    for(; i + 4 <= number_of_samples; i += 4) {
+        const float4 gain_in  = quarter_sine(theta);
+        const float4 gain_out = quarter_sine(float4(half_pi) - theta);
+
+        (float4::load(incoming + i) * gain_in + float4::load(outgoing + i) * gain_out).store(incoming + i);
+
+        theta = theta + quarter_step;
+    }
+
+    for(; i < number_of_samples; ++i) {
+        const float theta_scalar = (start + (float) i * increment) * half_pi;
+        incoming[i] = incoming[i] * quarter_sine(theta_scalar) + outgoing[i] * quarter_sine(half_pi - theta_scalar);
+    }
+}
+
+/// sum of a[i] * b[i]. For FIR filters, with the (reversed) taps in a and the history in b
+inline float dot(const float* a, const float* b, int length) noexcept {
+    int i = 0;
+    float4 sum = 0.f;
+
+    for(; i + 4 <= length; i += 4) {
+        sum = sum + float4::load(a + i) * float4::load(b + i);
+    }
+
+    float result = sum.horizontal_sum();
+
+    for(; i < length; ++i) {
+        result += a[i] * b[i];
+    }
+
+    return result;
+}
+
+/// the largest absolute value, 0 if there are no samples. For telling silence apart from signal
+inline float peak(const float* samples, int number_of_samples) noexcept {
+    int i = 0;
+    float4 maximum = 0.f;
+
+    for(; i + 4 <= number_of_samples; i += 4) {
+        maximum = max(maximum, abs(float4::load(samples + i)));
+    }
+
+    float result = maximum.horizontal_max();
+
+    for(; i < number_of_samples; ++i) {
+        const float magnitude = samples[i] < 0.f ? -samples[i] : samples[i];
+        result = magnitude > result ? magnitude : result;
+    }
+
+    return result;
+}
+
+/// the same for doubles. Two at a time on SSE2 and 64 bit ARM, scalar everywhere else
+inline double peak(const double* samples, int number_of_samples) noexcept {
+    int i = 0;
+    double result = 0.0;
+
+#if SIMD_KERNELS_SSE2
+    const __m128d magnitude_mask = _mm_castsi128_pd(_mm_set_epi32(0x7fffffff, -1, 0x7fffffff, -1));
+    __m128d maximum = _mm_setzero_pd();
+
+    for(; i + 2 <= number_of_samples; i += 2) {
+        maximum = _mm_max_pd(maximum, _mm_and_pd(_mm_loadu_pd(samples + i), magnitude_mask));
+    }
+
+    result = _mm_cvtsd_f64(_mm_max_sd(maximum, _mm_unpackhi_pd(maximum, maximum)));
+#elif SIMD_KERNELS_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+    float64x2_t maximum = vdupq_n_f64(0.0);
+
+    for(; i + 2 <= number_of_samples; i += 2) {
+        maximum = vmaxq_f64(maximum, vabsq_f64(vld1q_f64(samples + i)));
+    }
+
+    result = vmaxvq_f64(maximum);
+#endif
+
+    for(; i < number_of_samples; ++i) {
+        const double magnitude = samples[i] < 0.0 ? -samples[i] : samples[i];
+        result = magnitude > result ? magnitude : result;
+    }
+
+    return result;
+}
+
+/// the same fade for the double precision path. Scalar, the gains are worked out in double too
+inline void equal_power_crossfade(double* incoming, const double* outgoing, int number_of_samples, float start, float increment) noexcept {
+    constexpr double half_pi = 1.57079632679489661923;
+
+    for(int i = 0; i < number_of_samples; ++i) {
+        const double theta = ((double) start + (double) i * (double) increment) * half_pi;
+        incoming[i] = incoming[i] * quarter_sine(theta) + outgoing[i] * quarter_sine(half_pi - theta);
+    }
+}
+
+/// double to float, rounding to nearest like a plain cast does. For plugins that only process in single precision while the host runs us in double
+inline void convert(const double* source, float* destination, int number_of_samples) noexcept {
+    int i = 0;
+
+#if SIMD_KERNELS_SSE2
+    for(; i + 4 <= number_of_samples; i += 4) {
+        const __m128 low  = _mm_cvtpd_ps(_mm_loadu_pd(source + i));
+        const __m128 high = _mm_cvtpd_ps(_mm_loadu_pd(source + i + 2));
+        _mm_storeu_ps(destination + i, _mm_movelh_ps(low, high));
+    }
+#elif SIMD_KERNELS_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+    for(; i + 4 <= number_of_samples; i += 4) {
+        vst1q_f32(destination + i, vcombine_f32(vcvt_f32_f64(vld1q_f64(source + i)), vcvt_f32_f64(vld1q_f64(source + i + 2))));
+    }
+#endif
+
+    for(; i < number_of_samples; ++i) {
+        destination[i] = (float) source[i];
+    }
+}
+
+/// float to double, exact
+inline void convert(const float* source, double* destination, int number_of_samples) noexcept {
+    int i = 0;
+
+#if SIMD_KERNELS_SSE2
+    for(; i + 4 <= number_of_samples; i += 4) {
+        const __m128 v = _mm_loadu_ps(source + i);
+        _mm_storeu_pd(destination + i,     _mm_cvtps_pd(v));
+        _mm_storeu_pd(destination + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+#elif SIMD_KERNELS_NEON && (defined(__aarch64__) || defined(_M_ARM64))
+    for(; i + 4 <= number_of_samples; i += 4) {
+        const float32x4_t v = vld1q_f32(source + i);
+        vst1q_f64(destination + i,     vcvt_f64_f32(vget_low_f32(v)));
+        vst1q_f64(destination + i + 2, vcvt_high_f64_f32(v));
+    }
+#endif
+
+    for(; i < number_of_samples; ++i) {
+        destination[i] = (double) source[i];
+    }
+}
+
+} // namespace simd_kernels
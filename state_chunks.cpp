@@ -0,0 +1,198 @@
+#include "state_chunks.h"
+
+namespace state_chunks {
+
+namespace {
+    constexpr char magic[4] = {'H', 'P', 'D', 'S'};
+}
+
+bool is_binary(const void* data, std::size_t size) noexcept {
+    return data != nullptr && size >= header_size && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+//==============================================================================
+writer::writer(juce::MemoryBlock& destination, bool write_header) : stream_(destination, false) {
+    if(write_header) {
+        stream_.write(magic, sizeof(magic));
+        stream_.writeInt((int) current_version);
+    }
+}
+
+void writer::begin_chunk(const char (&id)[5]) {
+    jassert(size_position_ < 0); // chunks don't nest
+
+    stream_.write(id, 4);
+    size_position_ = stream_.getPosition();
+    stream_.writeInt64(0); // patched in end_chunk
+}
+
+void writer::end_chunk() {
+    jassert(size_position_ >= 0);
+
+    const auto end = stream_.getPosition();
+
+    stream_.setPosition(size_position_);
+    stream_.writeInt64(end - size_position_ - 8);
+    stream_.setPosition(end);
+
+    size_position_ = -1;
+}
+
+void writer::write_int(int value) {
+    stream_.writeInt(value);
+}
+
+void writer::write_int64(juce::int64 value) {
+    stream_.writeInt64(value);
+}
+
+void writer::write_bool(bool value) {
+    stream_.writeByte(value ? 1 : 0);
+}
+
+void writer::write_float(float value) {
+    stream_.writeFloat(value);
+}
+
+void writer::write_string(const juce::String& value) {
+    const auto number_of_bytes = value.getNumBytesAsUTF8();
+
+    stream_.writeInt((int) number_of_bytes);
+    stream_.write(value.toRawUTF8(), number_of_bytes);
+}
+
+void writer::write_bytes(const void* data, std::size_t size) {
+    stream_.writeInt64((juce::int64) size);
+    stream_.write(data, size);
+}
+
+std::size_t writer::get_position() const {
+    return (std::size_t) stream_.getPosition();
+}
+
+void writer::reserve(std::size_t additional_bytes) {
+    stream_.preallocate(stream_.getDataSize() + additional_bytes);
+}
+
+//==============================================================================
+reader::reader(const void* data, std::size_t size) noexcept : data_(static_cast<const char*>(data)),
+                                                              size_(size) {
+    valid_ = is_binary(data, size);
+
+    if(valid_) {
+        version_ = juce::ByteOrder::littleEndianInt(data_ + 4);
+        next_chunk_ = header_size;
+    }
+}
+
+bool reader::next_chunk() noexcept {
+    if(! valid_ || next_chunk_ + chunk_header_size > size_) {
+        return false;
+    }
+
+    std::memcpy(id_, data_ + next_chunk_, 4);
+    const auto payload_size = juce::ByteOrder::littleEndianInt64(data_ + next_chunk_ + 4);
+
+    payload_ = next_chunk_ + chunk_header_size;
+
+    if(payload_size > (juce::uint64) (size_ - payload_)) {
+        valid_ = false; // truncated, nothing after this can be trusted
+        return false;
+    }
+
+    payload_end_ = payload_ + (std::size_t) payload_size;
+    position_ = payload_;
+    next_chunk_ = payload_end_;
+
+    return true;
+}
+
+bool reader::seek_chunk(std::size_t offset) noexcept {
+    if(! valid_ || offset < header_size || offset > size_) {
+        return false;
+    }
+
+    next_chunk_ = offset;
+    return next_chunk();
+}
+
+bool reader::chunk_is(const char (&id)[5]) const noexcept {
+    return std::memcmp(id_, id, 4) == 0;
+}
+
+const char* reader::read_raw_(std::size_t size) noexcept {
+    if(size > payload_end_ - position_) {
+        position_ = payload_end_;
+        return nullptr;
+    }
+
+    const char* raw = data_ + position_;
+    position_ += size;
+    return raw;
+}
+
+int reader::read_int(int fallback) noexcept {
+    const char* raw = read_raw_(4);
+    return raw != nullptr ? (int) juce::ByteOrder::littleEndianInt(raw) : fallback;
+}
+
+juce::int64 reader::read_int64(juce::int64 fallback) noexcept {
+    const char* raw = read_raw_(8);
+    return raw != nullptr ? (juce::int64) juce::ByteOrder::littleEndianInt64(raw) : fallback;
+}
+
+bool reader::read_bool(bool fallback) noexcept {
+    const char* raw = read_raw_(1);
+    return raw != nullptr ? *raw != 0 : fallback;
+}
+
+float reader::read_float(float fallback) noexcept {
+    const char* raw = read_raw_(4);
+
+    if(raw == nullptr) {
+        return fallback;
+    }
+
+    const auto bits = juce::ByteOrder::littleEndianInt(raw);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+juce::String reader::read_string() {
+    const int number_of_bytes = read_int(0);
+
+    if(number_of_bytes <= 0) {
+        return {};
+    }
+
+    const char* raw = read_raw_((std::size_t) number_of_bytes);
+    return raw != nullptr ? juce::String::fromUTF8(raw, number_of_bytes) : juce::String();
+}
+
+bool reader::read_bytes(const void*& data, std::size_t& size) noexcept {
+    const char* raw_size = read_raw_(8);
+
+    if(raw_size == nullptr) {
+        return false;
+    }
+
+    const auto number_of_bytes = juce::ByteOrder::littleEndianInt64(raw_size);
+
+    if(number_of_bytes > (juce::uint64) (payload_end_ - position_)) {
+        position_ = payload_end_;
+        return false;
+    }
+
+    const char* raw = read_raw_((std::size_t) number_of_bytes);
+
+    if(raw == nullptr) {
+        return false;
+    }
+
+    data = raw;
+    size = (std::size_t) number_of_bytes;
+    return true;
+}
+
+} // namespace state_chunks
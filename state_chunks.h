@@ -0,0 +1,101 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+
+/**
+ * the wrapper's binary state format
+ *
+ * the state used to be an xml document with every inner plugin's state base64 encoded into a text node,
+ * which for sample based instruments with tens of megabytes of state meant a third more data and several full copies on every save and load
+ * this stores the inner states as they are
+ *
+ * layout (everything little endian):
+ *     "HPDS"  magic
+ *     u32     format version
+ *     chunks until the end of the data, each one is
+ *         4 bytes  chunk id
+ *         u64      payload size
+ *         payload
+ *
+ * unknown chunks are skipped, so newer versions can add chunks without breaking older readers
+ * within a chunk, fields are read in order and every read is bounds checked. A truncated field reads as its fallback
+ */
+namespace state_chunks {
+
+constexpr juce::uint32 current_version = 1;
+constexpr std::size_t header_size = 8, chunk_header_size = 12;
+
+/// true if data starts with the magic (the old xml format starts with '<')
+bool is_binary(const void* data, std::size_t size) noexcept;
+
+class writer {
+public:
+    /// replaces whatever is in destination with the header. destination has to outlive the writer
+    /// without the header, it just writes chunks, e.g. for appending records to a file that already has one (see plugin_scan_cache)
+    explicit writer(juce::MemoryBlock& destination, bool write_header = true);
+
+    /// the payload is everything written until end_chunk. Chunks don't nest
+    void begin_chunk(const char (&id)[5]);
+    void end_chunk();
+
+    void write_int(int value);
+    void write_int64(juce::int64 value);
+    void write_bool(bool value);
+    void write_float(float value);
+    void write_string(const juce::String& value);               // u32 byte count + utf8, no terminator
+    void write_bytes(const void* data, std::size_t size);       // u64 byte count + raw bytes
+
+    /// bytes written so far, header included. Taken before begin_chunk, it's the offset reader::seek_chunk wants
+    std::size_t get_position() const;
+
+    /// makes sure the destination has room for this many more bytes, so big states don't make it reallocate (and copy) as it grows
+    void reserve(std::size_t additional_bytes);
+
+private:
+    juce::MemoryOutputStream stream_;
+    juce::int64 size_position_ = -1;
+};
+
+/// walks the chunks of a binary state without copying anything
+class reader {
+public:
+    reader(const void* data, std::size_t size) noexcept;
+
+    /// where the next chunk starts, i.e. how much of the data is known to be intact once next_chunk() returns false
+    inline std::size_t get_next_chunk_offset() const noexcept { return next_chunk_; }
+
+    /// false if the magic is wrong
+    inline bool is_valid() const noexcept { return valid_; }
+    inline juce::uint32 get_version() const noexcept { return version_; }
+
+    /// moves to the next chunk. False once there are none left (or the rest of the data is garbage)
+    bool next_chunk() noexcept;
+
+    /// like next_chunk, but moves to the chunk that starts at offset, for formats that keep an index of their chunks (see plugin_index)
+    bool seek_chunk(std::size_t offset) noexcept;
+    bool chunk_is(const char (&id)[5]) const noexcept;
+
+    int read_int(int fallback) noexcept;
+    juce::int64 read_int64(juce::int64 fallback) noexcept;
+    bool read_bool(bool fallback) noexcept;
+    float read_float(float fallback) noexcept;
+    juce::String read_string();
+
+    /// points data at the bytes inside the state that was passed to the constructor, nothing is copied
+    bool read_bytes(const void*& data, std::size_t& size) noexcept;
+
+private:
+    const char* read_raw_(std::size_t size) noexcept; // nullptr if the chunk doesn't have that many bytes left
+
+    const char* data_;
+    std::size_t size_;
+    std::size_t next_chunk_ = 0;                   // offset of the next chunk header
+    std::size_t payload_ = 0, payload_end_ = 0;    // the current chunk
+    std::size_t position_ = 0;                     // read position within the current chunk
+    char id_[4] = {};
+
+    bool valid_ = false;
+    juce::uint32 version_ = 0;
+};
+
+} // namespace state_chunks
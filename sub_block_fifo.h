@@ -0,0 +1,107 @@
+#pragma once
+
+#include <juce_audio_basics/juce_audio_basics.h>
+
+#include <algorithm>
+
+/**
+ * re-chunks whatever block sizes the host calls us with into blocks of one fixed size,
+ * for plugins that have a lot of overhead per processBlock call, or that only behave with power of two blocks
+ *
+ * there's only one buffer: the host's samples go into the fifo at the same place the previous full block's output comes out,
+ * and when the fifo is full it gets processed in place. So the delay is exactly one block, whatever the host's block size is
+ * midi goes the same way. Events keep their offset within the block, and whatever the plugin sends back comes out one block later, at the sample it was sent at
+ * everything is allocated in prepare(). process() doesn't lock or allocate (as long as a block's midi fits), so it can run on the audio thread
+ */
+template<typename sample_t>
+class sub_block_fifo {
+public:
+    /// block_size 0 turns it off
+    void prepare(int block_size, int number_of_channels) {
+        block_size_ = block_size;
+        number_of_channels_ = block_size > 0 ? number_of_channels : 0;
+
+        fifo_.setSize(number_of_channels_, block_size, false, true, false);
+
+        for(auto* midi : { &pending_midi_, &processed_midi_, &output_midi_ }) {
+            midi->ensureSize(block_size > 0 ? midi_scratch_bytes_ : 0);
+        }
+
+        reset();
+    }
+
+    /// starts over with silence (and no midi) in the fifo
+    void reset() noexcept {
+        fifo_.clear();
+        position_ = 0;
+
+        pending_midi_.clear();
+        processed_midi_.clear();
+    }
+
+    inline int get_block_size() const noexcept { return block_size_; }
+
+    /// in samples at the rate process() gets called at
+    inline int get_latency_samples() const noexcept { return block_size_; }
+
+    /// calls process_block(juce::AudioBuffer<sample_t>&, juce::MidiBuffer&) once for every block_size samples that came in, 0 or more times per call
+    /// a buffer with more channels than prepare() was told about is left alone (and process_block isn't called), rather than allocating
+    template<typename callback_t>
+    void process(juce::AudioBuffer<sample_t>& buffer, juce::MidiBuffer& midi_buffer, callback_t&& process_block) {
+        const int number_of_channels = buffer.getNumChannels();
+        const int number_of_samples = buffer.getNumSamples();
+
+        if(block_size_ == 0 || number_of_channels > number_of_channels_) {
+            jassert(block_size_ == 0);
+            return;
+        }
+
+        output_midi_.clear();
+
+        for(int start = 0; start < number_of_samples;) {
+            const int length = juce::jmin(number_of_samples - start, block_size_ - position_);
+
+            for(int channel = 0; channel < number_of_channels; ++channel) {
+                sample_t* host = buffer.getWritePointer(channel, start);
+                std::swap_ranges(host, host + length, fifo_.getWritePointer(channel, position_)); // this block's input in, the last block's output out
+            }
+
+            for(auto it = processed_midi_.findNextSamplePosition(position_); it != processed_midi_.cend() && (*it).samplePosition < position_ + length; ++it) {
+                const auto metadata = *it;
+                output_midi_.addEvent(metadata.data, metadata.numBytes, start + metadata.samplePosition - position_);
+            }
+
+            for(auto it = midi_buffer.findNextSamplePosition(start); it != midi_buffer.cend() && (*it).samplePosition < start + length; ++it) {
+                const auto metadata = *it;
+                pending_midi_.addEvent(metadata.data, metadata.numBytes, position_ + metadata.samplePosition - start);
+            }
+
+            start += length;
+            position_ += length;
+
+            if(position_ == block_size_) {
+                juce::AudioBuffer<sample_t> block(fifo_.getArrayOfWritePointers(), number_of_channels, block_size_); // no allocation
+                process_block(block, pending_midi_);
+
+                processed_midi_.swapWith(pending_midi_); // the plugin's midi output, which goes out over the next block_size samples
+                pending_midi_.clear();
+                position_ = 0;
+            }
+        }
+
+        // not swapWith, the host's buffer keeps its own storage. MidiBuffer::clear keeps it too
+        midi_buffer.clear();
+        midi_buffer.addEvents(output_midi_, 0, -1, 0);
+    }
+
+private:
+    static constexpr std::size_t midi_scratch_bytes_ = 16384;
+
+    int block_size_ = 0, number_of_channels_ = 0;
+    int position_ = 0;                                  // how much of the current block has come in (and how much of the last one has gone out)
+
+    juce::AudioBuffer<sample_t> fifo_;
+    juce::MidiBuffer pending_midi_;                     // the current block's midi, at offsets within the block
+    juce::MidiBuffer processed_midi_;                   // what the plugin sent back for the last block
+    juce::MidiBuffer output_midi_;                      // what goes back to the host this call
+};